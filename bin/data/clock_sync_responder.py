@@ -0,0 +1,34 @@
+#!/usr/bin/python
+
+import socket
+import struct
+import sys
+import time
+
+# answers clock sync requests (see src/clockSync.h), run it on the trigger host and the eye tracker
+#   clock_sync_responder.py [port] [offset]   offset in seconds is added to this clock, for testing
+message_format = '<4sBBHIIddd'
+message_size = struct.calcsize(message_format)
+response = 1
+
+port = int(sys.argv[1]) if (len(sys.argv) > 1) else 12346
+offset = float(sys.argv[2]) if (len(sys.argv) > 2) else 0.0
+
+sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+sock.bind(('', port))
+print('listening on port %d' % port)
+answered = 0
+try:
+    while True:
+        data, address = sock.recvfrom(64)
+        received = time.time() + offset
+        if (len(data) != message_size):
+            continue
+        (magic, version, flags, reserved, sequence, reserved2, request_sent, _, _) = struct.unpack(message_format, data)
+        if ((magic != b'EOGC') or (flags & response)):
+            continue
+        sock.sendto(struct.pack(message_format, magic, version, flags | response, 0, sequence, 0,
+                                request_sent, received, time.time() + offset), address)
+        answered += 1
+except KeyboardInterrupt:
+    print('answered %d requests' % answered)
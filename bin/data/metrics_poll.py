@@ -0,0 +1,62 @@
+#!/usr/bin/python
+
+import socket
+import sys
+
+try:
+    from http.server import BaseHTTPRequestHandler, HTTPServer
+except ImportError:
+    from BaseHTTPServer import BaseHTTPRequestHandler, HTTPServer
+
+# polls the metrics of a running session (<metrics> in calibrationSettings.xml, see src/metrics.h)
+#   metrics_poll.py [host:port]                       print them once
+#   metrics_poll.py [host:port] --serve http_port     serve them as http://localhost:http_port/metrics,
+#                                                     for prometheus or any other dashboard
+def poll(host, port):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(1.0)
+    try:
+        sock.sendto(b'metrics', (host, port))
+        data, address = sock.recvfrom(65536)
+        return data
+    except socket.timeout:
+        return None
+    finally:
+        sock.close()
+
+def serve(host, port, http_port):
+    class Handler(BaseHTTPRequestHandler):
+        def do_GET(self):
+            data = poll(host, port)
+            if (data is None):
+                self.send_response(504)
+                self.end_headers()
+                return
+            self.send_response(200)
+            self.send_header('Content-Type', 'text/plain; version=0.0.4')
+            self.send_header('Content-Length', str(len(data)))
+            self.end_headers()
+            self.wfile.write(data)
+
+        def log_message(self, format, *args):
+            pass
+
+    print('serving metrics of %s:%d on http://localhost:%d/metrics' % (host, port, http_port))
+    HTTPServer(('', http_port), Handler).serve_forever()
+
+host = '127.0.0.1'
+port = 9101
+args = sys.argv[1:]
+if ((len(args) > 0) and (args[0].startswith('--') == False)):
+    address = args.pop(0).split(':')
+    host = address[0]
+    if (len(address) > 1):
+        port = int(address[1])
+if ((len(args) > 1) and (args[0] == '--serve')):
+    serve(host, port, int(args[1]))
+else:
+    data = poll(host, port)
+    if (data is None):
+        print('no answer from %s:%d' % (host, port))
+        sys.exit(1)
+    sys.stdout.write(data.decode())
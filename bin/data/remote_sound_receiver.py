@@ -0,0 +1,114 @@
+#!/usr/bin/python
+
+import socket
+import struct
+import sys
+import time
+
+# reference receiver for the binary remote sound protocol (see src/remoteSound.h)
+#   remote_sound_receiver.py [port]                        receive, ack and report per session
+#   remote_sound_receiver.py --load host:port [n] [rate]   send n commands per second and measure acks
+message_format = '<4sBBHIidd'
+message_size = struct.calcsize(message_format)
+ack_requested = 1
+ack = 2
+beep = 9999
+
+def pack(flags, sequence, command, play_time, send_time):
+    return struct.pack(message_format, b'EOGR', 1, flags, 0, sequence, command, play_time, send_time)
+
+def unpack(data):
+    if (len(data) != message_size):
+        return None
+    message = struct.unpack(message_format, data)
+    if (message[0] != b'EOGR'):
+        return None
+    return message
+
+def report(stats):
+    if (stats['received'] == 0):
+        return
+    lateness = sorted(stats['lateness'])
+    print('session: %d received, %d missing, %d reordered or duplicate, %d acked' %
+          (stats['received'], stats['missing'], stats['reordered'], stats['acked']))
+    print('  arrival relative to play time: median %.3f ms, max %.3f ms' %
+          (lateness[len(lateness) // 2] * 1000, lateness[-1] * 1000))
+
+def new_session():
+    return {'received': 0, 'missing': 0, 'reordered': 0, 'acked': 0, 'next': 0, 'lateness': []}
+
+def receive(port):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(('', port))
+    print('listening on port %d' % port)
+    stats = new_session()
+    try:
+        while True:
+            data, address = sock.recvfrom(64)
+            arrival = time.time()
+            message = unpack(data)
+            if (message is None):
+                print('ignoring %d bytes from %s' % (len(data), address[0]))
+                continue
+            (magic, version, flags, reserved, sequence, command, play_time, send_time) = message
+            if ((sequence == 0) and (stats['next'] > 0)):
+                # a new session starts counting from 0
+                report(stats)
+                stats = new_session()
+            if (sequence >= stats['next']):
+                stats['missing'] += sequence - stats['next']
+                stats['next'] = sequence + 1
+            else:
+                stats['reordered'] += 1
+            stats['received'] += 1
+            stats['lateness'].append(arrival - play_time)
+            if (flags & ack_requested):
+                sock.sendto(pack(flags | ack, sequence, command, play_time, send_time), address)
+                stats['acked'] += 1
+            print('%6d %s' % (sequence, 'beep' if (command == beep) else 'command %d' % command))
+    except KeyboardInterrupt:
+        report(stats)
+
+def load(target, count, rate):
+    host, port = target.split(':')
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.connect((host, int(port)))
+    sock.setblocking(False)
+    sent = {}
+    rtts = []
+    start = time.time()
+    for sequence in range(count):
+        now = time.time()
+        sent[sequence] = now
+        sock.send(pack(ack_requested, sequence, sequence % 13, now, now))
+        # collect acks until the next message is due
+        while (time.time() < start + (sequence + 1) / float(rate)):
+            try:
+                message = unpack(sock.recv(64))
+            except socket.error:
+                time.sleep(0.0001)
+                continue
+            if ((message is not None) and (message[2] & ack) and (message[4] in sent)):
+                rtts.append(time.time() - message[7])
+                del sent[message[4]]
+    time.sleep(0.5)
+    while True:
+        try:
+            message = unpack(sock.recv(64))
+        except socket.error:
+            break
+        if ((message is not None) and (message[2] & ack) and (message[4] in sent)):
+            rtts.append(time.time() - message[7])
+            del sent[message[4]]
+    rtts.sort()
+    print('%d sent, %d acked, %d lost' % (count, len(rtts), len(sent)))
+    if (len(rtts) > 0):
+        print('rtt: median %.3f ms, p99 %.3f ms, max %.3f ms' %
+              (rtts[len(rtts) // 2] * 1000, rtts[min(len(rtts) - 1, int(len(rtts) * 0.99))] * 1000, rtts[-1] * 1000))
+
+if ((len(sys.argv) > 2) and (sys.argv[1] == '--load')):
+    count = int(sys.argv[3]) if (len(sys.argv) > 3) else 1000
+    rate = float(sys.argv[4]) if (len(sys.argv) > 4) else 1000
+    load(sys.argv[2], count, rate)
+else:
+    receive(int(sys.argv[1]) if (len(sys.argv) > 1) else 12345)
@@ -0,0 +1,83 @@
+#!/usr/bin/python
+
+import struct
+import sys
+
+# expect the binary session log as input and optionally a filename for the csv
+if (len(sys.argv) < 2):
+    print("no session log specified!")
+    print("usage: session_log_to_csv.py <log.evlog> [out.csv]")
+    sys.exit(1)
+infilename = sys.argv[1]
+if (len(sys.argv) < 3):
+    outfilename = infilename.rsplit('.', 1)[0] + '.csv'
+else:
+    outfilename = sys.argv[2]
+
+header_format = '<8sIIQQd24s'
+record_format = '<IHBBhhIdddddd'
+header_size = struct.calcsize(header_format)
+record_size = struct.calcsize(record_format)
+
+record_types = {1: 'transition', 2: 'start_recording', 3: 'stop_recording', 4: 'onset', 5: 'clock_sync', 6: 'frames', 7: 'audio'}
+peers = ['trigger_host', 'eye_tracker']
+states = ['off', 'target', 'pause2reference', 'reference', 'pause2target', 'pursuit']
+columns = ['sequence', 'type', 'state', 'target', 'order_position', 'planned_time',
+           'steady_time', 'trigger_done', 'osc_done', 'udp_done', 'value']
+
+def time_or_empty(value):
+    if (value < 0):
+        return ''
+    return '%.6f' % value
+
+myfile = open(infilename, 'rb')
+data = myfile.read()
+myfile.close()
+
+magic, version, file_record_size, capacity, count, epoch, codeword = struct.unpack_from(header_format, data, 0)
+if (magic != b'EOGLOG01'):
+    print("not a session log: ", infilename)
+    sys.exit(1)
+if (file_record_size != record_size):
+    print("unsupported record size: ", file_record_size)
+    sys.exit(1)
+
+rows = []
+skipped = 0
+# the file keeps its full capacity after a crash, only committed records are valid
+for offset in range(header_size, len(data) - record_size + 1, record_size):
+    (sequence, rtype, state, committed, target, order_position, reserved, planned, steady,
+     trigger_done, osc_done, udp_done, value) = struct.unpack_from(record_format, data, offset)
+    if (committed != 1):
+        skipped += 1
+        continue
+    if (rtype == 5):
+        # clock estimate of the peer in target: offset in value, drift, uncertainty and round trip in the done columns
+        rows.append((sequence, 'clock_sync', '', peers[target] if target < len(peers) else str(target),
+                     order_position, time_or_empty(planned), time_or_empty(steady),
+                     '%.9f' % trigger_done, '%.6f' % osc_done, '%.6f' % udp_done, '%.6f' % value))
+        continue
+    if (rtype == 6):
+        # frames of one marker: longest frame, mean update and draw time in the done columns, missed vsyncs in value
+        rows.append((sequence, 'frames', states[state] if state < len(states) else str(state), target, order_position,
+                     time_or_empty(planned), time_or_empty(steady), '%.6f' % trigger_done, '%.6f' % osc_done,
+                     '%.6f' % udp_done, int(value)))
+        continue
+    if (rtype == 7):
+        # audio cue: clip in target, the step that queued it in order_position, output time in steady, output minus planned in value
+        rows.append((sequence, 'audio', '', target, reserved, time_or_empty(planned), time_or_empty(steady),
+                     '', '', '', '%.6f' % value if steady >= 0 else ''))
+        continue
+    rows.append((sequence, record_types.get(rtype, str(rtype)), states[state] if state < len(states) else str(state),
+                 target, order_position, time_or_empty(planned), time_or_empty(steady),
+                 time_or_empty(trigger_done), time_or_empty(osc_done), time_or_empty(udp_done), value))
+rows.sort(key=lambda row: row[0])
+
+myfile = open(outfilename, 'w')
+myfile.write('# codeword: %s, epoch (unix time): %.6f\n' % (codeword.split(b'\0')[0].decode(), epoch))
+myfile.write(','.join(columns) + '\n')
+for row in rows:
+    myfile.write(','.join(str(item) for item in row) + '\n')
+myfile.close()
+
+print('created file: ', outfilename, '(%d records)' % len(rows))
@@ -0,0 +1,52 @@
+#!/usr/bin/python
+
+import struct
+import sys
+
+# expect the binary session trace as input and optionally a filename for the csv
+if (len(sys.argv) < 2):
+    print("no session trace specified!")
+    print("usage: session_trace_to_csv.py <trace.evtrace> [out.csv]")
+    sys.exit(1)
+infilename = sys.argv[1]
+if (len(sys.argv) < 3):
+    outfilename = infilename.rsplit('.', 1)[0] + '_trace.csv'
+else:
+    outfilename = sys.argv[2]
+
+header_format = '<8sIIQd32s64s'
+record_format = '<ddBBhi'
+header_size = struct.calcsize(header_format)
+record_size = struct.calcsize(record_format)
+
+record_types = {1: 'start', 2: 'stop', 3: 'key', 4: 'frame', 5: 'fixation', 6: 'start_recording',
+                7: 'stop_recording', 8: 'trigger', 9: 'eye_tracker', 10: 'remote_sound', 11: 'command'}
+columns = ['time', 'type', 'step', 'code', 'value']
+
+myfile = open(infilename, 'rb')
+data = myfile.read()
+myfile.close()
+
+magic, version, file_record_size, count, epoch, codeword, pattern = struct.unpack_from(header_format, data, 0)
+if (magic != b'EOGTRC01'):
+    print("not a session trace: ", infilename)
+    sys.exit(1)
+if (file_record_size != record_size):
+    print("unsupported record size: ", file_record_size)
+    sys.exit(1)
+
+rows = []
+for i in range(count):
+    time, value, rtype, committed, step, code = struct.unpack_from(record_format, data, header_size + i * record_size)
+    # value: planned time of the outputs, the time the step would have ended for fixations
+    rows.append(('%.6f' % time, record_types.get(rtype, str(rtype)), step, code, '%.6f' % value if value >= 0 else ''))
+rows.sort(key=lambda row: float(row[0]))
+
+myfile = open(outfilename, 'w')
+myfile.write('# codeword: %s, pattern: %s, epoch (unix time): %.6f\n' % (codeword.split(b'\0')[0].decode(), pattern.split(b'\0')[0].decode(), epoch))
+myfile.write(','.join(columns) + '\n')
+for row in rows:
+    myfile.write(','.join(str(item) for item in row) + '\n')
+myfile.close()
+
+print('created file: ', outfilename, '(%d records)' % len(rows))
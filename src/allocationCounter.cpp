@@ -0,0 +1,77 @@
+//
+//  allocationCounter.cpp
+//  phd_calibration_eog
+//
+
+#include "allocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifndef CHECK_ALLOCATIONS
+
+bool isCountingAllocations() {
+    return false;
+}
+
+uint64_t getAllocationCount() {
+    return 0;
+}
+
+#else
+
+// replaces the global allocation functions to count heap allocations, one relaxed increment each
+static std::atomic<uint64_t> allocation_count(0);
+
+bool isCountingAllocations() {
+    return true;
+}
+
+uint64_t getAllocationCount() {
+    return allocation_count.load(std::memory_order_relaxed);
+}
+
+static void* countedAllocation(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    void *memory = std::malloc(size > 0 ? size : 1);
+    if (memory == NULL) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new(std::size_t size) {
+    return countedAllocation(size);
+}
+
+void* operator new[](std::size_t size) {
+    return countedAllocation(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size > 0 ? size : 1);
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+#endif /* CHECK_ALLOCATIONS */
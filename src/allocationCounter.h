@@ -0,0 +1,18 @@
+//
+//  allocationCounter.h
+//  phd_calibration_eog
+//
+
+#ifndef allocationCounter_h
+#define allocationCounter_h
+
+#include <cstdint>
+
+// the global operator new is only replaced in builds with CHECK_ALLOCATIONS defined,
+// without it nothing is counted and the count stays 0
+bool isCountingAllocations();
+
+// number of global operator new calls since the process started (all threads)
+uint64_t getAllocationCount();
+
+#endif /* allocationCounter_h */
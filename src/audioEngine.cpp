@@ -0,0 +1,450 @@
+//
+//  audioEngine.cpp
+//  phd_calibration_eog
+//
+
+#include "audioEngine.h"
+
+const size_t AudioEngine::_max_clips;
+
+template <typename T>
+static T readLittleEndian(const char *data) {
+    T value;
+    memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+static void updateMax(std::atomic<double> &maximum, double value) {
+    // only the rendering thread writes
+    if (value > maximum.load(std::memory_order_relaxed)) {
+        maximum.store(value, std::memory_order_relaxed);
+    }
+}
+
+AudioEngine::AudioEngine(CalibrationClock *clock, int sample_rate, int buffer_size) {
+    this->_clock = clock;
+    this->_sample_rate = std::max(sample_rate, 8000);
+    this->_buffer_size = std::max(buffer_size, 16);
+    this->_channels = 2;
+    this->_backend = AUDIO_NULL;
+    this->_running = false;
+    this->_headless = false;
+    this->_latency = 0;
+    this->_file_frames = 0;
+    this->_registered = 0;
+    this->_clip_count = 0;
+    this->_generation = 0;
+    this->_pending_count = 0;
+    this->_voice_count = 0;
+    this->_position = 0;
+    this->_anchor = 0;
+    this->_block.assign(this->_buffer_size * this->_channels, 0);
+    this->_resync_count = 0;
+    resetStats();
+}
+
+AudioEngine::~AudioEngine() {
+    stop();
+}
+
+int AudioEngine::getClip(string filename) {
+    for (size_t i = 0; i < this->_registered; i++) {
+        if (this->_clips[i].filename == filename) {
+            return i;
+        }
+    }
+    if (this->_registered == _max_clips) {
+        ofLogError("AudioEngine") << "no room for " << filename << ", " << _max_clips << " clips at most";
+        return -1;
+    }
+    this->_clips[this->_registered].filename = filename;
+    this->_clips[this->_registered].samples.clear();
+    return this->_registered++;
+}
+
+int AudioEngine::addTone(float frequency, float duration) {
+    if (this->_registered == _max_clips) {
+        return -1;
+    }
+    AudioClip &clip = this->_clips[this->_registered];
+    clip.filename = "";
+    size_t frames = (size_t)(duration * this->_sample_rate);
+    size_t fade = std::min(frames / 2, (size_t)(0.005 * this->_sample_rate));
+    clip.samples.resize(frames);
+    for (size_t i = 0; i < frames; i++) {
+        float gain = 0.5f;
+        if (i < fade) {
+            gain *= i / (float)fade;
+        } else if (i >= frames - fade) {
+            gain *= (frames - i) / (float)fade;
+        }
+        clip.samples[i] = gain * sinf(TWO_PI * frequency * i / this->_sample_rate);
+    }
+    return this->_registered++;
+}
+
+void AudioEngine::load() {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    size_t first = this->_clip_count.load(std::memory_order_relaxed);
+    size_t decoded = 0;
+    for (size_t i = first; i < this->_registered; i++) {
+        if (this->_clips[i].filename == "") {
+            continue;
+        }
+        decoded++;
+        if (decode(this->_clips[i].filename, this->_clips[i].samples) == false) {
+            // cues of it are still timed and reported, they are just silent
+            ofLogWarning("AudioEngine") << "could not load " << this->_clips[i].filename;
+            this->_clips[i].samples.clear();
+        }
+    }
+    this->_clip_count.store(this->_registered, std::memory_order_release);
+    if (decoded > 0) {
+        ofLogNotice("AudioEngine") << "decoded " << decoded << " sound files in "
+            << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000 << " ms";
+    }
+}
+
+bool AudioEngine::decode(string filename, vector<float> &samples) {
+    ofBuffer buffer = ofBufferFromFile(filename, true);
+    const char *data = buffer.getData();
+    size_t size = buffer.size();
+    if ((size < 12) || (memcmp(data, "RIFF", 4) != 0) || (memcmp(data + 8, "WAVE", 4) != 0)) {
+        return false;
+    }
+    uint16_t format = 0, channels = 0, bits = 0;
+    uint32_t rate = 0;
+    const char *pcm = NULL;
+    size_t pcm_size = 0;
+    // walk the chunks, every one is padded to an even size
+    size_t offset = 12;
+    while (offset + 8 <= size) {
+        uint32_t chunk_size = readLittleEndian<uint32_t>(data + offset + 4);
+        const char *chunk = data + offset + 8;
+        size_t available = std::min((size_t)chunk_size, size - offset - 8);
+        if ((memcmp(data + offset, "fmt ", 4) == 0) && (available >= 16)) {
+            format = readLittleEndian<uint16_t>(chunk);
+            channels = readLittleEndian<uint16_t>(chunk + 2);
+            rate = readLittleEndian<uint32_t>(chunk + 4);
+            bits = readLittleEndian<uint16_t>(chunk + 14);
+            if ((format == 0xFFFE) && (available >= 26)) {
+                // extensible: the sub format starts with the actual format
+                format = readLittleEndian<uint16_t>(chunk + 24);
+            }
+        } else if (memcmp(data + offset, "data", 4) == 0) {
+            pcm = chunk;
+            pcm_size = available;
+        }
+        offset += 8 + chunk_size + (chunk_size & 1);
+    }
+    bool pcm16 = (format == 1) && (bits == 16);
+    bool float32 = (format == 3) && (bits == 32);
+    if ((pcm == NULL) || (channels == 0) || (rate == 0) || ((pcm16 == false) && (float32 == false))) {
+        return false;
+    }
+
+    // down to mono, then linear resampling to the engine rate
+    size_t bytes_per_frame = channels * bits / 8;
+    size_t frames = pcm_size / bytes_per_frame;
+    vector<float> mono(frames);
+    for (size_t i = 0; i < frames; i++) {
+        float sum = 0;
+        for (uint16_t c = 0; c < channels; c++) {
+            const char *sample = pcm + i * bytes_per_frame + c * bits / 8;
+            sum += pcm16 ? readLittleEndian<int16_t>(sample) / 32768.0f : readLittleEndian<float>(sample);
+        }
+        mono[i] = sum / channels;
+    }
+    if ((int)rate == this->_sample_rate) {
+        samples.swap(mono);
+        return true;
+    }
+    double step = rate / (double)this->_sample_rate;
+    size_t resampled = (size_t)(frames / step);
+    samples.resize(resampled);
+    for (size_t i = 0; i < resampled; i++) {
+        double position = i * step;
+        size_t index = (size_t)position;
+        float fraction = position - index;
+        float next = (index + 1 < frames) ? mono[index + 1] : 0;
+        samples[i] = mono[index] + (next - mono[index]) * fraction;
+    }
+    return true;
+}
+
+bool AudioEngine::start(AudioBackend backend, double output_latency, string filename, bool headless) {
+    stop();
+    this->_backend = backend;
+    this->_latency = std::max(output_latency, 0.0);
+    this->_headless = headless;
+    this->_position = 0;
+    this->_pending_count = 0;
+    this->_voice_count = 0;
+    if (backend == AUDIO_FILE) {
+        this->_file.open(ofToDataPath(filename).c_str(), std::ios::binary | std::ios::trunc);
+        if (this->_file.is_open() == false) {
+            ofLogError("AudioEngine") << "cannot write " << filename;
+            return false;
+        }
+        this->_file_frames = 0;
+        writeWavHeader(0);
+    }
+    if (backend == AUDIO_DEVICE) {
+        // anchored by the first callback
+        this->_anchor = -1;
+        ofSoundStreamSettings settings;
+        settings.numOutputChannels = this->_channels;
+        settings.numInputChannels = 0;
+        settings.sampleRate = this->_sample_rate;
+        settings.bufferSize = this->_buffer_size;
+        settings.numBuffers = 2;
+        settings.setOutListener(this);
+        if (this->_stream.setup(settings) == false) {
+            ofLogError("AudioEngine") << "cannot open the sound device at " << this->_sample_rate << " Hz";
+            return false;
+        }
+    } else {
+        // the first block has to be out this long from now
+        this->_anchor = this->_clock->now() + this->_latency;
+        if (headless == false) {
+            startThread();
+        }
+    }
+    this->_running = true;
+    ofLogNotice("AudioEngine") << ((backend == AUDIO_DEVICE) ? "device" : (backend == AUDIO_FILE) ? "file" : "null") << " output, "
+        << this->_sample_rate << " Hz, " << this->_buffer_size << " frames per block (" << getBufferDuration() * 1000 << " ms), "
+        << this->_latency * 1000 << " ms latency";
+    return true;
+}
+
+void AudioEngine::stop() {
+    if (this->_running == false) {
+        return;
+    }
+    this->_running = false;
+    if (this->_backend == AUDIO_DEVICE) {
+        this->_stream.close();
+    } else if (this->_headless == false) {
+        waitForThread(true);
+    }
+    if (this->_file.is_open() == true) {
+        writeWavHeader(this->_file_frames);
+        this->_file.close();
+    }
+}
+
+void AudioEngine::writeWavHeader(uint32_t frames) {
+    uint32_t data_size = frames * this->_channels * sizeof(float);
+    uint32_t riff_size = 36 + data_size;
+    uint32_t fmt_size = 16;
+    uint16_t format = 3;
+    uint16_t channels = this->_channels;
+    uint32_t rate = this->_sample_rate;
+    uint32_t byte_rate = rate * this->_channels * sizeof(float);
+    uint16_t block_align = this->_channels * sizeof(float);
+    uint16_t bits = 32;
+    std::streampos end = this->_file.tellp();
+    this->_file.seekp(0);
+    this->_file.write("RIFF", 4);
+    this->_file.write((const char*)&riff_size, 4);
+    this->_file.write("WAVEfmt ", 8);
+    this->_file.write((const char*)&fmt_size, 4);
+    this->_file.write((const char*)&format, 2);
+    this->_file.write((const char*)&channels, 2);
+    this->_file.write((const char*)&rate, 4);
+    this->_file.write((const char*)&byte_rate, 4);
+    this->_file.write((const char*)&block_align, 2);
+    this->_file.write((const char*)&bits, 2);
+    this->_file.write("data", 4);
+    this->_file.write((const char*)&data_size, 4);
+    if (frames > 0) {
+        this->_file.seekp(end);
+    }
+}
+
+bool AudioEngine::schedule(int clip, double time, int tag) {
+    Cue cue;
+    cue.clip = clip;
+    cue.tag = tag;
+    cue.time = time;
+    cue.generation = this->_generation.load(std::memory_order_relaxed);
+    if (this->_cues.push(cue) == false) {
+        this->_dropped_count++;
+        return false;
+    }
+    return true;
+}
+
+void AudioEngine::cancel() {
+    this->_generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AudioEngine::advance(double time) {
+    // blocks are rendered the latency ahead of their time
+    while (this->_anchor + this->_position / (double)this->_sample_rate - this->_latency <= time) {
+        render(this->_block.data(), this->_buffer_size, this->_channels, this->_anchor + this->_position / (double)this->_sample_rate);
+        this->_position += this->_buffer_size;
+        if (this->_file.is_open() == true) {
+            this->_file.write((const char*)this->_block.data(), this->_block.size() * sizeof(float));
+            this->_file_frames += this->_buffer_size;
+        }
+    }
+}
+
+void AudioEngine::threadedFunction() {
+    while (isThreadRunning()) {
+        advance(this->_clock->now());
+        this->_clock->sleepUntil(this->_anchor + this->_position / (double)this->_sample_rate - this->_latency);
+    }
+}
+
+void AudioEngine::audioOut(ofSoundBuffer &buffer) {
+    // device callback thread: the block starts playing once the ones queued before it are out
+    size_t frames = buffer.getNumFrames();
+    double observed = this->_clock->now() + this->_latency;
+    double expected = this->_anchor + this->_position / (double)this->_sample_rate;
+    if ((this->_anchor < 0) || (fabs(observed - expected) > 2 * getBufferDuration())) {
+        // first callback or an underrun, start over from the clock
+        if (this->_anchor >= 0) {
+            this->_resync_count++;
+        }
+        this->_anchor = observed - this->_position / (double)this->_sample_rate;
+    } else {
+        // callbacks jitter, the sound card clock drifts slowly against the steady clock
+        this->_anchor += (observed - expected) * 0.01;
+    }
+    render(buffer.getBuffer().data(), frames, buffer.getNumChannels(), this->_anchor + this->_position / (double)this->_sample_rate);
+    this->_position += frames;
+}
+
+void AudioEngine::render(float *output, size_t frames, size_t channels, double buffer_time) {
+    memset(output, 0, frames * channels * sizeof(float));
+    double buffer_end = buffer_time + frames / (double)this->_sample_rate;
+    uint32_t generation = this->_generation.load(std::memory_order_relaxed);
+
+    // new cues wait in the pending list until their block comes
+    Cue cue;
+    while (this->_cues.pop(cue) == true) {
+        if (cue.generation != generation) {
+            continue;
+        }
+        if (this->_pending_count == _max_pending) {
+            this->_dropped_count++;
+            report(cue, -1);
+            continue;
+        }
+        this->_pending[this->_pending_count++] = cue;
+    }
+    for (size_t i = 0; i < this->_pending_count;) {
+        const Cue &pending = this->_pending[i];
+        if (pending.generation != generation) {
+            this->_pending[i] = this->_pending[--this->_pending_count];
+        } else if (pending.time < buffer_end) {
+            startCue(pending, buffer_time, frames);
+            this->_pending[i] = this->_pending[--this->_pending_count];
+        } else {
+            i++;
+        }
+    }
+
+    // mix, a voice started in this block begins at its offset
+    for (size_t v = 0; v < this->_voice_count;) {
+        Voice &voice = this->_voices[v];
+        const vector<float> &samples = this->_clips[voice.clip].samples;
+        size_t frame = voice.delay;
+        voice.delay = 0;
+        for (; (frame < frames) && (voice.position < samples.size()); frame++) {
+            float sample = samples[voice.position++];
+            for (size_t c = 0; c < channels; c++) {
+                output[frame * channels + c] += sample;
+            }
+        }
+        if (voice.position >= samples.size()) {
+            this->_voices[v] = this->_voices[--this->_voice_count];
+        } else {
+            v++;
+        }
+    }
+    for (size_t i = 0; i < frames * channels; i++) {
+        output[i] = ofClamp(output[i], -1.0f, 1.0f);
+    }
+}
+
+void AudioEngine::startCue(const Cue &cue, double buffer_time, size_t frames) {
+    double offset = (cue.time - buffer_time) * this->_sample_rate;
+    size_t frame = 0;
+    if (offset < -0.5) {
+        // missed its block
+        this->_late_count++;
+        updateMax(this->_max_lateness, buffer_time - cue.time);
+    } else {
+        frame = std::min((size_t)(offset + 0.5), frames - 1);
+    }
+    double output_time = buffer_time + frame / (double)this->_sample_rate;
+    if (offset >= -0.5) {
+        updateMax(this->_max_error, fabs(output_time - cue.time));
+    }
+    this->_cue_count++;
+    report(cue, output_time);
+    bool valid = (cue.clip >= 0) && ((size_t)cue.clip < this->_clip_count.load(std::memory_order_acquire));
+    if ((valid == false) || (this->_clips[cue.clip].samples.empty() == true)) {
+        return;
+    }
+    if (this->_voice_count == _max_voices) {
+        this->_dropped_count++;
+        return;
+    }
+    Voice &voice = this->_voices[this->_voice_count++];
+    voice.clip = cue.clip;
+    voice.position = 0;
+    voice.delay = frame;
+}
+
+void AudioEngine::report(const Cue &cue, double output_time) {
+    AudioCueReport report;
+    report.clip = cue.clip;
+    report.tag = cue.tag;
+    report.planned_time = cue.time;
+    report.output_time = output_time;
+    this->_reports.push(report);
+}
+
+bool AudioEngine::popReport(AudioCueReport &report) {
+    return this->_reports.pop(report);
+}
+
+void AudioEngine::resetStats() {
+    this->_cue_count = 0;
+    this->_late_count = 0;
+    this->_dropped_count = 0;
+    this->_max_error = 0;
+    this->_max_lateness = 0;
+}
+
+uint64_t AudioEngine::getCueCount() {
+    return this->_cue_count;
+}
+
+uint64_t AudioEngine::getLateCount() {
+    return this->_late_count;
+}
+
+uint64_t AudioEngine::getDroppedCount() {
+    return this->_dropped_count;
+}
+
+uint64_t AudioEngine::getResyncCount() {
+    return this->_resync_count;
+}
+
+double AudioEngine::getMaxError() {
+    return this->_max_error;
+}
+
+double AudioEngine::getMaxLateness() {
+    return this->_max_lateness;
+}
+
+double AudioEngine::getBufferDuration() {
+    return this->_buffer_size / (double)this->_sample_rate;
+}
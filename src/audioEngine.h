@@ -0,0 +1,136 @@
+//
+//  audioEngine.h
+//  phd_calibration_eog
+//
+
+#ifndef audioEngine_h
+#define audioEngine_h
+
+#include "ofMain.h"
+#include "calibrationClock.h"
+#include "spscQueue.h"
+
+// a decoded sound, mono at the rate of the engine
+struct AudioClip {
+    string filename;
+    vector<float> samples;
+};
+
+// when a cue actually left the output, -1 if it was dropped
+struct AudioCueReport {
+    int clip;
+    int tag;
+    double planned_time;
+    double output_time;
+};
+
+enum AudioBackend {
+    AUDIO_DEVICE,   // the sound card, its callback thread renders
+    AUDIO_NULL,     // rendered and thrown away, on a thread of the engine or in advance()
+    AUDIO_FILE      // like null, written to a 32 bit float wav file
+};
+
+/*
+ * Plays preloaded commands and beeps at absolute times on the session clock.
+ * Cues are queued through a single-producer ring buffer and mixed into the
+ * output block that contains their time, at the exact sample, so an onset only
+ * depends on how well the block time is known: the device callback maps its
+ * sample position to the session clock with the configured output latency
+ * and follows the drift of the sound card clock. A cue that comes too late
+ * for its block starts at the next one. Every cue is reported with the time
+ * its first sample left the output.
+ * The null and file backends render on the session clock, either on a thread
+ * of the engine or, headless, in advance(). Rendering never allocates.
+ */
+class AudioEngine : public ofThread, public ofBaseSoundOutput {
+public:
+    AudioEngine(CalibrationClock *clock, int sample_rate, int buffer_size);
+    ~AudioEngine();
+    // registers a wav file (16 bit or float), decoded by load(); the same file is the same clip
+    int getClip(string filename);
+    // a sine beep with short fades, playable after the next load() like the files
+    int addTone(float frequency, float duration);
+    // decodes every registered file and publishes the new clips to the output,
+    // one thread registers and loads; clips loaded before keep playing meanwhile
+    void load();
+    // output_latency: seconds from the end of a callback to the speaker, a guess for the device,
+    // the lead of the rendering for null and file; headless, no thread renders until advance() is called
+    bool start(AudioBackend backend, double output_latency, string filename = "", bool headless = false);
+    void stop();
+
+    // one producer at a time; the report of the cue carries the tag
+    bool schedule(int clip, double time, int tag);
+    // drops every cue that has not started yet
+    void cancel();
+    // headless: renders every block that has to be out by then
+    void advance(double time);
+    bool popReport(AudioCueReport &report);
+
+    void resetStats();
+    uint64_t getCueCount();
+    uint64_t getLateCount();
+    uint64_t getDroppedCount();
+    // the device clock jumped against the session clock, e.g. after an underrun
+    uint64_t getResyncCount();
+    // largest distance of a cue that made its block from its planned time, half a sample at most
+    double getMaxError();
+    double getMaxLateness();
+    double getBufferDuration();
+
+    void audioOut(ofSoundBuffer &buffer);
+
+private:
+    struct Cue {
+        int clip;
+        int tag;
+        double time;
+        uint32_t generation;
+    };
+    struct Voice {
+        int clip;
+        size_t position;
+        size_t delay;   // frames into the block it starts in
+    };
+
+    void threadedFunction();
+    void render(float *output, size_t frames, size_t channels, double buffer_time);
+    void startCue(const Cue &cue, double buffer_time, size_t frames);
+    void report(const Cue &cue, double output_time);
+    // wav to mono at the engine rate
+    bool decode(string filename, vector<float> &samples);
+    void writeWavHeader(uint32_t frames);
+
+    CalibrationClock *_clock;
+    int _sample_rate;
+    size_t _buffer_size, _channels;
+    AudioBackend _backend;
+    bool _running, _headless;
+    double _latency;
+    ofSoundStream _stream;
+    std::ofstream _file;
+    uint64_t _file_frames;
+
+    static const size_t _max_clips = 128;
+    AudioClip _clips[_max_clips];
+    size_t _registered;
+    std::atomic<size_t> _clip_count;
+
+    SpscQueue<Cue, 256> _cues;
+    SpscQueue<AudioCueReport, 1024> _reports;
+    std::atomic<uint32_t> _generation;
+    static const size_t _max_pending = 64, _max_voices = 16;
+    Cue _pending[_max_pending];
+    size_t _pending_count;
+    Voice _voices[_max_voices];
+    size_t _voice_count;
+
+    // block position in samples and the session time of sample 0
+    uint64_t _position;
+    double _anchor;
+    vector<float> _block;
+
+    std::atomic<uint64_t> _cue_count, _late_count, _dropped_count, _resync_count;
+    std::atomic<double> _max_error, _max_lateness;
+};
+
+#endif /* audioEngine_h */
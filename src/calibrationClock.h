@@ -0,0 +1,72 @@
+//
+//  calibrationClock.h
+//  phd_calibration_eog
+//
+
+#ifndef calibrationClock_h
+#define calibrationClock_h
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+/*
+ * Time source of a session, in seconds. The live app runs on the steady clock,
+ * headless runs can swap in a virtual clock that jumps straight to the next
+ * transition instead of waiting for it.
+ */
+class CalibrationClock {
+public:
+    CalibrationClock() : _epoch_unix_time(std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count()) {}
+    virtual ~CalibrationClock() {}
+    virtual double now() = 0;
+    virtual void sleepUntil(double time) = 0;
+
+    // unix time of clock time 0, for stamping outgoing events and logs
+    double getEpochUnixTime() {
+        return this->_epoch_unix_time;
+    }
+
+private:
+    double _epoch_unix_time;
+};
+
+class SteadyClock : public CalibrationClock {
+public:
+    SteadyClock() : _epoch(std::chrono::steady_clock::now()) {}
+
+    double now() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - this->_epoch).count();
+    }
+
+    void sleepUntil(double time) {
+        std::this_thread::sleep_until(toTimePoint(time));
+    }
+
+    std::chrono::steady_clock::time_point toTimePoint(double time) {
+        return this->_epoch + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(time));
+    }
+
+private:
+    std::chrono::steady_clock::time_point _epoch;
+};
+
+class VirtualClock : public CalibrationClock {
+public:
+    VirtualClock() : _time(0) {}
+
+    double now() {
+        return this->_time.load(std::memory_order_relaxed);
+    }
+
+    void sleepUntil(double time) {
+        if (time > now()) {
+            this->_time.store(time, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    std::atomic<double> _time;
+};
+
+#endif /* calibrationClock_h */
@@ -8,7 +8,124 @@
 #include "calibrationPattern.h"
 
 CalibrationPattern::CalibrationPattern() {
+    SteadyClock *clock = new SteadyClock();
+    this->_clock = clock;
+    this->_scheduler = new CalibrationScheduler(clock);
+    this->_headless = false;
+    this->_calibration_target = NULL;
+    this->_distractors = NULL;
+    this->_frame_timer = NULL;
+    this->_trigger = NULL;
+    this->_osc = NULL;
+    this->_remote = NULL;
+    this->_sinks = NULL;
+    this->_sender = NULL;
+    this->_log = NULL;
+    this->_log_close_pending = false;
+    this->_onset_probe = NULL;
+    this->_audio = NULL;
+    this->_applied_step = -1;
+    this->_step_deadline = -1;
+    this->_trace = NULL;
+    this->_metrics = NULL;
+    this->_metrics_endpoint = NULL;
+    this->_trigger_clock = NULL;
+    this->_eye_tracker_clock = NULL;
+    this->_eog = NULL;
+    this->_fixation_detector = NULL;
+    this->_is_recording = false;
+    this->_report_pending = false;
+    this->_state = OFF;
+
+    // the window comes up right away, everything else starts in parallel as far as it can
+    this->_startup = new StartupTasks(clock);
+    this->_startup->add("settings", {}, [this]() {
+        initialize();
+        if (this->_use_metrics == true) {
+            this->_metrics = new Metrics();
+        }
+        return true;
+    });
+    this->_startup->add("pattern", {"settings"}, [this]() {
+        loadPattern();
+        return this->_schedule->size() > 1;
+    });
+    this->_startup->add("network", {"settings"}, [this]() {
+        setupNetwork();
+        return true;
+    });
+    // with async_load the sounds decode on a thread of the cache and sessions may start before,
+    // commands are skipped until then; the audio engine logs through the sender of the network
+    this->_startup->add("sounds", {"pattern", "network"}, [this]() {
+        if (this->_use_audio_engine == true) {
+            setupAudio();
+        } else {
+            this->_sounds->load(this->_load_sounds_async);
+        }
+        return true;
+    });
+    this->_startup->add("eog", {"pattern", "network"}, [this]() {
+        setupEog((NetworkSinks*)this->_sinks);
+        setupAdaptive();
+        return true;
+    });
+    this->_startup->add("marker", {"settings"}, [this]() {
+        setupMarker();
+        return true;
+    }, true, true);
+    this->_startup->start();
+}
+
+CalibrationPattern::CalibrationPattern(CalibrationClock *clock, EventSinks *sinks, string pattern_filename, bool realtime, bool replay) {
+    this->_clock = clock;
+    this->_scheduler = NULL;
+    SteadyClock *steady_clock = dynamic_cast<SteadyClock*>(clock);
+    if ((realtime == true) && (steady_clock != NULL)) {
+        this->_scheduler = new CalibrationScheduler(steady_clock);
+    }
+    this->_headless = true;
+    this->_pattern_settings_filename = pattern_filename;
+    this->_startup = NULL;
+    initialize();
+    loadPattern();
+
+    getPatternPositions(1024, 768);
+    this->_calibration_target = NULL;
+    this->_distractors = NULL;
+    this->_frame_timer = NULL;
+    this->_trigger = NULL;
+    this->_osc = NULL;
+    this->_remote = NULL;
+    this->_trigger_clock = NULL;
+    this->_eye_tracker_clock = NULL;
+    this->_sinks = sinks;
+    this->_sender = new OutboundEventSender(this->_clock, this->_sinks, this->_scheduler != NULL);
+    this->_log = new SessionLog();
+    this->_log_close_pending = false;
+    this->_onset_probe = NULL;
+    this->_audio = NULL;
+    this->_applied_step = -1;
+    this->_step_deadline = -1;
+    this->_trace = NULL;
+    this->_metrics = NULL;
+    this->_metrics_endpoint = NULL;
+    if (replay == true) {
+        // the fixations come from the trace
+        this->_use_eog = false;
+        this->_adaptive = false;
+    }
+    setupEog(NULL);
+    setupAdaptive();
+}
+
+CalibrationPattern::~CalibrationPattern() {
+    delete this->_scheduler;
+    delete this->_sender;
+}
+
+void CalibrationPattern::initialize() {
     // write default settings (if necessary) and load settings
+    string pattern_filename = this->_pattern_settings_filename;
     this->_settings = new ofxXmlSettings();
     bool success = this->_settings->loadFile(this->_settings_filename);
     if (success == false) {
@@ -16,22 +133,76 @@ CalibrationPattern::CalibrationPattern() {
         this->_settings->loadFile(this->_settings_filename);
     }
     loadSettings();
-
+    if (pattern_filename != "") {
+        this->_pattern_settings_filename = pattern_filename;
+    }
+    this->_sounds = new SoundCache();
+    this->_schedule = new PatternSchedule();
     this->_pattern_settings = new ofxXmlSettings();
-    success = this->_pattern_settings->loadFile(this->_pattern_settings_filename);
-    if (success == false) {
+
+    this->_is_recording = false;
+    this->_report_pending = false;
+    this->_current_target = -1;
+    this->_shown_target = -1;
+    this->_cursor = 0;
+    this->_session_start = 0;
+    this->_time_saved = 0;
+    this->_next_transition_time = -1;
+    this->_state = OFF;
+    this->_marker_state = 0;
+    this->_marker_order_position = -1;
+    this->_marker_segment = -1;
+    this->_shown_segment = -1;
+    this->_segment_start = 0;
+    this->_marker_planned_time = 0;
+    this->_marker_generation = 0;
+    this->_shown_generation = 0;
+}
+
+void CalibrationPattern::loadPattern() {
+    if (ofFile::doesFileExist(this->_pattern_settings_filename) == false) {
         writeDefaultPatternSettings();
-        this->_pattern_settings->loadFile(this->_pattern_settings_filename);
     }
     loadPatternSettings();
+    this->_timeline.reset(this->_schedule->size());
+}
 
-    this->_is_recording = false;
+void CalibrationPattern::setupNetwork() {
+    this->_trigger = new UdpTrigger(this->_host_address);
+    this->_trigger->connectToHost();
 
-    if (this->_reference_target > -1) {
-        this->_use_reference = true;
-    } else {
-        this->_use_reference = false;
+    this->_udp.Create();
+    this->_udp.Connect(this->_remote_ip.c_str(), this->_remote_port);
+    this->_udp.SetNonBlocking(true);
+    this->_remote = new RemoteSoundChannel(this->_clock, &this->_udp, this->_remote_acks);
+
+    this->_osc = new ofxOscSender();
+    this->_osc->setup(this->_osc_ip, 8000);
+    this->_osc_events.Create();
+    this->_osc_events.Connect(this->_osc_ip.c_str(), 8000);
+    this->_osc_events.SetNonBlocking(true);
+
+    NetworkSinks *sinks = new NetworkSinks(this->_clock, this->_trigger, this->_osc, &this->_osc_events, this->_remote, &this->_command_sounds, this->_sounds);
+    this->_sinks = sinks;
+    this->_sender = new OutboundEventSender(this->_clock, this->_sinks, true);
+    startClockSync(sinks);
+    this->_log = new SessionLog();
+    if (this->_record_trace == true) {
+        setTrace(new SessionTrace(this->_trace_capacity));
+    }
+    this->_onset_probe = NULL;
+    if (this->_measure_onsets == true) {
+        this->_onset_probe = new OnsetProbe(this->_clock, this->_log);
+    }
+    if (this->_metrics != NULL) {
+        setMetrics(this->_metrics);
+        this->_metrics_endpoint = new MetricsEndpoint(this->_metrics, this->_metrics_port);
+        this->_metrics_endpoint->open();
     }
+}
+
+void CalibrationPattern::setupMarker() {
+    // render thread
     getPatternPositions(ofGetWindowWidth(), ofGetWindowHeight());
     BeepMode mode;
     if (_use_beep == true) {
@@ -42,259 +213,951 @@ CalibrationPattern::CalibrationPattern() {
     if (_use_beeps == true) {
         mode = BeepMode::BEEP_ON_END;
     }
-    // swithc beep mode off on this local machine if remote is used
-    if (this->_use_remote_sound == true) {
+    // swithc beep mode off on this local machine if remote is used, the audio engine plays its own beeps
+    if ((this->_use_remote_sound == true) || (this->_use_audio_engine == true)) {
         mode = BeepMode::BEEP_OFF;
     }
     this->_calibration_target = new Blinky(this->_marker_radius, this->_marker_color, this->_marker_background_color, mode, false, 0.0f);
-    updatePatternPositions(this->_current_target);
+    this->_frame_timer = new FrameTimer(this->_clock, this->_refresh_rate);
+    if (this->_metrics != NULL) {
+        this->_frame_timer->setMetrics(this->_metrics);
+    }
+    this->_frame_epochs = 0;
+    this->_bad_frame_epochs = 0;
+    if (this->_distractor_count > 0) {
+        this->_distractors = new MarkerRenderer();
+        this->_distractors->setup(this->_distractor_count);
+        placeDistractors(ofGetWindowWidth(), ofGetWindowHeight());
+    }
+}
 
-    this->_current_target = -1;
-    this->_current_target_start_time = 0;
-    this->_state = OFF;
-    this->_pause_start_time = 0;
+void CalibrationPattern::placeDistractors(float window_width, float window_height) {
+    // the moving ones come last, so their updates are one contiguous upload
+    this->_distractors->clear();
+    this->_distractor_velocity.assign(this->_distractor_count, ofVec2f(0, 0));
+    int first_moving = this->_distractor_count - std::min(this->_distractor_moving, this->_distractor_count);
+    for (int i = 0; i < this->_distractor_count; i++) {
+        this->_distractors->add(ofVec2f(ofRandom(window_width), ofRandom(window_height)), this->_distractor_radius, this->_distractor_color);
+        if (i >= first_moving) {
+            float direction = ofRandom(TWO_PI);
+            this->_distractor_velocity[i] = ofVec2f(cos(direction), sin(direction)) * this->_distractor_speed;
+        }
+    }
+    this->_distractor_time = this->_clock->now();
+}
 
-    this->_trigger = new UdpTrigger(this->_host_address);
-    this->_trigger->connectToHost();
+void CalibrationPattern::moveDistractors() {
+    double now = this->_clock->now();
+    float dt = now - this->_distractor_time;
+    this->_distractor_time = now;
+    float width = ofGetWindowWidth();
+    float height = ofGetWindowHeight();
+    for (int i = this->_distractor_count - std::min(this->_distractor_moving, this->_distractor_count); i < this->_distractor_count; i++) {
+        // bounce off the window edges
+        ofVec2f position = this->_distractors->getPosition(i) + this->_distractor_velocity[i] * dt;
+        if ((position.x < 0) || (position.x > width)) {
+            this->_distractor_velocity[i].x = -this->_distractor_velocity[i].x;
+        }
+        if ((position.y < 0) || (position.y > height)) {
+            this->_distractor_velocity[i].y = -this->_distractor_velocity[i].y;
+        }
+        this->_distractors->setPosition(i, position);
+    }
+}
 
-    this->_udp.Create();
-    this->_udp.Connect(this->_remote_ip.c_str(), this->_remote_port);
-    this->_udp.SetNonBlocking(true);
+void CalibrationPattern::runHeadless(double until) {
+    // jump (virtual clock) or sleep (steady clock) from transition to transition
+    while ((this->_next_transition_time >= 0) && ((until < 0) || (this->_next_transition_time <= until))) {
+        if ((this->_synthetic_eog != NULL) && (this->_fixation_detector != NULL)) {
+            // let the simulated eye run up to the transition, a fixation it detects moves the transition earlier
+            double time = this->_clock->now();
+            while (time < this->_next_transition_time) {
+                time = std::min(time + 0.01, this->_next_transition_time);
+                this->_synthetic_eog->advance(time);
+            }
+        }
+        if (this->_audio != NULL) {
+            // the cues of the coming step are queued by now
+            this->_audio->advance(this->_next_transition_time);
+        }
+        this->_clock->sleepUntil(this->_next_transition_time);
+        this->_next_transition_time = transition(this->_next_transition_time);
+        if (this->_synthetic_eog != NULL) {
+            this->_synthetic_eog->advance(this->_clock->now());
+            this->_eog->drain();
+        }
+    }
+}
 
-    this->_osc = new ofxOscSender();
-    this->_osc->setup(this->_osc_ip, 8000);
+PatternSchedule* CalibrationPattern::getSchedule() {
+    return this->_schedule;
+}
+
+SessionTimeline* CalibrationPattern::getTimeline() {
+    return &this->_timeline;
+}
+
+double CalibrationPattern::getSessionStart() {
+    return this->_session_start;
 }
 
 void CalibrationPattern::setupProjectEyeTracker() {
-    ofxOscMessage msg = ofxOscMessage();
+    ofxOscMessage &msg = this->_control_message;
+    msg.clear();
     // set project
     msg.setAddress("/set");
     msg.addStringArg("project");
     msg.addStringArg("eog_calibration");
-    _osc->sendMessage(msg);
+    _sender->sendControl(msg);
 }
 
 void CalibrationPattern::setupSubjectEyeTracker() {
-    ofxOscMessage msg = ofxOscMessage();
+    ofxOscMessage &msg = this->_control_message;
+    msg.clear();
     // set participant
     msg.setAddress("/set");
     msg.addStringArg("participant");
     msg.addStringArg(this->_codeword);
-    _osc->sendMessage(msg);
+    _sender->sendControl(msg);
 }
 
 void CalibrationPattern::connectEyeTracker() {
-    ofxOscMessage msg = ofxOscMessage();
+    ofxOscMessage &msg = this->_control_message;
+    msg.clear();
     // connect
     msg.setAddress("/connect");
     msg.addStringArg("?");
     msg.addIntArg(1);
-    _osc->sendMessage(msg);
+    _sender->sendControl(msg);
 }
 
 void CalibrationPattern::streamEyeTracker() {
-    ofxOscMessage msg = ofxOscMessage();
+    ofxOscMessage &msg = this->_control_message;
+    msg.clear();
     // start streaming / wake up cameras
     msg.setAddress("/stream");
     msg.addStringArg("?");
     msg.addIntArg(1);
-    _osc->sendMessage(msg);
+    _sender->sendControl(msg);
 }
 
 void CalibrationPattern::stopRecordingEyeTracker() {
-    ofxOscMessage msg = ofxOscMessage();
+    ofxOscMessage &msg = this->_control_message;
+    msg.clear();
     // stop recording
     msg.setAddress("/record");
     msg.addStringArg("?");
     msg.addIntArg(0);
-    _osc->sendMessage(msg);
+    _sender->sendControl(msg);
 }
 
 void CalibrationPattern::cleanupEyeTracker() {
-    ofxOscMessage msg = ofxOscMessage();
+    ofxOscMessage &msg = this->_control_message;
+    msg.clear();
     // stop streaming
     msg.setAddress("/stream");
     msg.addStringArg("?");
     msg.addIntArg(0);
-    _osc->sendMessage(msg);
+    _sender->sendControl(msg);
 
     // disconnect
+    msg.clear();
     msg.setAddress("/connect");
     msg.addStringArg("?");
     msg.addIntArg(0);
-    _osc->sendMessage(msg);
+    _sender->sendControl(msg);
 }
 
 void CalibrationPattern::calibrateEyeTracker() {
-    ofxOscMessage msg = ofxOscMessage();
+    ofxOscMessage &msg = this->_control_message;
+    msg.clear();
     msg.setAddress("/set");
     msg.addStringArg("calibration");
     msg.addStringArg("?");
-    _osc->sendMessage(msg);
+    _sender->sendControl(msg);
 }
 
 void CalibrationPattern::recordEyeTracker() {
-    ofxOscMessage msg = ofxOscMessage();
+    ofxOscMessage &msg = this->_control_message;
+    msg.clear();
     msg.setAddress("/record");
     msg.addStringArg("?");
     msg.addIntArg(1);
-    _osc->sendMessage(msg);
+    _sender->sendControl(msg);
 }
 
 void CalibrationPattern::sendEyeTrackerEvent(string message){
-    ofxOscMessage msg = ofxOscMessage();
+    ofxOscMessage &msg = this->_control_message;
+    msg.clear();
     msg.setAddress("/set");
     msg.addStringArg("trigger");
     msg.addStringArg(message);
-    _osc->sendMessage(msg);
+    _sender->sendControl(msg);
 }
 
 void CalibrationPattern::resizePattern(float window_width, float window_height) {
+    if (this->_calibration_target == NULL) {
+        // the marker is placed for the window size when it is set up
+        return;
+    }
     getPatternPositions(window_width, window_height);
-    updatePatternPositions(this->_current_target);
+    if (this->_distractors != NULL) {
+        placeDistractors(window_width, window_height);
+    }
+    updatePatternPositions(this->_shown_target);
 }
 
 void CalibrationPattern::draw() {
+    if (isReady() == false) {
+        ofClear(ofColor::black);
+        this->_startup->draw(20, 20);
+        return;
+    }
+    if (this->_calibration_target == NULL) {
+        return;
+    }
     ofClear(ofColor::black);
+    if ((this->_distractors != NULL) && (this->_is_recording == true)) {
+        this->_distractors->draw();
+    }
     this->_calibration_target->draw();
+    if (this->_onset_probe != NULL) {
+        this->_onset_probe->drawn();
+    }
 }
 
-void CalibrationPattern::update() {
-    if (this->_state != OFF) {
-        // stop pattern after last target
-        if (this->_current_target >= this->_number_of_targets) {
-            stopCalibration();
-        }
-
-        // reset pause time when pause duration is over
-        if ((this->_state == PAUSE2REFERENCE) || (this->_state == PAUSE2TARGET)) {
-            if ((ofGetElapsedTimef() - this->_pause_start_time) > this->_pause_duration) {
-                this->_pause_start_time = 0;
-                if ((this->_state == PAUSE2REFERENCE) && (this->_use_reference == true)) {
-                    backToReference();
-                    if (this->_use_remote_sound == true) {
-                        string msg = ofToString(9999);
-                        _udp.Send(msg.c_str(), msg.length());
-                    }
-                    this->_calibration_target->setBlinkyOn(true);
-                } else {
-                    nextTarget();
-                    if (this->_use_remote_sound == true) {
-                        string msg = ofToString(9999);
-                        _udp.Send(msg.c_str(), msg.length());
-                    }
-                    this->_calibration_target->setBlinkyOn(true);
-                }
-            }
-        } else {
-            // stop blinking the curret target and shift to the next
-            if ((ofGetElapsedTimef() - this->_current_target_start_time) > this->_time_per_target) {
-                if ((this->_state == REFERENCE) && (this->_pause_start_time == 0)) {
-                    if ((this->_use_remote_sound == true) && (this->_use_beeps == true)) {
-                        string msg = ofToString(9999);
-                        _udp.Send(msg.c_str(), msg.length());
-                    }
-                    //this->_calibration_target->setBlinkyOn(false);
-                    pause();
-                }
-                if ((this->_state == TARGET) && (this->_pause_start_time == 0)) {
-                    if ((this->_use_remote_sound == true) && (this->_use_beeps == true)) {
-                        string msg = ofToString(9999);
-                        _udp.Send(msg.c_str(), msg.length());
-                    }
-                    //this->_calibration_target->setBlinkyOn(false);
-                    pause();
-                }
-            }
+void CalibrationPattern::drawHud(float x, float y) {
+    if (this->_frame_timer != NULL) {
+        this->_frame_timer->drawHud(x, y);
+    }
+}
+
+void CalibrationPattern::drawStatus(float x, float y) {
+    static const char *state_names[] = {"off", "target", "pause to reference", "reference", "pause to target", "pursuit"};
+    if (isReady() == false) {
+        ofDrawBitmapStringHighlight("starting up", x, y);
+        return;
+    }
+    PatternSchedule &schedule = *this->_schedule;
+    CalibrationStates state = this->_state;
+    string text = this->_codeword + ((this->_is_recording == true) ? ": recording" : ": idle") + "\n"
+        + "state: " + state_names[state];
+    int step = this->_applied_step.load(std::memory_order_relaxed);
+    if ((state != OFF) && (step >= 0) && (step < (int)schedule.size())) {
+        text += ", item " + ofToString(schedule.order_position[step] + 1) + " of " + ofToString(this->_number_of_targets);
+        if ((this->_shown_target > -1) && (this->_shown_segment < 0)) {
+            text += ", target " + ofToString(this->_shown_target);
+        } else if (this->_shown_segment > -1) {
+            text += ", pursuit " + ofToString(this->_shown_segment);
         }
-    } else {
-        if (this->_current_target_start_time > 0) {
-            this->_calibration_target->setBlinkyOn(false);
-            if ((this->_use_remote_sound == true) && (this->_use_beeps == true)) {
-                string msg = ofToString(9999);
-                _udp.Send(msg.c_str(), msg.length());
-            }
-            if (this->_is_recording == true) {
-                this->_trigger->stopRecording();
-                stopRecordingEyeTracker();
+        // the next marker of the schedule
+        for (size_t i = step + 1; i < schedule.size(); i++) {
+            if ((schedule.flags[i] & STEP_MARKER) != 0) {
+                text += ((schedule.flags[i] & STEP_PURSUIT) != 0) ? ", next pursuit " : ", next target ";
+                text += ofToString(schedule.target[i]);
+                break;
             }
-            this->_is_recording = false;
         }
     }
+    text += "\n" + describeClock("trigger host " + this->_host_address, this->_trigger_clock);
+    if (this->_eye_tracker_clock != this->_trigger_clock) {
+        text += "\n" + describeClock("eye tracker " + this->_osc_ip, this->_eye_tracker_clock);
+    }
+    if ((this->_remote != NULL) && (this->_use_remote_sound == true)) {
+        text += "\nremote sound: " + ofToString(this->_remote->getSentCount()) + " sent, " + ofToString(this->_remote->getAckedCount())
+            + " acked, " + ofToString(this->_remote->getLostCount()) + " lost";
+    }
+    if (this->_eog_input != NULL) {
+        text += "\neog input: " + ofToString(this->_eog_input->getReceivedCount()) + " samples, "
+            + ofToString(this->_eog_input->getLostPacketCount()) + " packets lost";
+    }
+    if (this->_sender != NULL) {
+        text += "\nevents: " + ofToString(this->_sender->getSentCount()) + " sent, " + ofToString(this->_sender->getDroppedCount()) + " dropped";
+    }
+    ofDrawBitmapStringHighlight(text, x, y);
+}
 
-    this->_calibration_target->update();
+string CalibrationPattern::describeClock(string peer, ClockSync *sync) {
+    if (sync == NULL) {
+        return peer + ": not synchronized";
+    }
+    ClockEstimate estimate = sync->getEstimate();
+    if (estimate.valid == false) {
+        return peer + ": no answer yet";
+    }
+    return peer + ": offset " + ofToString(estimate.offset * 1000, 2) + " ms, uncertainty " + ofToString(estimate.uncertainty * 1000, 2) + " ms";
 }
 
-void CalibrationPattern::pause() {
-    if ((this->_state == TARGET) && (this->_use_reference == true)) {
-        this->_state = PAUSE2REFERENCE;
-        this->_trigger->sendTrigger(ofToString(this->_current_target));
-        sendEyeTrackerEvent(ofToString(this->_current_target));
-        if (this->_use_commands) {
-            if (this->_use_remote_sound == true) {
-                string msg = ofToString(this->_reference_target);
-                _udp.Send(msg.c_str(), msg.length());
-            } else {
-                if (this->_target_command[this->_reference_target] != NULL) {
-                    this->_target_command[this->_reference_target]->play();
-                }
-            }
+FrameTimer* CalibrationPattern::getFrameTimer() {
+    return this->_frame_timer;
+}
+
+void CalibrationPattern::logFrameEpoch(const FrameEpoch &epoch) {
+    // only markers of a session, not the screen before it
+    if ((epoch.order_position < 0) || (epoch.frames == 0)) {
+        return;
+    }
+    this->_frame_epochs++;
+    if (epoch.missed > 0) {
+        this->_bad_frame_epochs++;
+        ofLogWarning("CalibrationPattern") << "target " << epoch.target << " (position " << epoch.order_position << "): "
+            << epoch.missed << " missed vsyncs in " << epoch.frames << " frames, longest frame " << epoch.max_duration * 1000 << " ms";
+    }
+    SessionLogRecord record;
+    memset(&record, 0, sizeof(record));
+    record.type = LOG_FRAMES;
+    record.state = this->_state;
+    record.target = epoch.target;
+    record.order_position = epoch.order_position;
+    record.reserved = epoch.frames;
+    record.planned_time = epoch.start;
+    record.steady_time = this->_clock->now();
+    record.value = epoch.missed;
+    record.trigger_done = epoch.max_duration;
+    record.osc_done = epoch.update_time / epoch.frames;
+    record.udp_done = epoch.draw_time / epoch.frames;
+    this->_log->append(record);
+}
+
+void CalibrationPattern::reportFrames() {
+    FrameEpoch session = this->_frame_timer->getSession();
+    if (session.frames == 0) {
+        return;
+    }
+    ofLogNotice("CalibrationPattern") << "frames: " << session.frames << ", " << session.missed << " missed vsyncs at "
+        << 1 / std::max(this->_frame_timer->getRefreshPeriod(), 1e-9) << " Hz, " << this->_bad_frame_epochs << " of " << this->_frame_epochs << " targets affected"
+        << ", update " << session.update_time / session.frames * 1000 << " ms (max " << session.max_update_time * 1000 << " ms)"
+        << ", draw " << session.draw_time / session.frames * 1000 << " ms (max " << session.max_draw_time * 1000 << " ms)";
+}
+
+void CalibrationPattern::update() {
+    if (this->_startup != NULL) {
+        this->_startup->poll();
+    }
+    if ((isReady() == false) || (this->_calibration_target == NULL)) {
+        return;
+    }
+    reportSession();
+    if ((this->_trace != NULL) && (this->_is_recording == true)) {
+        this->_trace->record(TRACE_FRAME, this->_applied_step.load(std::memory_order_relaxed), 0, this->_clock->now(), -1);
+    }
+    if (this->_onset_probe != NULL) {
+        this->_onset_probe->swapped();
+    }
+    if (this->_eog != NULL) {
+        this->_eog->drain();
+        // give samples from the end of the pattern a moment to arrive
+        if ((this->_eog_fit_pending == true) && (this->_clock->now() >= this->_eog_fit_time)) {
+            fitEog();
         }
-    } else {
-        this->_state = PAUSE2TARGET;
-        this->_trigger->sendTrigger(ofToString(this->_reference_target));
-        sendEyeTrackerEvent(ofToString(this->_reference_target));
-        if ((this->_current_target+1) < this->_number_of_targets) {
-            if (this->_use_commands) {
-                if (this->_use_remote_sound == true) {
-                    string msg = ofToString(this->_current_target+1);
-                    _udp.Send(msg.c_str(), msg.length());
-                } else {
-                    if (this->_target_command[this->_current_target+1] != NULL) {
-                        this->_target_command[this->_current_target+1]->play();
-                    }
-                }
+    }
+    // follow the marker published by the scheduler thread
+    unsigned int generation = this->_marker_generation.load(std::memory_order_acquire);
+    if (generation != this->_shown_generation) {
+        this->_shown_generation = generation;
+        int marker = this->_marker_state.load(std::memory_order_relaxed);
+        int target = (marker >> 1) - 1;
+        double planned_time = this->_marker_planned_time.load(std::memory_order_relaxed);
+        this->_shown_segment = this->_marker_segment.load(std::memory_order_relaxed);
+        this->_segment_start = planned_time;
+        int order_position = this->_marker_order_position.load(std::memory_order_relaxed);
+        logFrameEpoch(this->_frame_timer->startEpoch(planned_time, target, order_position));
+        if ((target > -1) || (this->_shown_segment > -1)) {
+            this->_shown_target = target;
+            updatePatternPositions(target);
+            if (this->_onset_probe != NULL) {
+                this->_onset_probe->markerChanged(planned_time, target, order_position);
+            }
+        } else {
+            // the pattern finished
+            reportFrames();
+            if (this->_onset_probe != NULL) {
+                this->_onset_probe->report();
             }
         }
+        this->_calibration_target->setBlinkyOn((marker & 1) == 1);
+    }
+    if (this->_log_close_pending == true) {
+        // the marker of the end was followed above, its frames are in the log
+        this->_log_close_pending = false;
+        closeSessionLog();
+    }
+    if (this->_shown_segment > -1) {
+        // smooth pursuit, one interpolated read of the trajectory per frame
+        ofVec2f point = this->_schedule->getTrajectoryPoint(this->_shown_segment, this->_clock->now() - this->_segment_start);
+        this->_calibration_target->setPosition(this->_layout.map(point.x, point.y));
+    }
+    if (this->_distractors != NULL) {
+        moveDistractors();
+    }
+    this->_calibration_target->update();
+}
+
+double CalibrationPattern::transition(double planned_time) {
+    // runs on the scheduler thread, returns the planned time of the next transition
+    double compiled_time = plannedOnset(this->_cursor);
+    if (planned_time < compiled_time) {
+        // a fixation ended the step early, everything after it moves up
+        this->_time_saved += compiled_time - planned_time;
+        this->_early_fixations++;
+    }
+    applyStep(this->_cursor, planned_time);
+    if ((this->_schedule->flags[this->_cursor] & STEP_FINISH) != 0) {
+        finishCalibration(planned_time);
+        return -1;
+    }
+    this->_cursor++;
+    return plannedOnset(this->_cursor);
+}
+
+double CalibrationPattern::plannedOnset(size_t step) {
+    return this->_session_start + this->_schedule->onset[step] - this->_time_saved;
+}
+
+void CalibrationPattern::applyStep(size_t step, double planned_time) {
+    const PatternSchedule &schedule = *this->_schedule;
+    uint8_t flags = schedule.flags[step];
+    // when the step ends unless a fixation ends it earlier, before the step itself is published
+    this->_step_deadline.store((step + 1 < this->_schedule->size()) ? plannedOnset(step + 1) : -1, std::memory_order_relaxed);
+    this->_applied_step.store(step, std::memory_order_release);
+    this->_state = (CalibrationStates)schedule.state[step];
+    this->_current_target = schedule.order_position[step];
+    OutboundEvent event = makeEvent(EVENT_TRANSITION, planned_time);
+    bool pursuit = (flags & STEP_PURSUIT) != 0;
+    event.target = pursuit ? -1 : schedule.target[step];
+    event.order_position = schedule.order_position[step];
+    event.step = step;
+    event.trigger = schedule.trigger[step];
+    event.remote_command = schedule.remote_command[step];
+    event.local_command = schedule.sound[step];
+    event.remote_beep = (flags & STEP_REMOTE_BEEP) != 0;
+    if (this->_audio != NULL) {
+        // queued to the engine below
+        event.local_command = -1;
+    }
+    if ((flags & STEP_MARKER) != 0) {
+        publishMarker(event.target, pursuit ? schedule.target[step] : -1, event.order_position, (flags & STEP_BLINKY_ON) != 0, planned_time);
+    }
+    this->_timeline.setOnset(step, planned_time);
+    if (this->_fixation_detector != NULL) {
+        armFixation(step, planned_time);
+    }
+    this->_sender->push(event);
+    if (this->_audio != NULL) {
+        scheduleCues(step, planned_time);
     }
-    this->_pause_start_time = ofGetElapsedTimef();
 }
 
-void CalibrationPattern::nextTarget() {
-    this->_state = TARGET;
-    this->_current_target++;
-    updatePatternPositions(this->_current_target);
-    this->_current_target_start_time = ofGetElapsedTimef();
-    this->_trigger->sendTrigger(ofToString(this->_current_target));
-    sendEyeTrackerEvent(ofToString(this->_current_target));
+void CalibrationPattern::scheduleCues(size_t step, double planned_time) {
+    // the cues of the next step are queued one step ahead, so they start on their sample;
+    // a step a fixation may end early has no fixed end, the cues after it start as soon as they can
+    if ((int)step != this->_cued_step) {
+        cueStep(step, planned_time);
+    }
+    PatternSchedule &schedule = *this->_schedule;
+    uint8_t flags = schedule.flags[step];
+    bool fixed_end = (this->_fixation_detector == NULL) || ((flags & STEP_MARKER) == 0) || ((flags & STEP_PURSUIT) != 0);
+    if ((fixed_end == true) && ((flags & STEP_FINISH) == 0) && (step + 1 < schedule.size())) {
+        cueStep(step + 1, plannedOnset(step + 1));
+        this->_cued_step = step + 1;
+    }
 }
 
-void CalibrationPattern::backToReference() {
-    this->_state = REFERENCE;
-    updatePatternPositions(this->_reference_target);
-    this->_current_target_start_time = ofGetElapsedTimef();
-    this->_trigger->sendTrigger(ofToString(this->_reference_target));
-    sendEyeTrackerEvent(ofToString(this->_reference_target));
+void CalibrationPattern::cueStep(size_t step, double time) {
+    const PatternSchedule &schedule = *this->_schedule;
+    int sound = schedule.sound[step];
+    if ((sound > -1) && (sound < (int)this->_command_clips.size()) && (this->_command_clips[sound] > -1)) {
+        this->_audio->schedule(this->_command_clips[sound], time, step);
+    }
+    if (this->_use_remote_sound == true) {
+        return;
+    }
+    // the beeps Blinky played: with <always> at every pause, with <once> at every marker
+    uint8_t state = schedule.state[step];
+    bool beep = false;
+    if (this->_use_beeps == true) {
+        beep = (step > 0) && ((state == PAUSE2TARGET) || (state == PAUSE2REFERENCE));
+    } else if (this->_use_beep == true) {
+        beep = (schedule.flags[step] & STEP_MARKER) != 0;
+    }
+    if (beep == true) {
+        this->_audio->schedule(this->_beep_clip, time, step);
+    }
+}
+
+void CalibrationPattern::armFixation(size_t step, double planned_time) {
+    PatternSchedule &schedule = *this->_schedule;
+    uint8_t flags = schedule.flags[step];
+    bool fixation = ((flags & STEP_MARKER) != 0) && ((flags & STEP_PURSUIT) == 0) && (step + 1 < schedule.size());
+    if (fixation == false) {
+        this->_fixation_detector->disarm();
+        return;
+    }
+    // the time per target stays the timeout
+    int target = schedule.target[step];
+    this->_fixation_detector->arm(planned_time, plannedOnset(step + 1), target == this->_last_fixation_target,
+        this->_layout.getNormalized(target), this->_adaptive_gaze ? this->_fixation_radius : 0);
+    this->_last_fixation_target = target;
+    this->_armed_fixations++;
+}
+
+void CalibrationPattern::fixationDetected(double deadline, double time) {
+    // input thread (or the headless loop); the step is read first, the transition may run right away
+    int step = this->_applied_step.load(std::memory_order_acquire);
+    if (this->_scheduler != NULL) {
+        // the transition runs right away if the fixation came in late
+        time = this->_scheduler->advance(deadline, time);
+    } else if (this->_next_transition_time == deadline) {
+        this->_next_transition_time = time;
+    } else {
+        time = -1;
+    }
+    if ((time >= 0) && (this->_trace != NULL)) {
+        this->_trace->record(TRACE_FIXATION, step, 0, time, deadline);
+    }
+}
+
+bool CalibrationPattern::replayFixation(int step, double time) {
+    // ends the step like the fixation detector did, if the step is still shown
+    if (this->_applied_step.load(std::memory_order_acquire) != step) {
+        return false;
+    }
+    double deadline = this->_step_deadline.load(std::memory_order_relaxed);
+    if ((deadline < 0) || (time >= deadline)) {
+        return false;
+    }
+    fixationDetected(deadline, time);
+    return true;
+}
+
+void CalibrationPattern::setTrace(SessionTrace *trace) {
+    this->_trace = trace;
+    this->_sender->setTrace(trace);
+}
+
+void CalibrationPattern::setMetrics(Metrics *metrics) {
+    this->_metrics = metrics;
+    this->_sender->setMetrics(metrics);
+    if (this->_scheduler != NULL) {
+        this->_scheduler->setMetrics(metrics);
+    }
+    NetworkSinks *sinks = dynamic_cast<NetworkSinks*>(this->_sinks);
+    if (sinks != NULL) {
+        sinks->setMetrics(metrics);
+    }
+}
+
+void CalibrationPattern::traceKey(int key) {
+    if ((this->_trace != NULL) && (this->_is_recording == true)) {
+        this->_trace->record(TRACE_KEY, this->_applied_step.load(std::memory_order_relaxed), key, this->_clock->now(), -1);
+    }
+}
+
+OutboundEvent CalibrationPattern::makeEvent(OutboundEventType type, double planned_time) {
+    OutboundEvent event;
+    event.type = type;
+    event.state = this->_state;
+    event.target = -1;
+    event.order_position = -1;
+    event.step = -1;
+    event.trigger = NO_TRIGGER;
+    event.remote_command = -1;
+    event.local_command = -1;
+    event.remote_beep = false;
+    event.planned_time = planned_time;
+    event.queued_time = this->_sender->now();
+    return event;
+}
+
+void CalibrationPattern::publishMarker(int target, int segment, int order_position, bool blinky_on, double planned_time) {
+    this->_marker_planned_time.store(planned_time, std::memory_order_relaxed);
+    this->_marker_order_position.store(order_position, std::memory_order_relaxed);
+    this->_marker_segment.store(segment, std::memory_order_relaxed);
+    // pack target and blink state so the render thread always reads a consistent pair
+    this->_marker_state.store(((target + 1) << 1) | (blinky_on ? 1 : 0), std::memory_order_relaxed);
+    this->_marker_generation.fetch_add(1, std::memory_order_release);
 }
 
 void CalibrationPattern::startCalibration() {
-    this->_trigger->startRecording();
-    this->_state = REFERENCE;
-    pause();
+    if (isReady() == false) {
+        ofLogWarning("CalibrationPattern") << "still starting up, not starting a session";
+        return;
+    }
+    if (this->_schedule->size() < 2) {
+        ofLogError("CalibrationPattern") << "no pattern loaded";
+        return;
+    }
+    // the last session's events are out before the new log opens, its statistics are not counted for this one
+    this->_sender->flush();
+    this->_sender->resetStats();
+    if (this->_scheduler != NULL) {
+        this->_scheduler->resetStats();
+    }
+    openSessionLog();
+    if (this->_trace != NULL) {
+        // the trace of the last session was saved when it ended
+        this->_trace->start(this->_codeword, this->_pattern_settings_filename, this->_clock->getEpochUnixTime());
+    }
+    if (this->_remote != NULL) {
+        this->_remote->startSession();
+    }
+    if (this->_onset_probe != NULL) {
+        this->_onset_probe->reset();
+    }
+    if (this->_frame_timer != NULL) {
+        this->_frame_timer->resetSession();
+        this->_frame_epochs = 0;
+        this->_bad_frame_epochs = 0;
+    }
+    double now = this->_clock->now();
+    this->_session_start = now;
+    this->_time_saved = 0;
+    this->_timeline.reset(this->_schedule->size());
+    this->_armed_fixations = 0;
+    this->_early_fixations = 0;
+    this->_last_fixation_target = -1;
+    if (this->_eog != NULL) {
+        if (this->_eog_fit_pending == true) {
+            fitEog();
+        }
+        if (this->_synthetic_eog != NULL) {
+            this->_synthetic_eog->startSession(now);
+        }
+        this->_eog->startSession(now);
+    }
+    if (this->_trace != NULL) {
+        this->_trace->record(TRACE_START, 0, this->_schedule->size(), now, -1);
+    }
+    this->_sender->push(makeEvent(EVENT_START_RECORDING, now));
+    this->_cued_step = -1;
+    if (this->_audio != NULL) {
+        this->_audio->resetStats();
+    }
+    // the first step is the pause before the first target
+    this->_cursor = 0;
+    applyStep(this->_cursor, now);
+    this->_cursor++;
     this->_is_recording = true;
+    this->_next_transition_time = plannedOnset(this->_cursor);
+    if (this->_scheduler != NULL) {
+        this->_scheduler->start([this](double planned_time) { return transition(planned_time); }, this->_next_transition_time);
+    }
 }
 
 void CalibrationPattern::stopCalibration() {
+    if (this->_scheduler != NULL) {
+        this->_scheduler->stop();
+    }
+    if (this->_audio != NULL) {
+        // the command of the next step may be queued already
+        this->_audio->cancel();
+    }
+    this->_next_transition_time = -1;
+    if (this->_state != OFF) {
+        double now = this->_clock->now();
+        if (this->_trace != NULL) {
+            this->_trace->record(TRACE_STOP, this->_applied_step.load(), 0, now, -1);
+        }
+        finishCalibration(now);
+    }
+    if (this->_eog_fit_pending == true) {
+        fitEog();
+    }
+}
+
+bool CalibrationPattern::loadParticipant(string participant) {
+    if (this->_is_recording == true) {
+        ofLogError("CalibrationPattern") << "cannot switch to " << participant << " while a session is running";
+        return false;
+    }
+    // the pattern of a codeword is <codeword>.xml, as for the name in the settings
+    string codeword = participant;
+    string pattern_filename = participant + ".xml";
+    if (ofFilePath::getFileExt(participant) == "xml") {
+        codeword = ofFilePath::getBaseName(participant);
+        pattern_filename = participant;
+    }
+    if (ofFile::doesFileExist(pattern_filename) == false) {
+        ofLogError("CalibrationPattern") << "no pattern " << pattern_filename << " for " << codeword;
+        return false;
+    }
+    // the previous session is done with the schedule and the command sounds before they are replaced
+    if (this->_scheduler != NULL) {
+        this->_scheduler->stop();
+    }
+    this->_sender->flush();
+    if (this->_eog_fit_pending == true) {
+        fitEog();
+    }
+    if (this->_synthetic_eog != NULL) {
+        this->_synthetic_eog->stopSession();
+    }
+    this->_codeword = codeword;
+    this->_pattern_settings_filename = pattern_filename;
+    loadPatternSettings();
+    // only the sounds no earlier pattern used
+    if (this->_audio != NULL) {
+        registerAudioClips();
+        this->_audio->load();
+    } else if (this->_headless == false) {
+        this->_sounds->load(this->_load_sounds_async);
+    }
+    this->_timeline.reset(this->_schedule->size());
+    ofLogNotice("CalibrationPattern") << "participant " << codeword << ": " << pattern_filename << ", " << this->_schedule->size() << " steps";
+    setupSubjectEyeTracker();
+    return this->_schedule->size() > 1;
+}
+
+string CalibrationPattern::getCodeword() {
+    return this->_codeword;
+}
+
+void CalibrationPattern::finishCalibration(double planned_time) {
     this->_state = OFF;
     this->_current_target = -1;
-    this->_trigger->stopRecording();
+    OutboundEvent event = makeEvent(EVENT_STOP_RECORDING, planned_time);
+    event.remote_beep = (this->_use_remote_sound == true) && (this->_use_beeps == true);
+    this->_sender->push(event);
     this->_is_recording = false;
+    publishMarker(-1, -1, -1, false, planned_time);
+    // the reports allocate, they are written by reportSession() off the transition path
+    this->_report_pending = true;
+    if (this->_eog != NULL) {
+        // fitted by the thread that drains the samples
+        this->_eog_fit_time = planned_time + 0.1;
+        this->_eog_fit_pending = true;
+    }
+}
+
+void CalibrationPattern::reportSession() {
+    if ((this->_headless == true) && (this->_eog_fit_pending == true)) {
+        fitEog();
+    }
+    if (this->_report_pending.exchange(false) == false) {
+        return;
+    }
+    if ((this->_trace != NULL) && (this->_trace_filename != "")) {
+        // the stop recording event is the last one of the session
+        this->_sender->flush();
+        if (this->_trace->save(this->_trace_filename) == true) {
+            ofLogNotice("CalibrationPattern") << "trace of " << this->_trace->getCount() << " records in " << this->_trace_filename;
+        }
+    }
+    if (this->_scheduler != NULL) {
+        ofLogNotice("CalibrationPattern") << "transitions: " << this->_scheduler->getTransitionCount()
+            << ", mean lateness: " << this->_scheduler->getMeanLateness() * 1000 << " ms"
+            << ", max lateness: " << this->_scheduler->getMaxLateness() * 1000 << " ms";
+    }
+    ofLogNotice("CalibrationPattern") << "events sent: " << this->_sender->getSentCount()
+        << ", dropped: " << this->_sender->getDroppedCount()
+        << ", max queue depth: " << this->_sender->getMaxDepth()
+        << ", mean send latency: " << this->_sender->getMeanSendLatency() * 1000 << " ms"
+        << ", max send latency: " << this->_sender->getMaxSendLatency() * 1000 << " ms";
+    if ((this->_remote != NULL) && (this->_use_remote_sound == true)) {
+        this->_remote->report();
+    }
+    if (this->_fixation_detector != NULL) {
+        double compiled_duration = this->_schedule->onset[this->_schedule->size() - 1];
+        ofLogNotice("CalibrationPattern") << "adaptive: " << this->_early_fixations << " of " << this->_armed_fixations
+            << " fixations ended early, saved " << this->_time_saved << " s of " << compiled_duration << " s ("
+            << 100 * this->_time_saved / std::max(compiled_duration, 1e-9) << " %)";
+    }
+    if (this->_audio != NULL) {
+        ofLogNotice("CalibrationPattern") << "audio cues: " << this->_audio->getCueCount()
+            << ", " << this->_audio->getLateCount() << " late (max " << this->_audio->getMaxLateness() * 1000 << " ms)"
+            << ", max error of the others " << this->_audio->getMaxError() * 1e6 << " us"
+            << ", dropped: " << this->_audio->getDroppedCount() << ", device resyncs: " << this->_audio->getResyncCount();
+    }
+    logClockEstimate("trigger host", this->_trigger_clock);
+    if (this->_eye_tracker_clock != this->_trigger_clock) {
+        logClockEstimate("eye tracker", this->_eye_tracker_clock);
+    }
+    if (this->_frame_timer != NULL) {
+        // called from update(), which closes it after the frames of the last marker
+        this->_log_close_pending = true;
+    } else {
+        closeSessionLog();
+    }
+}
+
+void CalibrationPattern::attachAudio(AudioEngine *audio) {
+    this->_audio = audio;
+    registerAudioClips();
+    this->_beep_clip = audio->addTone(1000, 0.1f);
+    audio->load();
+    this->_sender->setAudioEngine(audio);
+}
+
+void CalibrationPattern::useLocalSound() {
+    this->_use_remote_sound = false;
+    this->_use_beeps = true;
+    loadPatternSettings();
+}
+
+void CalibrationPattern::setupAudio() {
+    // sounds task, the window is up but no session runs
+    AudioBackend backend = AUDIO_DEVICE;
+    if (this->_audio_output == "null") {
+        backend = AUDIO_NULL;
+    } else if (this->_audio_output == "file") {
+        backend = AUDIO_FILE;
+    }
+    AudioEngine *audio = new AudioEngine(this->_clock, this->_audio_rate, this->_audio_buffer);
+    if (audio->start(backend, this->_audio_latency, this->_audio_file) == false) {
+        ofLogWarning("CalibrationPattern") << "no audio engine, commands are played by the transitions";
+        delete audio;
+        this->_sounds->load(this->_load_sounds_async);
+        return;
+    }
+    attachAudio(audio);
+}
+
+void CalibrationPattern::registerAudioClips() {
+    // by file, items repeating a command share one clip
+    const vector<string> &sound_files = this->_schedule->getSoundFiles();
+    this->_command_clips.clear();
+    for (size_t i = 0; i < sound_files.size(); i++) {
+        this->_command_clips.push_back((sound_files[i] == "") ? -1 : this->_audio->getClip(sound_files[i]));
+    }
+}
+
+void CalibrationPattern::setupEog(NetworkSinks *sinks) {
+    this->_eog_ring = NULL;
+    this->_eog_drift = NULL;
+    this->_eog_input = NULL;
+    this->_synthetic_eog = NULL;
+    this->_eog = NULL;
+    this->_eog_fit_pending = false;
+    this->_eog_fit_time = 0;
+    // realtime headless runs have no thread that drains the samples
+    if ((this->_use_eog == false) || ((this->_headless == true) && (this->_scheduler != NULL))) {
+        return;
+    }
+    this->_eog_ring = new EogRing();
+    this->_eog_drift = new EogDriftTracker(this->_eog_drift_memory);
+    this->_eog = new EogCalibration(this->_schedule, &this->_timeline, &this->_layout, this->_eog_ring, this->_eog_drift, this->_eog_settle, this->_eog_degree);
+    if (sinks != NULL) {
+        sinks->setDriftTracker(this->_eog_drift);
+    }
+    if ((this->_headless == true) || (this->_eog_synthetic == true)) {
+        this->_synthetic_eog = new SyntheticEog(this->_clock, this->_schedule, &this->_timeline, &this->_layout, this->_eog_ring, this->_eog_rate);
+        return;
+    }
+    this->_eog_input = new EogInput(this->_clock, this->_eog_ring, this->_eog_port);
+}
+
+void CalibrationPattern::setupAdaptive() {
+    this->_fixation_detector = NULL;
+    this->_gaze_input = NULL;
+    this->_armed_fixations = 0;
+    this->_early_fixations = 0;
+    this->_last_fixation_target = -1;
+    bool available = (this->_adaptive == true) && ((this->_headless == false) || (this->_scheduler == NULL));
+    if ((available == true) && (this->_adaptive_gaze == false) && (this->_eog == NULL)) {
+        ofLogWarning("CalibrationPattern") << "adaptive mode on eog needs the eog input, using fixed target durations";
+        available = false;
+    }
+    if ((available == true) && (this->_adaptive_gaze == true) && (this->_headless == true)) {
+        ofLogWarning("CalibrationPattern") << "no gaze input in headless runs, using fixed target durations";
+        available = false;
+    }
+    if (available == true) {
+        this->_fixation_detector = new FixationDetector(this->_fixation_duration, this->_fixation_dispersion,
+            [this](double deadline, double time) { fixationDetected(deadline, time); });
+        if (this->_adaptive_gaze == true) {
+            this->_gaze_input = new OscGazeInput(this->_clock, this->_fixation_detector, this->_gaze_port, this->_gaze_address);
+            this->_gaze_input->open();
+        } else if (this->_eog_input != NULL) {
+            this->_eog_input->setFixationDetector(this->_fixation_detector);
+        } else {
+            this->_synthetic_eog->setFixationDetector(this->_fixation_detector);
+        }
+    }
+    startEog();
+}
+
+void CalibrationPattern::startEog() {
+    // the input threads start once the fixation detector is in place
+    if (this->_eog_input != NULL) {
+        this->_eog_input->open();
+    }
+    if ((this->_synthetic_eog != NULL) && (this->_headless == false)) {
+        this->_synthetic_eog->start();
+    }
+}
+
+void CalibrationPattern::fitEog() {
+    this->_eog_fit_pending = false;
+    this->_eog->fit();
+    if (this->_eog_input != NULL) {
+        ofLogNotice("CalibrationPattern") << "eog input: " << this->_eog_input->getReceivedCount() << " samples received, "
+            << this->_eog_input->getDroppedCount() << " dropped, " << this->_eog_input->getLostPacketCount() << " packets lost";
+    }
+}
+
+void CalibrationPattern::startClockSync(NetworkSinks *sinks) {
+    this->_trigger_clock = NULL;
+    this->_eye_tracker_clock = NULL;
+    if (this->_sync_clocks == false) {
+        return;
+    }
+    // the local stand-in answers for both peers
+    string trigger_host = this->_sync_local ? "127.0.0.1" : this->_host_address;
+    string eye_tracker = this->_sync_local ? "127.0.0.1" : this->_osc_ip;
+    this->_trigger_clock = new ClockSync(this->_clock, trigger_host, this->_sync_port, this->_sync_interval);
+    this->_trigger_clock->start();
+    this->_eye_tracker_clock = this->_trigger_clock;
+    if (eye_tracker != trigger_host) {
+        this->_eye_tracker_clock = new ClockSync(this->_clock, eye_tracker, this->_sync_port, this->_sync_interval);
+        this->_eye_tracker_clock->start();
+    }
+    sinks->setClockSync(this->_eye_tracker_clock);
+    this->_sender->setClockSyncs(this->_trigger_clock, this->_eye_tracker_clock);
+}
+
+void CalibrationPattern::logClockEstimate(string peer, ClockSync *sync) {
+    if (sync == NULL) {
+        return;
+    }
+    ClockEstimate estimate = sync->getEstimate();
+    if (estimate.valid == false) {
+        ofLogWarning("CalibrationPattern") << peer << " clock (" << sync->getHost() << "): no estimate yet";
+        return;
+    }
+    ofLogNotice("CalibrationPattern") << peer << " clock (" << sync->getHost() << "): offset " << estimate.offset * 1000 << " ms"
+        << ", drift " << estimate.drift * 1e6 << " ppm"
+        << ", uncertainty " << estimate.uncertainty * 1000 << " ms"
+        << " from " << estimate.samples << " samples";
+}
+
+void CalibrationPattern::openSessionLog() {
+    if (this->_headless == true) {
+        return;
+    }
+    // every session gets its own log, the previous one is complete once the queue is flushed
+    this->_sender->setLog(NULL);
+    ofDirectory::createDirectory("logs", true, true);
+    string filename = "logs/" + this->_codeword + "_" + ofGetTimestampString("%Y%m%d-%H%M%S") + ".evlog";
+    this->_trace_filename = ofFilePath::removeExt(filename) + ".evtrace";
+    if (this->_log->open(filename, this->_codeword, this->_log_capacity, this->_clock->getEpochUnixTime()) == true) {
+        this->_sender->setLog(this->_log);
+    }
+}
+
+void CalibrationPattern::closeSessionLog() {
+    // synced and cut to its records right away, not when the next session opens one
+    this->_sender->setLog(NULL);
+    this->_log->close();
 }
 
 bool CalibrationPattern::isRunning() {
     return this->_is_recording;
 }
 
+bool CalibrationPattern::isReady() {
+    return (this->_startup == NULL) || (this->_startup->isReady() == true);
+}
+
 void CalibrationPattern::loadSettings() {
     this->_settings->pushTag("calibration");
     {
@@ -338,8 +1201,163 @@ void CalibrationPattern::loadSettings() {
         {
             this->_remote_ip = this->_settings->getValue("ip", "");
             this->_remote_port = this->_settings->getValue("port", 0);
+            // the receiver echoes every command, for round-trip time and loss
+            this->_remote_acks = this->_settings->getValue("ack", 0);
         }
         this->_settings->popTag();
+        // sections added later may be missing in older settings files
+        this->_log_capacity = 65536;
+        this->_record_trace = false;
+        this->_trace_capacity = 262144;
+        if (this->_settings->tagExists("log") == true) {
+            this->_settings->pushTag("log");
+            this->_log_capacity = this->_settings->getValue("capacity", 65536);
+            // inputs and outputs of every session next to its log, for --replay
+            this->_record_trace = this->_settings->getValue("trace", 0);
+            this->_trace_capacity = this->_settings->getValue("trace_capacity", 262144);
+            this->_settings->popTag();
+        }
+        this->_use_metrics = false;
+        this->_metrics_port = 9101;
+        if (this->_settings->tagExists("metrics") == true) {
+            this->_settings->pushTag("metrics");
+            // counters and histograms for a dashboard, see bin/data/metrics_poll.py
+            this->_use_metrics = this->_settings->getValue("enabled", 0);
+            this->_metrics_port = this->_settings->getValue("port", 9101);
+            this->_settings->popTag();
+        }
+        this->_load_sounds_async = false;
+        this->_use_audio_engine = false;
+        this->_audio_output = "device";
+        this->_audio_rate = 48000;
+        this->_audio_buffer = 128;
+        this->_audio_latency = 0.01f;
+        this->_audio_file = "audio_out.wav";
+        if (this->_settings->tagExists("sound") == true) {
+            this->_settings->pushTag("sound");
+            this->_load_sounds_async = this->_settings->getValue("async_load", 0);
+            // commands and beeps from the audio engine, scheduled to the sample instead of played by the transitions
+            this->_use_audio_engine = this->_settings->getValue("engine", 0);
+            // device, null or file (a wav file of everything played)
+            this->_audio_output = this->_settings->getValue("output", "device");
+            this->_audio_rate = this->_settings->getValue("rate", 48000);
+            this->_audio_buffer = this->_settings->getValue("buffer", 128);
+            // seconds from the device callback to the speaker, measure it with a microphone or loopback cable
+            this->_audio_latency = this->_settings->getValue("latency", 0.01f);
+            this->_audio_file = this->_settings->getValue("file", "audio_out.wav");
+            this->_settings->popTag();
+        }
+        this->_measure_onsets = false;
+        if (this->_settings->tagExists("onset") == true) {
+            this->_settings->pushTag("onset");
+            this->_measure_onsets = this->_settings->getValue("measure", 0);
+            this->_settings->popTag();
+        }
+        this->_sync_clocks = false;
+        this->_sync_local = false;
+        this->_sync_port = 12346;
+        this->_sync_interval = 1.0f;
+        if (this->_settings->tagExists("sync") == true) {
+            this->_settings->pushTag("sync");
+            this->_sync_clocks = this->_settings->getValue("enabled", 0);
+            // exchange with a responder on this machine instead of the peers
+            this->_sync_local = this->_settings->getValue("local", 0);
+            this->_sync_port = this->_settings->getValue("port", 12346);
+            this->_sync_interval = this->_settings->getValue("interval", 1.0f);
+            this->_settings->popTag();
+        }
+        this->_use_eog = false;
+        this->_eog_synthetic = false;
+        this->_eog_port = 12347;
+        this->_eog_rate = 500;
+        this->_eog_settle = 0.3f;
+        this->_eog_degree = 1;
+        this->_eog_drift_memory = 10;
+        if (this->_settings->tagExists("eog") == true) {
+            this->_settings->pushTag("eog");
+            this->_use_eog = this->_settings->getValue("enabled", 0);
+            this->_eog_port = this->_settings->getValue("port", 12347);
+            // generate samples instead of receiving them, headless runs always do
+            this->_eog_synthetic = this->_settings->getValue("synthetic", 0);
+            this->_eog_rate = this->_settings->getValue("rate", 500.0f);
+            // seconds after a target appears that are left out of its fixation
+            this->_eog_settle = this->_settings->getValue("settle", 0.3f);
+            // 1 fits a linear map, 2 or 3 a polynomial
+            this->_eog_degree = this->_settings->getValue("degree", 1);
+            // reference fixations it takes the drift estimate to forget older ones
+            this->_eog_drift_memory = this->_settings->getValue("drift_memory", 10.0f);
+            this->_settings->popTag();
+        }
+        this->_adaptive = false;
+        this->_adaptive_gaze = false;
+        this->_gaze_port = 9000;
+        this->_gaze_address = "/gaze";
+        this->_fixation_duration = 0.4f;
+        this->_fixation_dispersion = 40;
+        this->_fixation_radius = 0.1f;
+        if (this->_settings->tagExists("adaptive") == true) {
+            this->_settings->pushTag("adaptive");
+            this->_adaptive = this->_settings->getValue("enabled", 0);
+            // eog: the samples of the eog input, gaze: osc messages <address> x y (normalized) from the eye tracker
+            this->_adaptive_gaze = (this->_settings->getValue("source", "eog") == "gaze");
+            this->_gaze_port = this->_settings->getValue("port", 9000);
+            this->_gaze_address = this->_settings->getValue("address", "/gaze");
+            // seconds the input has to stay within the dispersion to end a target,
+            // in microvolts for eog and normalized to the window for gaze
+            this->_fixation_duration = this->_settings->getValue("fixation", 0.4f);
+            if (this->_adaptive_gaze == true) {
+                this->_fixation_dispersion = this->_settings->getValue("gaze_dispersion", 0.05f);
+            } else {
+                this->_fixation_dispersion = this->_settings->getValue("dispersion", 40.0f);
+            }
+            // gaze only: how far from the target the fixation may be
+            this->_fixation_radius = this->_settings->getValue("radius", 0.1f);
+            this->_settings->popTag();
+        }
+        this->_refresh_rate = 0;
+        if (this->_settings->tagExists("frames") == true) {
+            this->_settings->pushTag("frames");
+            // of the participant display in Hz, 0 estimates it from the frame durations
+            this->_refresh_rate = this->_settings->getValue("refresh", 0.0f);
+            this->_settings->popTag();
+        }
+        this->_distractor_count = 0;
+        this->_distractor_moving = 0;
+        this->_distractor_radius = 10;
+        this->_distractor_speed = 100;
+        this->_distractor_color = ofColor(128, 128, 128);
+        if (this->_settings->tagExists("distractors") == true) {
+            this->_settings->pushTag("distractors");
+            // markers at random positions during a session, <moving> of them drift with <speed> pixels per second
+            this->_distractor_count = this->_settings->getValue("count", 0);
+            this->_distractor_moving = this->_settings->getValue("moving", 0);
+            this->_distractor_radius = this->_settings->getValue("radius", 10.0f);
+            this->_distractor_speed = this->_settings->getValue("speed", 100.0f);
+            this->_distractor_color = ofColor(this->_settings->getValue("red", 128), this->_settings->getValue("green", 128), this->_settings->getValue("blue", 128));
+            this->_settings->popTag();
+        }
+        this->_layout.makeDefault();
+        if (this->_settings->tagExists("layout") == true) {
+            this->_settings->pushTag("layout");
+            {
+                // positions are normalized, 0/0 is the top left and 1/1 the bottom right target
+                string type = this->_settings->getValue("type", "default");
+                if (type == "grid") {
+                    this->_layout.makeGrid(this->_settings->getValue("columns", 3), this->_settings->getValue("rows", 3));
+                } else if (type == "polar") {
+                    this->_layout.makePolar(this->_settings->getValue("rings", 2), this->_settings->getValue("spokes", 8));
+                } else if (type == "custom") {
+                    this->_layout.clear();
+                    int number_of_targets = this->_settings->getNumTags("target");
+                    for (int i = 0; i < number_of_targets; i++) {
+                        this->_settings->pushTag("target", i);
+                        this->_layout.addTarget(this->_settings->getValue("x", 0.5f), this->_settings->getValue("y", 0.5f));
+                        this->_settings->popTag();
+                    }
+                }
+            }
+            this->_settings->popTag();
+        }
     }
     this->_settings->popTag();
 }
@@ -395,6 +1413,113 @@ void CalibrationPattern::writeDefaultSettings() {
         {
             this->_settings->addValue("ip",   "192.168.1.1");
             this->_settings->addValue("port", 12345);
+            this->_settings->addValue("ack", 0);
+        }
+        this->_settings->popTag();
+
+        this->_settings->addTag("log");
+        this->_settings->pushTag("log");
+        {
+            this->_settings->addValue("capacity", 65536);
+            this->_settings->addValue("trace", 0);
+            this->_settings->addValue("trace_capacity", 262144);
+        }
+        this->_settings->popTag();
+
+        this->_settings->addTag("metrics");
+        this->_settings->pushTag("metrics");
+        {
+            this->_settings->addValue("enabled", 0);
+            this->_settings->addValue("port", 9101);
+        }
+        this->_settings->popTag();
+
+        this->_settings->addTag("sound");
+        this->_settings->pushTag("sound");
+        {
+            this->_settings->addValue("async_load", 0);
+            this->_settings->addValue("engine", 0);
+            this->_settings->addValue("output", "device");
+            this->_settings->addValue("rate", 48000);
+            this->_settings->addValue("buffer", 128);
+            this->_settings->addValue("latency", 0.01f);
+            this->_settings->addValue("file", "audio_out.wav");
+        }
+        this->_settings->popTag();
+
+        this->_settings->addTag("onset");
+        this->_settings->pushTag("onset");
+        {
+            this->_settings->addValue("measure", 0);
+        }
+        this->_settings->popTag();
+
+        this->_settings->addTag("sync");
+        this->_settings->pushTag("sync");
+        {
+            this->_settings->addValue("enabled", 0);
+            this->_settings->addValue("local", 0);
+            this->_settings->addValue("port", 12346);
+            this->_settings->addValue("interval", 1.0f);
+        }
+        this->_settings->popTag();
+
+        this->_settings->addTag("eog");
+        this->_settings->pushTag("eog");
+        {
+            this->_settings->addValue("enabled", 0);
+            this->_settings->addValue("port", 12347);
+            this->_settings->addValue("synthetic", 0);
+            this->_settings->addValue("rate", 500.0f);
+            this->_settings->addValue("settle", 0.3f);
+            this->_settings->addValue("degree", 1);
+            this->_settings->addValue("drift_memory", 10.0f);
+        }
+        this->_settings->popTag();
+
+        this->_settings->addTag("adaptive");
+        this->_settings->pushTag("adaptive");
+        {
+            this->_settings->addValue("enabled", 0);
+            this->_settings->addValue("source", "eog");
+            this->_settings->addValue("port", 9000);
+            this->_settings->addValue("address", "/gaze");
+            this->_settings->addValue("fixation", 0.4f);
+            this->_settings->addValue("dispersion", 40.0f);
+            this->_settings->addValue("gaze_dispersion", 0.05f);
+            this->_settings->addValue("radius", 0.1f);
+        }
+        this->_settings->popTag();
+
+        this->_settings->addTag("frames");
+        this->_settings->pushTag("frames");
+        {
+            this->_settings->addValue("refresh", 0.0f);
+        }
+        this->_settings->popTag();
+
+        this->_settings->addTag("distractors");
+        this->_settings->pushTag("distractors");
+        {
+            this->_settings->addValue("count", 0);
+            this->_settings->addValue("moving", 0);
+            this->_settings->addValue("radius", 10.0f);
+            this->_settings->addValue("speed", 100.0f);
+            this->_settings->addValue("red", 128);
+            this->_settings->addValue("green", 128);
+            this->_settings->addValue("blue", 128);
+        }
+        this->_settings->popTag();
+
+        // default, grid (columns x rows), polar (rings x spokes around the center) or custom (target x/y)
+        this->_settings->addTag("layout");
+        this->_settings->pushTag("layout");
+        {
+            this->_settings->addValue("type", "default");
+            this->_settings->addValue("columns", 3);
+            this->_settings->addValue("rows", 3);
+            this->_settings->addValue("rings", 2);
+            this->_settings->addValue("spokes", 8);
         }
         this->_settings->popTag();
     }
@@ -403,28 +1528,29 @@ void CalibrationPattern::writeDefaultSettings() {
 }
 
 void CalibrationPattern::loadPatternSettings() {
-    this->_pattern_settings->pushTag("order");
-    {
-        this->_use_commands = this->_pattern_settings->getValue("verbal_commands", 0);
-        this->_reference_target = this->_pattern_settings->getValue("reference", -1);
-        this->_number_of_targets = this->_pattern_settings->getValue("size", 0);
-        string filename;
-        for (int i = 0; i < this->_number_of_targets; i++) {
-            this->_pattern_settings->pushTag("item", i);
-            {
-                this->_target_order.push_back(this->_pattern_settings->getValue("n",  0));
-                filename = this->_pattern_settings->getValue("command",  "");
-                ofSoundPlayer *command = NULL;
-                if (filename != "") {
-                    command = new ofSoundPlayer();
-                    command->load(filename);
-                }
-                this->_target_command.push_back(command);
-            }
-            this->_pattern_settings->popTag();
+    ScheduleSettings settings;
+    settings.time_per_target = this->_time_per_target;
+    settings.pause_duration = this->_pause_duration;
+    settings.use_beeps = this->_use_beeps;
+    settings.use_remote_sound = this->_use_remote_sound;
+    // compiles the xml only if the cached timeline is outdated
+    this->_schedule->load(this->_pattern_settings_filename, settings);
+    this->_number_of_targets = this->_schedule->getNumberOfItems();
+    this->_reference_target = this->_schedule->getReference();
+    for (size_t i = 0; i < this->_schedule->size(); i++) {
+        if (((this->_schedule->flags[i] & STEP_PURSUIT) == 0) && (this->_schedule->target[i] >= (int)this->_layout.size())) {
+            ofLogWarning("CalibrationPattern") << "pattern shows target " << this->_schedule->target[i] << " but the layout has only " << this->_layout.size() << " targets";
+            break;
         }
     }
-    this->_pattern_settings->popTag();
+
+    // items repeating a command share one decoded sound
+    const vector<string> &sound_files = this->_schedule->getSoundFiles();
+    this->_command_sounds.clear();
+    for (size_t i = 0; i < sound_files.size(); i++) {
+        this->_command_sounds.push_back(this->_sounds->get(sound_files[i]));
+    }
+    ofLogNotice("CalibrationPattern") << this->_number_of_targets << " items use " << this->_sounds->size() << " sound files";
 }
 
 void CalibrationPattern::writeDefaultPatternSettings() {
@@ -448,51 +1574,12 @@ void CalibrationPattern::writeDefaultPatternSettings() {
     this->_pattern_settings->saveFile(this->_pattern_settings_filename);
 }
 
-void CalibrationPattern::updatePatternPositions(int index) {
-    if ((index > -1) && (index < this->_number_of_targets)) {
-        this->_calibration_target->setPosition((this->_target_correction[this->_target_order[index]] * this->_marker_radius) + this->_target_positions[this->_target_order[index]] + this->_marker_radius/2);
+void CalibrationPattern::updatePatternPositions(int target) {
+    if ((target > -1) && (target < (int)this->_layout.size())) {
+        this->_calibration_target->setPosition(this->_layout.getPosition(target));
     }
 }
 
 void CalibrationPattern::getPatternPositions(float pattern_width, float pattern_height) {
-    float w = pattern_width;
-    float h = pattern_height;
-    // clear in case we call this not for the first time
-    this->_target_positions.clear();
-    this->_target_correction.clear();
-    /*
-     * 1    2    3
-     *    9   10
-     * 8    0    4
-     *   12   11
-     * 7    6    5
-     */
-    this->_target_positions.push_back(ofVec2f(w/2,   h/2  )); // center center
-    this->_target_positions.push_back(ofVec2f(0,     0    )); // top    left   corner
-    this->_target_positions.push_back(ofVec2f(w/2,   0    )); // top    center
-    this->_target_positions.push_back(ofVec2f(w,     0    )); // top    right  corner
-    this->_target_positions.push_back(ofVec2f(w,     h/2  )); // right  center
-    this->_target_positions.push_back(ofVec2f(w,     h    )); // bottom right  corner
-    this->_target_positions.push_back(ofVec2f(w/2,   h    )); // bottom center
-    this->_target_positions.push_back(ofVec2f(0,     h    )); // bottem left   corner
-    this->_target_positions.push_back(ofVec2f(0,     h/2  )); // left   center
-    this->_target_positions.push_back(ofVec2f(w/4,   h/4  ));
-    this->_target_positions.push_back(ofVec2f(w*3/4, h/4  ));
-    this->_target_positions.push_back(ofVec2f(w*3/4, h*3/4));
-    this->_target_positions.push_back(ofVec2f(w/4,   h*3/4));
-
-    // correction factor to put the pattern centered is dependent on the target size
-    this->_target_correction.push_back(ofVec2f(-1, -1));
-    this->_target_correction.push_back(ofVec2f( 1,  1));
-    this->_target_correction.push_back(ofVec2f(-1,  1));
-    this->_target_correction.push_back(ofVec2f(-2,  1));
-    this->_target_correction.push_back(ofVec2f(-2, -1));
-    this->_target_correction.push_back(ofVec2f(-2, -2));
-    this->_target_correction.push_back(ofVec2f(-1, -2));
-    this->_target_correction.push_back(ofVec2f( 1, -2));
-    this->_target_correction.push_back(ofVec2f( 1, -1));
-    this->_target_correction.push_back(ofVec2f(-0.5f, -0.5f));
-    this->_target_correction.push_back(ofVec2f(-1.5f, -0.5f));
-    this->_target_correction.push_back(ofVec2f(-1.5f, -1.5f));
-    this->_target_correction.push_back(ofVec2f(-0.5f, -1.5f));
+    this->_layout.resize(pattern_width, pattern_height, this->_marker_radius);
 }
@@ -14,24 +14,77 @@
 #include "ofx_udp_trigger.h"
 #include "ofxNetwork.h"
 #include "ofxOsc.h"
-
-enum CalibrationStates {
-    OFF,
-    TARGET,
-    PAUSE2REFERENCE,
-    REFERENCE,
-    PAUSE2TARGET
-};
+#include "calibrationScheduler.h"
+#include "outboundEvents.h"
+#include "sessionLog.h"
+#include "onsetProbe.h"
+#include "soundCache.h"
+#include "patternSchedule.h"
+#include "calibrationClock.h"
+#include "eventSinks.h"
+#include "targetLayout.h"
+#include "clockSync.h"
+#include "eogInput.h"
+#include "eogCalibration.h"
+#include "sessionTimeline.h"
+#include "fixationDetector.h"
+#include "startupTasks.h"
+#include "markerRenderer.h"
+#include "frameTimer.h"
+#include "audioEngine.h"
+#include "sessionTrace.h"
+#include "metrics.h"
 
 class CalibrationPattern {
 public:
     CalibrationPattern();
+    // headless: no window or sockets, transitions run in runHeadless()
+    // or, in realtime on a steady clock, on the scheduler and I/O threads;
+    // replays leave out the EOG and fixation detection, replayFixation() ends the steps
+    CalibrationPattern(CalibrationClock *clock, EventSinks *sinks, string pattern_filename = "", bool realtime = false, bool replay = false);
+    // stops the scheduler and I/O threads, delete it before the clock and sinks it was given
+    ~CalibrationPattern();
+    // with until >= 0, only the transitions planned up to then
+    void runHeadless(double until = -1);
+    // end of session statistics, logged here instead of on the scheduler thread;
+    // update() calls it, headless runs after runHeadless(); fits the EOG of headless runs
+    void reportSession();
+    PatternSchedule* getSchedule();
+    SessionTimeline* getTimeline();
+    double getSessionStart();
     void resizePattern(float window_width, float window_height);
     void draw();
+    // operator overlay with the frame timing, not part of the stimulus
+    void drawHud(float x, float y);
+    // operator view: state, current and next target and the connections, at x/y
+    void drawStatus(float x, float y);
+    // NULL until the marker is set up and in headless runs
+    FrameTimer* getFrameTimer();
     void update();
     bool isRunning();
+    // every required startup task is done, sessions and eye tracker commands wait for it
+    bool isReady();
     void startCalibration();
     void stopCalibration();
+    // batch runs: switch to another participant between sessions, a codeword or a pattern file;
+    // sounds, sockets and the window stay, only the pattern is loaded
+    bool loadParticipant(string participant);
+    string getCodeword();
+    // commands and beeps go to the engine as cues from now on, set before the first session;
+    // the window sets up its own with <sound><engine>
+    void attachAudio(AudioEngine *audio);
+    // the commands and beeps of every pause are played here whatever the settings say (the audio check),
+    // recompiles the schedule; before attachAudio()
+    void useLocalSound();
+    // sessions record their inputs and outputs into the trace, set between sessions;
+    // the window sets up its own with <log><trace> and saves it next to the session log
+    void setTrace(SessionTrace *trace);
+    void traceKey(int key);
+    // a fixation recorded in a trace ends the step as it did then, false if the step is over
+    bool replayFixation(int step, double time);
+    // counters and histograms of the sends and transitions, set before the first session;
+    // the window sets up its own with <metrics><enabled>, frame times included
+    void setMetrics(Metrics *metrics);
 
     void setupProjectEyeTracker();
     void setupSubjectEyeTracker();
@@ -44,29 +97,74 @@ public:
     void sendEyeTrackerEvent(string message);
 
 private:
-    CalibrationStates _state;
+    std::atomic<CalibrationStates> _state;
     const string _settings_filename = "calibrationSettings.xml";
     string _pattern_settings_filename;
     ofxXmlSettings *_pattern_settings, *_settings;
-    int _number_of_targets, _reference_target, _current_target;
-    float _marker_radius, _current_target_start_time, _time_per_target, _pause_start_time, _pause_duration;
+    int _number_of_targets, _reference_target, _current_target, _shown_target;
+    float _marker_radius, _time_per_target, _pause_duration;
     ofColor _marker_color, _marker_background_color;
-    vector<ofVec2f> _target_positions;
-    vector<ofVec2f> _target_correction;
-    vector<int> _target_order;
-    vector<ofSoundPlayer*> _target_command;
+    TargetLayout _layout;
+    vector<ofSoundPlayer*> _command_sounds;
+    SoundCache *_sounds;
+    bool _load_sounds_async;
     Blinky *_calibration_target;
-    bool _use_beep, _use_beeps, _use_commands, _use_reference, _is_recording;
+    bool _use_beep, _use_beeps;
+    std::atomic<bool> _is_recording;
+    std::atomic<bool> _report_pending;
+
+    // optional distractors around the marker, drawn in one instanced call
+    int _distractor_count, _distractor_moving;
+    float _distractor_radius, _distractor_speed;
+    ofColor _distractor_color;
+    MarkerRenderer *_distractors;
+    vector<ofVec2f> _distractor_velocity;
+    double _distractor_time;
+    void placeDistractors(float window_width, float window_height);
+    void moveDistractors();
+
+    // the pattern compiled into a timeline, a session advances a cursor through it
+    PatternSchedule *_schedule;
+    size_t _cursor;
+    double _session_start;
+    // when the steps actually started; the adaptive mode moves them earlier by the time saved so far
+    SessionTimeline _timeline;
+    double _time_saved;
+    double plannedOnset(size_t step);
+
+    // transitions run on the scheduler thread, the render thread only follows the marker
+    CalibrationClock *_clock;
+    CalibrationScheduler *_scheduler;
+    bool _headless;
+    double _next_transition_time;
+    std::atomic<int> _marker_state, _marker_order_position, _marker_segment;
+    std::atomic<double> _marker_planned_time;
+    std::atomic<unsigned int> _marker_generation;
+    // last step applied by the scheduler, for the operator view
+    std::atomic<int> _applied_step;
+    std::atomic<double> _step_deadline;
+    string describeClock(string peer, ClockSync *sync);
+    unsigned int _shown_generation;
+    int _shown_segment;
+    double _segment_start;
 
     void getPatternPositions(float pattern_width, float pattern_height);
-    void updatePatternPositions(int index);
+    void updatePatternPositions(int target);
+    // startup: settings, then pattern and sounds, sockets and the marker in parallel
+    StartupTasks *_startup;
+    void initialize();
+    void loadPattern();
+    void setupNetwork();
+    void setupMarker();
     void loadSettings();
     void writeDefaultSettings();
     void loadPatternSettings();
     void writeDefaultPatternSettings();
-    void nextTarget();
-    void backToReference();
-    void pause();
+    double transition(double planned_time);
+    void applyStep(size_t step, double planned_time);
+    void finishCalibration(double planned_time);
+    void publishMarker(int target, int segment, int order_position, bool blinky_on, double planned_time);
+    OutboundEvent makeEvent(OutboundEventType type, double planned_time);
 
     UdpTrigger *_trigger;
     string _host_address;
@@ -75,9 +173,93 @@ private:
     ofxUDPManager _udp;
     string _remote_ip;
     int _remote_port;
+    bool _remote_acks;
+    RemoteSoundChannel *_remote;
 
     ofxOscSender *_osc;
+    ofxOscMessage _control_message;
+    ofxUDPManager _osc_events;
     string _osc_ip, _codeword;
+
+    EventSinks *_sinks;
+    OutboundEventSender *_sender;
+
+    // clock offset and drift of the trigger host and the eye tracker
+    bool _sync_clocks, _sync_local;
+    int _sync_port;
+    float _sync_interval;
+    ClockSync *_trigger_clock, *_eye_tracker_clock;
+    void startClockSync(NetworkSinks *sinks);
+    void logClockEstimate(string peer, ClockSync *sync);
+
+    SessionLog *_log;
+    int _log_capacity;
+    // set by the report, the render thread closes the log once it logged the last frames
+    bool _log_close_pending;
+    void openSessionLog();
+    void closeSessionLog();
+
+    bool _record_trace;
+    int _trace_capacity;
+    SessionTrace *_trace;
+    string _trace_filename;
+
+    // served to the operator machine on a udp port
+    bool _use_metrics;
+    int _metrics_port;
+    Metrics *_metrics;
+    MetricsEndpoint *_metrics_endpoint;
+
+    bool _measure_onsets;
+    OnsetProbe *_onset_probe;
+
+    // audio engine: commands and beeps are queued a step ahead and start on their sample
+    bool _use_audio_engine;
+    string _audio_output, _audio_file;
+    int _audio_rate, _audio_buffer;
+    float _audio_latency;
+    AudioEngine *_audio;
+    vector<int> _command_clips;
+    int _beep_clip;
+    int _cued_step;
+    void setupAudio();
+    void registerAudioClips();
+    void scheduleCues(size_t step, double planned_time);
+    void cueStep(size_t step, double time);
+
+    // frame timing of the render thread, summed up per marker
+    float _refresh_rate;
+    FrameTimer *_frame_timer;
+    int _frame_epochs, _bad_frame_epochs;
+    void logFrameEpoch(const FrameEpoch &epoch);
+    void reportFrames();
+
+    // optional EOG input, fitted against the targets at the end of every session
+    bool _use_eog, _eog_synthetic;
+    int _eog_port, _eog_degree;
+    float _eog_rate, _eog_settle, _eog_drift_memory;
+    EogDriftTracker *_eog_drift;
+    EogRing *_eog_ring;
+    EogInput *_eog_input;
+    SyntheticEog *_synthetic_eog;
+    EogCalibration *_eog;
+    std::atomic<bool> _eog_fit_pending;
+    double _eog_fit_time;
+    void setupEog(NetworkSinks *sinks);
+    void startEog();
+    void fitEog();
+
+    // adaptive mode: a stable fixation ends a target before its time is up
+    bool _adaptive, _adaptive_gaze;
+    int _gaze_port;
+    string _gaze_address;
+    float _fixation_duration, _fixation_dispersion, _fixation_radius;
+    FixationDetector *_fixation_detector;
+    OscGazeInput *_gaze_input;
+    int _armed_fixations, _early_fixations, _last_fixation_target;
+    void setupAdaptive();
+    void armFixation(size_t step, double planned_time);
+    void fixationDetected(double deadline, double time);
 };
 
 #endif /* calibrationPattern_h */
@@ -0,0 +1,125 @@
+//
+//  calibrationScheduler.cpp
+//  phd_calibration_eog
+//
+
+#include "calibrationScheduler.h"
+
+CalibrationScheduler::CalibrationScheduler(SteadyClock *clock) {
+    this->_clock = clock;
+    this->_next_transition_time = -1;
+    this->_stop_requested = false;
+    this->_metrics = NULL;
+    resetStats();
+}
+
+CalibrationScheduler::~CalibrationScheduler() {
+    stop();
+}
+
+double CalibrationScheduler::now() {
+    return this->_clock->now();
+}
+
+void CalibrationScheduler::start(std::function<double(double)> transition, double first_transition_time) {
+    stop();
+    this->_transition = transition;
+    this->_next_transition_time = first_transition_time;
+    this->_stop_requested = false;
+    startThread();
+}
+
+void CalibrationScheduler::stop() {
+    // must not be called from within a transition, the scheduler thread cannot join itself
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->_stop_requested = true;
+    }
+    this->_wakeup.notify_all();
+    waitForThread(true);
+}
+
+double CalibrationScheduler::advance(double deadline, double time) {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        // once its deadline passed the transition is due (or running), it cannot be moved anymore
+        if ((this->_next_transition_time != deadline) || (time >= deadline) || (now() >= deadline)) {
+            return -1;
+        }
+        time = std::max(time, now());
+        this->_next_transition_time = time;
+    }
+    this->_wakeup.notify_all();
+    return time;
+}
+
+void CalibrationScheduler::resetStats() {
+    this->_transition_count = 0;
+    this->_lateness_sum = 0;
+    this->_lateness_max = 0;
+}
+
+uint64_t CalibrationScheduler::getTransitionCount() {
+    return this->_transition_count;
+}
+
+double CalibrationScheduler::getMeanLateness() {
+    uint64_t count = this->_transition_count;
+    if (count == 0) {
+        return 0;
+    }
+    return (this->_lateness_sum / (double)count) * 1e-6;
+}
+
+void CalibrationScheduler::setMetrics(Metrics *metrics) {
+    this->_metrics = metrics;
+}
+
+double CalibrationScheduler::getMaxLateness() {
+    return this->_lateness_max * 1e-6;
+}
+
+void CalibrationScheduler::sleepUntil() {
+    // block until shortly before the deadline (or a stop request, or an earlier deadline) ...
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        double time = this->_next_transition_time;
+        this->_wakeup.wait_until(lock, this->_clock->toTimePoint(time - this->_spin_duration), [this, time]{
+            return (this->_stop_requested == true) || (this->_next_transition_time < time);
+        });
+    }
+    // ... and yield the remaining time away to hit the deadline below a millisecond
+    while ((this->_stop_requested == false) && (now() < this->_next_transition_time)) {
+        std::this_thread::yield();
+    }
+}
+
+void CalibrationScheduler::threadedFunction() {
+    while (isThreadRunning() && (this->_next_transition_time >= 0)) {
+        sleepUntil();
+        if (this->_stop_requested == true) {
+            break;
+        }
+        double planned_time;
+        {
+            // taken under the lock and marked as running, so advance() cannot move it anymore
+            std::lock_guard<std::mutex> lock(this->mutex);
+            planned_time = this->_next_transition_time;
+            this->_next_transition_time = -1;
+        }
+        double drift = now() - planned_time;
+        if (this->_metrics != NULL) {
+            this->_metrics->add(METRIC_TRANSITIONS);
+            this->_metrics->observe(METRIC_TRANSITION_DRIFT, drift);
+        }
+        uint64_t lateness = (uint64_t)(std::max(0.0, drift) * 1e6);
+        this->_transition_count++;
+        this->_lateness_sum += lateness;
+        if (lateness > this->_lateness_max) {
+            this->_lateness_max = lateness;
+        }
+        double next_transition_time = this->_transition(planned_time);
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->_next_transition_time = next_transition_time;
+    }
+}
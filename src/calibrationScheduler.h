@@ -0,0 +1,56 @@
+//
+//  calibrationScheduler.h
+//  phd_calibration_eog
+//
+
+#ifndef calibrationScheduler_h
+#define calibrationScheduler_h
+
+#include "ofMain.h"
+#include "calibrationClock.h"
+#include "metrics.h"
+
+/*
+ * Runs the transitions of the calibration pattern on its own thread. Times
+ * are seconds on the given steady clock. The transition callback receives the
+ * time it was planned for and returns the planned time of the next transition
+ * (or a negative value to stop), so lateness never accumulates over a session.
+ */
+class CalibrationScheduler : public ofThread {
+public:
+    CalibrationScheduler(SteadyClock *clock);
+    ~CalibrationScheduler();
+    double now();
+    void start(std::function<double(double)> transition, double first_transition_time);
+    void stop();
+    // move the pending transition planned for deadline earlier, to time or now if that passed;
+    // returns when it will run, -1 if it is due, running or already ran
+    double advance(double deadline, double time);
+    // the drift of every transition from its plan goes into these, set before start()
+    void setMetrics(Metrics *metrics);
+
+    // the statistics start over, while no session runs
+    void resetStats();
+    uint64_t getTransitionCount();
+    double getMeanLateness();
+    double getMaxLateness();
+
+private:
+    void threadedFunction();
+    void sleepUntil();
+
+    SteadyClock *_clock;
+    std::function<double(double)> _transition;
+    std::atomic<double> _next_transition_time;
+    std::condition_variable _wakeup;
+    std::atomic<bool> _stop_requested;
+    Metrics *_metrics;
+
+    // lateness of each transition relative to its plan, in microseconds
+    std::atomic<uint64_t> _transition_count, _lateness_sum, _lateness_max;
+
+    // sleep coarsely until this long before a transition, then spin
+    const double _spin_duration = 0.002;
+};
+
+#endif /* calibrationScheduler_h */
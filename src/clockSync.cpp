@@ -0,0 +1,157 @@
+//
+//  clockSync.cpp
+//  phd_calibration_eog
+//
+
+#include "clockSync.h"
+
+const int ClockSync::_history;
+
+ClockSync::ClockSync(CalibrationClock *clock, string host, int port, double interval) {
+    this->_clock = clock;
+    this->_host = host;
+    this->_port = port;
+    this->_interval = interval;
+    this->_stop_requested = false;
+    this->_sample_count = 0;
+    this->_sample_next = 0;
+    this->_estimate.valid = false;
+    this->_estimate.reference_time = 0;
+    this->_estimate.offset = 0;
+    this->_estimate.drift = 0;
+    this->_estimate.uncertainty = -1;
+    this->_estimate.delay = -1;
+    this->_estimate.samples = 0;
+    this->_generation = 0;
+
+    this->_udp.Create();
+    this->_udp.Connect(host.c_str(), port);
+    // a lost response costs at most a second
+    this->_udp.SetTimeoutReceive(1);
+}
+
+ClockSync::~ClockSync() {
+    stop();
+}
+
+void ClockSync::start() {
+    this->_stop_requested = false;
+    startThread();
+}
+
+void ClockSync::stop() {
+    this->_stop_requested = true;
+    waitForThread(true);
+}
+
+string ClockSync::getHost() {
+    return this->_host;
+}
+
+ClockEstimate ClockSync::getEstimate() {
+    std::lock_guard<std::mutex> lock(this->_estimate_mutex);
+    return this->_estimate;
+}
+
+uint32_t ClockSync::getGeneration() {
+    return this->_generation.load(std::memory_order_acquire);
+}
+
+double ClockSync::toPeerTime(double local_time) {
+    std::lock_guard<std::mutex> lock(this->_estimate_mutex);
+    double unix_time = local_time + this->_clock->getEpochUnixTime();
+    if (this->_estimate.valid == false) {
+        return unix_time;
+    }
+    return unix_time + this->_estimate.offset + this->_estimate.drift * (local_time - this->_estimate.reference_time);
+}
+
+void ClockSync::threadedFunction() {
+    uint32_t sequence = 0;
+    while (this->_stop_requested == false) {
+        // keep the exchange with the shortest round trip, it is the least skewed by queueing
+        double best_time = 0, best_offset = 0, best_delay = -1;
+        for (int i = 0; (i < _burst) && (this->_stop_requested == false); i++) {
+            double time, offset, delay;
+            if ((exchange(sequence++, time, offset, delay) == true) && ((best_delay < 0) || (delay < best_delay))) {
+                best_time = time;
+                best_offset = offset;
+                best_delay = delay;
+            }
+            sleep(10);
+        }
+        if (best_delay >= 0) {
+            this->_sample_time[this->_sample_next] = best_time;
+            this->_sample_offset[this->_sample_next] = best_offset;
+            this->_sample_delay[this->_sample_next] = best_delay;
+            this->_sample_next = (this->_sample_next + 1) % _history;
+            this->_sample_count = std::min(this->_sample_count + 1, _history);
+            fit();
+        }
+        double next_burst = this->_clock->now() + this->_interval;
+        while ((this->_stop_requested == false) && (this->_clock->now() < next_burst)) {
+            sleep(20);
+        }
+    }
+}
+
+bool ClockSync::exchange(uint32_t sequence, double &local_time, double &offset, double &delay) {
+    double epoch = this->_clock->getEpochUnixTime();
+    ClockSyncMessage message;
+    memset(&message, 0, sizeof(message));
+    memcpy(message.magic, "EOGC", 4);
+    message.version = 1;
+    message.sequence = sequence;
+    message.request_sent = this->_clock->now() + epoch;
+    if (this->_udp.Send((const char*)&message, sizeof(message)) != sizeof(message)) {
+        return false;
+    }
+    ClockSyncMessage response;
+    while (this->_udp.Receive((char*)&response, sizeof(response)) == sizeof(response)) {
+        double response_received = this->_clock->now() + epoch;
+        // skip late responses to earlier requests
+        if ((memcmp(response.magic, "EOGC", 4) != 0) || ((response.flags & CLOCK_SYNC_RESPONSE) == 0) || (response.sequence != sequence)) {
+            continue;
+        }
+        offset = ((response.request_received - message.request_sent) + (response.response_sent - response_received)) / 2;
+        delay = (response_received - message.request_sent) - (response.response_sent - response.request_received);
+        local_time = (message.request_sent + response_received) / 2 - epoch;
+        return true;
+    }
+    return false;
+}
+
+void ClockSync::fit() {
+    // least squares line through the kept offsets over local time
+    int n = this->_sample_count;
+    double mean_time = 0, mean_offset = 0, min_delay = -1, latest_time = 0;
+    for (int i = 0; i < n; i++) {
+        mean_time += this->_sample_time[i] / n;
+        mean_offset += this->_sample_offset[i] / n;
+        if ((min_delay < 0) || (this->_sample_delay[i] < min_delay)) {
+            min_delay = this->_sample_delay[i];
+        }
+        latest_time = std::max(latest_time, this->_sample_time[i]);
+    }
+    double covariance = 0, variance = 0;
+    for (int i = 0; i < n; i++) {
+        covariance += (this->_sample_time[i] - mean_time) * (this->_sample_offset[i] - mean_offset);
+        variance += (this->_sample_time[i] - mean_time) * (this->_sample_time[i] - mean_time);
+    }
+    double drift = (variance > 0) ? covariance / variance : 0;
+    double residuals = 0;
+    for (int i = 0; i < n; i++) {
+        double error = this->_sample_offset[i] - (mean_offset + drift * (this->_sample_time[i] - mean_time));
+        residuals += error * error / n;
+    }
+
+    std::lock_guard<std::mutex> lock(this->_estimate_mutex);
+    this->_estimate.valid = true;
+    this->_estimate.reference_time = latest_time;
+    this->_estimate.offset = mean_offset + drift * (latest_time - mean_time);
+    this->_estimate.drift = drift;
+    this->_estimate.uncertainty = min_delay / 2 + sqrt(residuals);
+    this->_estimate.delay = this->_sample_delay[(this->_sample_next + _history - 1) % _history];
+    this->_estimate.samples = n;
+    this->_generation.fetch_add(1, std::memory_order_release);
+}
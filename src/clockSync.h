@@ -0,0 +1,84 @@
+//
+//  clockSync.h
+//  phd_calibration_eog
+//
+
+#ifndef clockSync_h
+#define clockSync_h
+
+#include "ofMain.h"
+#include "ofxNetwork.h"
+#include "calibrationClock.h"
+
+enum ClockSyncFlags : uint8_t {
+    CLOCK_SYNC_RESPONSE = 1 << 0
+};
+
+// one datagram each way, little endian; bin/data/clock_sync_responder.py answers them
+struct ClockSyncMessage {
+    char magic[4];          // "EOGC"
+    uint8_t version;        // 1
+    uint8_t flags;          // ClockSyncFlags
+    uint16_t reserved;
+    uint32_t sequence;
+    uint32_t reserved2;
+    double request_sent;    // unix time on this machine
+    double request_received; // unix time on the peer, filled in by the response
+    double response_sent;   // unix time on the peer, filled in by the response
+};
+static_assert(sizeof(ClockSyncMessage) == 40, "clock sync messages are 40 bytes");
+
+struct ClockEstimate {
+    bool valid;
+    double reference_time;  // local clock time the offset belongs to
+    double offset;          // peer unix time minus local unix time at reference_time, in seconds
+    double drift;           // change of the offset per second
+    double uncertainty;     // half the best round trip plus the spread of the fit, in seconds
+    double delay;           // best round trip of the last burst, in seconds
+    uint32_t samples;       // bursts the fit is based on
+};
+
+/*
+ * Estimates offset and drift of a peer's clock in the background with
+ * NTP-style exchanges. Every interval a short burst of requests is sent and
+ * only the one with the shortest round trip is kept; offset and drift are a
+ * line fitted through the last kept samples.
+ */
+class ClockSync : public ofThread {
+public:
+    ClockSync(CalibrationClock *clock, string host, int port, double interval);
+    ~ClockSync();
+    void start();
+    void stop();
+    string getHost();
+
+    ClockEstimate getEstimate();
+    // changes whenever a new estimate is published
+    uint32_t getGeneration();
+    // unix time on the peer of a time on the local clock
+    double toPeerTime(double local_time);
+
+private:
+    void threadedFunction();
+    bool exchange(uint32_t sequence, double &local_time, double &offset, double &delay);
+    void fit();
+
+    CalibrationClock *_clock;
+    string _host;
+    int _port;
+    double _interval;
+    ofxUDPManager _udp;
+    std::atomic<bool> _stop_requested;
+
+    // kept samples: local clock time, offset, round trip
+    static const int _history = 16;
+    static const int _burst = 8;
+    double _sample_time[_history], _sample_offset[_history], _sample_delay[_history];
+    int _sample_count, _sample_next;
+
+    std::mutex _estimate_mutex;
+    ClockEstimate _estimate;
+    std::atomic<uint32_t> _generation;
+};
+
+#endif /* clockSync_h */
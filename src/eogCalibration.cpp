@@ -0,0 +1,343 @@
+//
+//  eogCalibration.cpp
+//  phd_calibration_eog
+//
+
+#include "eogCalibration.h"
+
+// running statistics of two groups combined (Chan et al.)
+static void merge(double &count, double &mean, double &m2, double other_count, double other_mean, double other_m2) {
+    double total = count + other_count;
+    if (total == 0) {
+        return;
+    }
+    double delta = other_mean - mean;
+    mean += delta * other_count / total;
+    m2 += other_m2 + delta * delta * count * other_count / total;
+    count = total;
+}
+
+EogCalibration::EogCalibration(PatternSchedule *schedule, SessionTimeline *timeline, TargetLayout *layout, EogRing *ring, EogDriftTracker *drift, double settle, int degree) {
+    this->_schedule = schedule;
+    this->_timeline = timeline;
+    this->_layout = layout;
+    this->_ring = ring;
+    this->_drift = drift;
+    this->_open_reference = -1;
+    this->_settle = settle;
+    this->_degree = std::max(1, std::min(3, degree));
+    this->_session_start = 0;
+    this->_last_time = 0;
+    this->_step = 0;
+    this->_samples = 0;
+    this->_outside = 0;
+    this->_fit_h.valid = false;
+    this->_fit_v.valid = false;
+}
+
+void EogCalibration::startSession(double session_start) {
+    // whatever is still in the ring belongs to the previous session
+    EogSample sample;
+    while (this->_ring->pop(sample) == true) {
+    }
+    this->_session_start = session_start;
+    this->_last_time = session_start;
+    this->_drift->startSession(session_start);
+    this->_open_reference = -1;
+    this->_step = 0;
+    this->_samples = 0;
+    this->_outside = 0;
+    size_t steps = this->_schedule->size();
+    this->_count.assign(steps, 0);
+    this->_mean_h.assign(steps, 0);
+    this->_mean_v.assign(steps, 0);
+    this->_m2_h.assign(steps, 0);
+    this->_m2_v.assign(steps, 0);
+    this->_fit_h.valid = false;
+    this->_fit_v.valid = false;
+}
+
+size_t EogCalibration::findStep(double time) {
+    const SessionTimeline &timeline = *this->_timeline;
+    size_t steps = timeline.size();
+    if ((steps == 0) || (time < timeline.getOnset(0))) {
+        return steps;
+    }
+    // samples arrive in order, so the step is almost always the current or the next one
+    if (timeline.getOnset(this->_step) > time) {
+        this->_step = 0;
+    }
+    while ((this->_step + 1 < steps) && (timeline.getOnset(this->_step + 1) <= time)) {
+        this->_step++;
+    }
+    return this->_step;
+}
+
+void EogCalibration::drain() {
+    PatternSchedule &schedule = *this->_schedule;
+    const SessionTimeline &timeline = *this->_timeline;
+    size_t steps = std::min(schedule.size(), timeline.size());
+    EogSample sample;
+    while (true) {
+        size_t n = 0;
+        while ((n < _block_size) && (this->_ring->pop(sample) == true)) {
+            this->_block_time[n] = sample.time;
+            this->_last_time = std::max(this->_last_time, sample.time);
+            this->_block_h[n] = sample.horizontal;
+            this->_block_v[n] = sample.vertical;
+            n++;
+        }
+        if (n == 0) {
+            return;
+        }
+        this->_samples += n;
+
+        // split the block into runs of samples that fall into the same step
+        size_t first = 0;
+        while (first < n) {
+            size_t step = findStep(this->_block_time[first]);
+            if ((this->_open_reference > -1) && (step != (size_t)this->_open_reference)) {
+                closeReference();
+            }
+            double begin = -std::numeric_limits<double>::max();
+            double end = std::numeric_limits<double>::max();
+            if (step < steps) {
+                // a step that has not started yet reads as the largest time
+                begin = timeline.getOnset(step);
+                end = timeline.getOnset(step + 1);
+            } else if (steps > 0) {
+                // before the session started
+                end = timeline.getOnset(0);
+            }
+            size_t last = first + 1;
+            while ((last < n) && (this->_block_time[last] >= begin) && (this->_block_time[last] < end)) {
+                last++;
+            }
+            // only fixations of a target count, after the eye had time to get there
+            bool fixation = (step < steps) && ((schedule.flags[step] & STEP_MARKER) != 0) && ((schedule.flags[step] & STEP_PURSUIT) == 0);
+            size_t settled = first;
+            if (fixation == true) {
+                while ((settled < last) && (this->_block_time[settled] < begin + this->_settle)) {
+                    settled++;
+                }
+                accumulate(step, settled, last);
+                if (schedule.state[step] == REFERENCE) {
+                    this->_open_reference = step;
+                }
+            }
+            this->_outside += settled - first + ((fixation == true) ? 0 : last - settled);
+            first = last;
+        }
+    }
+}
+
+void EogCalibration::accumulate(size_t step, size_t first, size_t last) {
+    size_t n = last - first;
+    if (n == 0) {
+        return;
+    }
+    const float *h = this->_block_h + first;
+    const float *v = this->_block_v + first;
+    float sum_h = 0, sum_v = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum_h += h[i];
+    }
+    for (size_t i = 0; i < n; i++) {
+        sum_v += v[i];
+    }
+    float mean_h = sum_h / n;
+    float mean_v = sum_v / n;
+    float m2_h = 0, m2_v = 0;
+    for (size_t i = 0; i < n; i++) {
+        m2_h += (h[i] - mean_h) * (h[i] - mean_h);
+    }
+    for (size_t i = 0; i < n; i++) {
+        m2_v += (v[i] - mean_v) * (v[i] - mean_v);
+    }
+    double count = this->_count[step];
+    merge(this->_count[step], this->_mean_h[step], this->_m2_h[step], n, mean_h, m2_h);
+    merge(count, this->_mean_v[step], this->_m2_v[step], n, mean_v, m2_v);
+}
+
+void EogCalibration::closeReference() {
+    size_t step = this->_open_reference;
+    this->_open_reference = -1;
+    if (this->_count[step] == 0) {
+        return;
+    }
+    // the mean belongs to the middle of the settled part of the fixation
+    double begin = this->_timeline->getOnset(step) + this->_settle;
+    double end = std::min(this->_timeline->getOnset(step + 1), this->_last_time);
+    this->_drift->addEpoch((begin + std::max(begin, end)) / 2, this->_mean_h[step], this->_mean_v[step]);
+}
+
+bool EogCalibration::fit() {
+    drain();
+    if (this->_open_reference > -1) {
+        closeReference();
+    }
+    PatternSchedule &schedule = *this->_schedule;
+    // one point per fixation, weighted by its samples
+    vector<double> eog_h, eog_v, u, v, weight;
+    for (size_t i = 0; i < this->_count.size(); i++) {
+        if (this->_count[i] > 0) {
+            ofVec2f position = this->_layout->getNormalized(schedule.target[i]);
+            eog_h.push_back(this->_mean_h[i]);
+            eog_v.push_back(this->_mean_v[i]);
+            u.push_back(position.x);
+            v.push_back(position.y);
+            weight.push_back(this->_count[i]);
+        }
+    }
+    bool success = fitAxis(eog_h, u, weight, this->_fit_h) && fitAxis(eog_v, v, weight, this->_fit_v);
+    if (success == false) {
+        ofLogWarning("EogCalibration") << this->_samples << " samples in " << weight.size() << " fixations, too few to fit a polynomial of degree " << this->_degree;
+        return false;
+    }
+    report();
+    return true;
+}
+
+bool EogCalibration::fitAxis(const vector<double> &eog, const vector<double> &position, const vector<double> &weight, EogAxisFit &fit) {
+    fit.valid = false;
+    fit.degree = this->_degree;
+    int terms = this->_degree + 1;
+    if ((int)eog.size() < terms + 1) {
+        return false;
+    }
+    // solve the weighted normal equations on eog / scale to keep the powers in range
+    double scale = 0;
+    for (size_t i = 0; i < eog.size(); i++) {
+        scale = std::max(scale, fabs(eog[i]));
+    }
+    if (scale == 0) {
+        return false;
+    }
+    double a[4][5];
+    memset(a, 0, sizeof(a));
+    for (size_t i = 0; i < eog.size(); i++) {
+        double x = eog[i] / scale;
+        double power_row = 1;
+        for (int row = 0; row < terms; row++) {
+            double power = power_row;
+            for (int column = 0; column < terms; column++) {
+                a[row][column] += weight[i] * power;
+                power *= x;
+            }
+            a[row][terms] += weight[i] * power_row * position[i];
+            power_row *= x;
+        }
+    }
+    // gaussian elimination with partial pivoting
+    for (int column = 0; column < terms; column++) {
+        int pivot = column;
+        for (int row = column + 1; row < terms; row++) {
+            if (fabs(a[row][column]) > fabs(a[pivot][column])) {
+                pivot = row;
+            }
+        }
+        if (fabs(a[pivot][column]) < 1e-12) {
+            return false;
+        }
+        for (int k = 0; k <= terms; k++) {
+            std::swap(a[column][k], a[pivot][k]);
+        }
+        for (int row = 0; row < terms; row++) {
+            if (row != column) {
+                double factor = a[row][column] / a[column][column];
+                for (int k = column; k <= terms; k++) {
+                    a[row][k] -= factor * a[column][k];
+                }
+            }
+        }
+    }
+    for (int k = 0; k < 4; k++) {
+        fit.coefficients[k] = (k < terms) ? a[k][terms] / a[k][k] / pow(scale, k) : 0;
+    }
+    fit.valid = true;
+
+    double total_weight = 0, mean = 0;
+    for (size_t i = 0; i < eog.size(); i++) {
+        total_weight += weight[i];
+        mean += weight[i] * position[i];
+    }
+    mean /= total_weight;
+    double residuals = 0, variance = 0;
+    for (size_t i = 0; i < eog.size(); i++) {
+        double error = evaluate(fit, eog[i]) - position[i];
+        residuals += weight[i] * error * error;
+        variance += weight[i] * (position[i] - mean) * (position[i] - mean);
+    }
+    fit.rms_residual = sqrt(residuals / total_weight);
+    fit.r_squared = (variance > 0) ? 1 - residuals / variance : 0;
+    return true;
+}
+
+double EogCalibration::evaluate(const EogAxisFit &fit, double eog) {
+    double position = 0;
+    for (int k = fit.degree; k >= 0; k--) {
+        position = position * eog + fit.coefficients[k];
+    }
+    return position;
+}
+
+void EogCalibration::report() {
+    PatternSchedule &schedule = *this->_schedule;
+    ofLogNotice("EogCalibration") << this->_samples << " samples, " << this->_outside << " outside of settled fixations";
+    EogDriftEstimate drift = this->_drift->getEstimate();
+    if (drift.valid == true) {
+        ofLogNotice("EogCalibration") << "reference baseline " << drift.baseline_h << " / " << drift.baseline_v
+            << ", drift " << drift.drift_h << " / " << drift.drift_v << " uV/s from " << drift.epochs << " reference fixations";
+    }
+    const EogAxisFit *fits[2] = {&this->_fit_h, &this->_fit_v};
+    const char *names[2] = {"horizontal", "vertical"};
+    for (int axis = 0; axis < 2; axis++) {
+        const EogAxisFit &fit = *fits[axis];
+        std::stringstream polynomial;
+        for (int k = 0; k <= fit.degree; k++) {
+            polynomial << ((k > 0) ? " + " : "") << fit.coefficients[k] << ((k > 0) ? " * eog" : "") << ((k > 1) ? "^" + ofToString(k) : "");
+        }
+        ofLogNotice("EogCalibration") << names[axis] << ": position = " << polynomial.str()
+            << ", rms residual " << fit.rms_residual << " (normalized), R^2 " << fit.r_squared;
+        if (fit.r_squared < 0.9) {
+            ofLogWarning("EogCalibration") << names[axis] << " channel explains the targets poorly, check the electrodes";
+        }
+    }
+
+    // per target: pooled statistics of its fixations and the distance of the fitted position in pixels
+    for (int target = 0; target < (int)this->_layout->size(); target++) {
+        double count = 0, mean_h = 0, mean_v = 0, m2_h = 0, m2_v = 0, error = 0;
+        int fixations = 0;
+        ofVec2f expected = this->_layout->getPosition(target);
+        for (size_t i = 0; i < this->_count.size(); i++) {
+            if ((this->_count[i] == 0) || (schedule.target[i] != target)) {
+                continue;
+            }
+            double pooled = count;
+            merge(count, mean_h, m2_h, this->_count[i], this->_mean_h[i], this->_m2_h[i]);
+            merge(pooled, mean_v, m2_v, this->_count[i], this->_mean_v[i], this->_m2_v[i]);
+            ofVec2f fitted = this->_layout->map(evaluate(this->_fit_h, this->_mean_h[i]), evaluate(this->_fit_v, this->_mean_v[i]));
+            error += fitted.distance(expected);
+            fixations++;
+        }
+        if (fixations == 0) {
+            continue;
+        }
+        ofLogNotice("EogCalibration") << "target " << target << ": " << fixations << " fixations, " << count << " samples"
+            << ", eog " << mean_h << " / " << mean_v
+            << " (sd " << sqrt(m2_h / std::max(1.0, count - 1)) << " / " << sqrt(m2_v / std::max(1.0, count - 1)) << ")"
+            << ", residual " << error / fixations << " px";
+    }
+}
+
+uint64_t EogCalibration::getSampleCount() {
+    return this->_samples;
+}
+
+const EogAxisFit& EogCalibration::getHorizontalFit() {
+    return this->_fit_h;
+}
+
+const EogAxisFit& EogCalibration::getVerticalFit() {
+    return this->_fit_v;
+}
@@ -0,0 +1,82 @@
+//
+//  eogCalibration.h
+//  phd_calibration_eog
+//
+
+#ifndef eogCalibration_h
+#define eogCalibration_h
+
+#include "ofMain.h"
+#include "eogInput.h"
+#include "patternSchedule.h"
+#include "targetLayout.h"
+#include "eogDrift.h"
+#include "sessionTimeline.h"
+
+// one axis of the map from EOG to the normalized screen position
+struct EogAxisFit {
+    bool valid;
+    int degree;
+    double coefficients[4];     // position = c0 + c1 * eog + c2 * eog^2 + ...
+    double rms_residual;        // normalized screen units
+    double r_squared;
+};
+
+/*
+ * Groups the EOG samples of a session by the steps of the running session as
+ * they arrive and keeps running means and variances per fixation. Samples are
+ * taken from the ring in blocks; every run of samples inside one fixation is
+ * reduced in two straight loops over contiguous floats and merged into the
+ * step's statistics. Every finished fixation of the reference target updates
+ * the drift tracker.
+ * At the end of the session a polynomial per axis is fitted from the mean
+ * EOG of every fixation to the position of its target, and the residuals are
+ * reported per target.
+ */
+class EogCalibration {
+public:
+    // settle: seconds after the onset of a target that are left out, degree: of the fitted polynomial (1-3)
+    EogCalibration(PatternSchedule *schedule, SessionTimeline *timeline, TargetLayout *layout, EogRing *ring, EogDriftTracker *drift, double settle, int degree);
+    void startSession(double session_start);
+    // take everything that arrived from the ring, called by one thread only
+    void drain();
+    // drain, fit and report; false if there were too few fixations
+    bool fit();
+
+    uint64_t getSampleCount();
+    const EogAxisFit& getHorizontalFit();
+    const EogAxisFit& getVerticalFit();
+
+private:
+    size_t findStep(double time);
+    void accumulate(size_t step, size_t first, size_t last);
+    void closeReference();
+    bool fitAxis(const vector<double> &eog, const vector<double> &position, const vector<double> &weight, EogAxisFit &fit);
+    double evaluate(const EogAxisFit &fit, double eog);
+    void report();
+
+    PatternSchedule *_schedule;
+    SessionTimeline *_timeline;
+    TargetLayout *_layout;
+    EogRing *_ring;
+    EogDriftTracker *_drift;
+    // reference fixation that still gets samples, -1 if none
+    int _open_reference;
+    double _settle;
+    int _degree;
+    double _session_start, _last_time;
+    size_t _step;
+    uint64_t _samples, _outside;
+
+    // per step: samples, means and sums of squared deviations of both channels
+    vector<double> _count, _mean_h, _mean_v, _m2_h, _m2_v;
+
+    // the block currently taken from the ring, one array per field
+    static const size_t _block_size = 256;
+    double _block_time[_block_size];
+    float _block_h[_block_size], _block_v[_block_size];
+
+    EogAxisFit _fit_h, _fit_v;
+};
+
+#endif /* eogCalibration_h */
@@ -0,0 +1,74 @@
+//
+//  eogDrift.cpp
+//  phd_calibration_eog
+//
+
+#include "eogDrift.h"
+
+EogDriftTracker::EogDriftTracker(double memory) {
+    this->_forget = 1.0 - 1.0 / std::max(1.0, memory);
+    startSession(0);
+}
+
+void EogDriftTracker::startSession(double session_start) {
+    this->_origin = session_start;
+    this->_w = 0;
+    this->_t = 0;
+    this->_tt = 0;
+    this->_y_h = 0;
+    this->_ty_h = 0;
+    this->_y_v = 0;
+    this->_ty_v = 0;
+    std::lock_guard<std::mutex> lock(this->_estimate_mutex);
+    this->_estimate.valid = false;
+    this->_estimate.time = 0;
+    this->_estimate.baseline_h = 0;
+    this->_estimate.baseline_v = 0;
+    this->_estimate.drift_h = 0;
+    this->_estimate.drift_v = 0;
+    this->_estimate.epochs = 0;
+}
+
+void EogDriftTracker::addEpoch(double time, double horizontal, double vertical) {
+    double t = time - this->_origin;
+    this->_w = this->_forget * this->_w + 1;
+    this->_t = this->_forget * this->_t + t;
+    this->_tt = this->_forget * this->_tt + t * t;
+    this->_y_h = this->_forget * this->_y_h + horizontal;
+    this->_ty_h = this->_forget * this->_ty_h + t * horizontal;
+    this->_y_v = this->_forget * this->_y_v + vertical;
+    this->_ty_v = this->_forget * this->_ty_v + t * vertical;
+
+    // a single fixation only gives the baseline, the drift needs two
+    double determinant = this->_w * this->_tt - this->_t * this->_t;
+    double drift_h = 0, drift_v = 0;
+    if (determinant > 1e-9) {
+        drift_h = (this->_w * this->_ty_h - this->_t * this->_y_h) / determinant;
+        drift_v = (this->_w * this->_ty_v - this->_t * this->_y_v) / determinant;
+    }
+    double mean_t = this->_t / this->_w;
+
+    std::lock_guard<std::mutex> lock(this->_estimate_mutex);
+    this->_estimate.valid = true;
+    this->_estimate.time = time;
+    this->_estimate.baseline_h = this->_y_h / this->_w + drift_h * (t - mean_t);
+    this->_estimate.baseline_v = this->_y_v / this->_w + drift_v * (t - mean_t);
+    this->_estimate.drift_h = drift_h;
+    this->_estimate.drift_v = drift_v;
+    this->_estimate.epochs++;
+}
+
+EogDriftEstimate EogDriftTracker::getEstimate() {
+    std::lock_guard<std::mutex> lock(this->_estimate_mutex);
+    return this->_estimate;
+}
+
+bool EogDriftTracker::getBaseline(double time, float &horizontal, float &vertical) {
+    std::lock_guard<std::mutex> lock(this->_estimate_mutex);
+    if (this->_estimate.valid == false) {
+        return false;
+    }
+    horizontal = this->_estimate.baseline_h + this->_estimate.drift_h * (time - this->_estimate.time);
+    vertical = this->_estimate.baseline_v + this->_estimate.drift_v * (time - this->_estimate.time);
+    return true;
+}
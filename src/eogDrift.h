@@ -0,0 +1,44 @@
+//
+//  eogDrift.h
+//  phd_calibration_eog
+//
+
+#ifndef eogDrift_h
+#define eogDrift_h
+
+#include "ofMain.h"
+
+struct EogDriftEstimate {
+    bool valid;
+    double time;                // session clock time of the latest reference fixation
+    float baseline_h, baseline_v; // EOG on the reference target at that time, microvolts
+    float drift_h, drift_v;     // microvolts per second
+    uint32_t epochs;            // reference fixations seen this session
+};
+
+/*
+ * Follows the DC baseline of both EOG channels from the repeated fixations
+ * of the reference target. Every finished reference fixation updates an
+ * exponentially weighted line through the reference means in constant time,
+ * older fixations fade out after about <memory> epochs. The estimate is
+ * read from other threads, e.g. to send it with the eye tracker events.
+ */
+class EogDriftTracker {
+public:
+    EogDriftTracker(double memory);
+    void startSession(double session_start);
+    void addEpoch(double time, double horizontal, double vertical);
+    EogDriftEstimate getEstimate();
+    // baseline extrapolated to a time on the session clock, false without an estimate
+    bool getBaseline(double time, float &horizontal, float &vertical);
+
+private:
+    double _forget, _origin;
+    // weighted sums of the line fit, times relative to the session start
+    double _w, _t, _tt, _y_h, _ty_h, _y_v, _ty_v;
+
+    std::mutex _estimate_mutex;
+    EogDriftEstimate _estimate;
+};
+
+#endif /* eogDrift_h */
@@ -0,0 +1,228 @@
+//
+//  eogInput.cpp
+//  phd_calibration_eog
+//
+
+#include "eogInput.h"
+
+EogInput::EogInput(CalibrationClock *clock, EogRing *ring, int port) {
+    this->_clock = clock;
+    this->_ring = ring;
+    this->_detector = NULL;
+    this->_port = port;
+    this->_first_packet = true;
+    this->_next_sequence = 0;
+    this->_received = 0;
+    this->_dropped = 0;
+    this->_lost_packets = 0;
+}
+
+EogInput::~EogInput() {
+    close();
+}
+
+bool EogInput::open() {
+    this->_udp.Create();
+    this->_udp.SetReuseAddress(true);
+    if (this->_udp.Bind(this->_port) == false) {
+        ofLogError("EogInput") << "could not bind port " << this->_port;
+        return false;
+    }
+    this->_udp.SetReceiveBufferSize(1 << 20);
+    // blocking receive that wakes up once a second to check if it should stop
+    this->_udp.SetNonBlocking(false);
+    this->_udp.SetTimeoutReceive(1);
+    startThread();
+    return true;
+}
+
+void EogInput::close() {
+    if (isThreadRunning() == true) {
+        waitForThread(true);
+        this->_udp.Close();
+    }
+}
+
+void EogInput::setFixationDetector(FixationDetector *detector) {
+    // before open()
+    this->_detector = detector;
+}
+
+uint64_t EogInput::getReceivedCount() {
+    return this->_received.load(std::memory_order_relaxed);
+}
+
+uint64_t EogInput::getDroppedCount() {
+    return this->_dropped.load(std::memory_order_relaxed);
+}
+
+uint64_t EogInput::getLostPacketCount() {
+    return this->_lost_packets.load(std::memory_order_relaxed);
+}
+
+void EogInput::threadedFunction() {
+    char buffer[sizeof(EogPacketHeader) + 64 * sizeof(EogWireSample)];
+    while (isThreadRunning() == true) {
+        int size = this->_udp.Receive(buffer, sizeof(buffer));
+        if (size > 0) {
+            decode(buffer, size);
+        }
+    }
+}
+
+void EogInput::decode(const char *data, int size) {
+    EogPacketHeader header;
+    if ((size < (int)sizeof(header)) || (memcmp(data, "EOGS", 4) != 0)) {
+        return;
+    }
+    memcpy(&header, data, sizeof(header));
+    int count = std::min((int)header.count, (size - (int)sizeof(header)) / (int)sizeof(EogWireSample));
+    if ((this->_first_packet == false) && (header.sequence > this->_next_sequence)) {
+        this->_lost_packets += header.sequence - this->_next_sequence;
+    }
+    this->_first_packet = false;
+    this->_next_sequence = header.sequence + 1;
+
+    double epoch = this->_clock->getEpochUnixTime();
+    EogWireSample wire;
+    EogSample sample;
+    for (int i = 0; i < count; i++) {
+        memcpy(&wire, data + sizeof(header) + i * sizeof(wire), sizeof(wire));
+        sample.time = wire.time - epoch;
+        sample.horizontal = wire.horizontal;
+        sample.vertical = wire.vertical;
+        if (this->_detector != NULL) {
+            this->_detector->addSample(sample.time, sample.horizontal, sample.vertical);
+        }
+        if (this->_ring->push(sample) == false) {
+            this->_dropped++;
+        }
+    }
+    this->_received += count;
+}
+
+SyntheticEog::SyntheticEog(CalibrationClock *clock, PatternSchedule *schedule, SessionTimeline *timeline, TargetLayout *layout, EogRing *ring, double rate) {
+    this->_clock = clock;
+    this->_schedule = schedule;
+    this->_timeline = timeline;
+    this->_layout = layout;
+    this->_ring = ring;
+    this->_detector = NULL;
+    this->_period = 1.0 / rate;
+    this->_session_start = -1;
+    this->_next_sample = 0;
+    this->_step = 0;
+    this->_pursuit_segment = -1;
+    this->_pursuit_start = 0;
+    this->_saccade_time = 0;
+    this->_noise = std::normal_distribution<float>(0.0f, 4.0f);
+}
+
+SyntheticEog::~SyntheticEog() {
+    stop();
+}
+
+void SyntheticEog::start() {
+    startThread();
+}
+
+void SyntheticEog::stop() {
+    if (isThreadRunning() == true) {
+        waitForThread(true);
+    }
+}
+
+void SyntheticEog::setFixationDetector(FixationDetector *detector) {
+    // before start()
+    this->_detector = detector;
+}
+
+void SyntheticEog::startSession(double session_start) {
+    std::lock_guard<std::mutex> lock(this->_session_mutex);
+    this->_session_start = session_start;
+    this->_next_sample = session_start;
+    this->_step = 0;
+    this->_pursuit_segment = -1;
+    this->_pursuit_start = 0;
+    // the eye waits on the center until the first target shows up
+    this->_fixation = ofVec2f(0.5f, 0.5f);
+    this->_saccade_from = this->_fixation;
+    this->_saccade_time = 0;
+}
+
+void SyntheticEog::stopSession() {
+    std::lock_guard<std::mutex> lock(this->_session_mutex);
+    this->_session_start = -1;
+}
+
+void SyntheticEog::advance(double time) {
+    std::lock_guard<std::mutex> lock(this->_session_mutex);
+    if ((this->_session_start < 0) || (this->_schedule->size() == 0)) {
+        return;
+    }
+    PatternSchedule &schedule = *this->_schedule;
+    EogSample sample;
+    while (this->_next_sample <= time) {
+        double session_time = this->_next_sample - this->_session_start;
+        // follow the marker into every step that started before this sample
+        while ((this->_step + 1 < schedule.size()) && (this->_timeline->getOnset(this->_step + 1) <= this->_next_sample)) {
+            double onset = this->_timeline->getOnset(this->_step + 1) - this->_session_start;
+            ofVec2f current = gaze(onset);
+            this->_step++;
+            uint8_t flags = schedule.flags[this->_step];
+            if (schedule.state[this->_step] == PURSUIT) {
+                if ((flags & STEP_PURSUIT) != 0) {
+                    this->_pursuit_segment = schedule.target[this->_step];
+                    this->_pursuit_start = onset;
+                }
+                continue;
+            }
+            if (this->_pursuit_segment > -1) {
+                // the eye stays where the pursuit ended
+                this->_pursuit_segment = -1;
+                this->_saccade_from = current;
+                this->_fixation = current;
+                this->_saccade_time = onset;
+            }
+            // a saccade that already started goes on during the pause
+            if ((flags & STEP_MARKER) != 0) {
+                this->_saccade_from = current;
+                this->_fixation = this->_layout->getNormalized(schedule.target[this->_step]);
+                this->_saccade_time = onset + this->_saccade_latency;
+            }
+        }
+
+        ofVec2f eye = gaze(session_time);
+        float x = eye.x - 0.5f;
+        float y = eye.y - 0.5f;
+        sample.time = this->_next_sample;
+        sample.horizontal = this->_gain_h * (x + this->_nonlinearity * x * x * x) + this->_offset_h + this->_drift_h * session_time + this->_noise(this->_random);
+        sample.vertical = this->_gain_v * (y + this->_nonlinearity * y * y * y) + this->_offset_v + this->_drift_v * session_time + this->_noise(this->_random);
+        if (this->_ring->push(sample) == false) {
+            // the consumer is behind, try again later
+            return;
+        }
+        if (this->_detector != NULL) {
+            this->_detector->addSample(sample.time, sample.horizontal, sample.vertical);
+        }
+        this->_next_sample += this->_period;
+    }
+}
+
+ofVec2f SyntheticEog::gaze(double session_time) {
+    if (this->_pursuit_segment > -1) {
+        return this->_schedule->getTrajectoryPoint(this->_pursuit_segment, std::max(0.0, session_time - this->_pursuit_start - this->_pursuit_lag));
+    }
+    if (session_time < this->_saccade_time) {
+        return this->_saccade_from;
+    }
+    float approach = 1.0f - exp(-(session_time - this->_saccade_time) / this->_saccade_tau);
+    return this->_saccade_from + (this->_fixation - this->_saccade_from) * approach;
+}
+
+void SyntheticEog::threadedFunction() {
+    while (isThreadRunning() == true) {
+        advance(this->_clock->now());
+        sleep(2);
+    }
+}
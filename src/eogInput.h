@@ -0,0 +1,126 @@
+//
+//  eogInput.h
+//  phd_calibration_eog
+//
+
+#ifndef eogInput_h
+#define eogInput_h
+
+#include <random>
+#include "ofMain.h"
+#include "ofxNetwork.h"
+#include "calibrationClock.h"
+#include "spscQueue.h"
+#include "patternSchedule.h"
+#include "targetLayout.h"
+#include "sessionTimeline.h"
+#include "fixationDetector.h"
+
+// one sample of both channels, time on the session clock
+struct EogSample {
+    double time;
+    float horizontal, vertical;
+};
+
+// filled by exactly one source, emptied by the thread that fits the calibration
+typedef SpscQueue<EogSample, 16384> EogRing;
+
+// a datagram is a header followed by <count> samples, little endian
+struct EogPacketHeader {
+    char magic[4];      // "EOGS"
+    uint8_t version;    // 1
+    uint8_t reserved;
+    uint16_t count;     // samples in this datagram, at most 64
+    uint32_t sequence;  // counts datagrams, gaps are lost packets
+};
+static_assert(sizeof(EogPacketHeader) == 12, "eog packet headers are 12 bytes");
+
+struct EogWireSample {
+    double time;        // unix time of the sample, the sender's clock has to be synced
+    float horizontal;   // microvolts
+    float vertical;
+};
+static_assert(sizeof(EogWireSample) == 16, "eog samples are 16 bytes");
+
+/*
+ * Receives EOG samples from the amplifier over UDP and moves them into the
+ * ring on the session clock. Samples that do not fit are counted as dropped.
+ * The fixation detector of the adaptive mode sees every sample right here.
+ */
+class EogInput : public ofThread {
+public:
+    EogInput(CalibrationClock *clock, EogRing *ring, int port);
+    ~EogInput();
+    bool open();
+    void close();
+    void setFixationDetector(FixationDetector *detector);
+
+    uint64_t getReceivedCount();
+    uint64_t getDroppedCount();
+    uint64_t getLostPacketCount();
+
+private:
+    void threadedFunction();
+    void decode(const char *data, int size);
+
+    CalibrationClock *_clock;
+    EogRing *_ring;
+    FixationDetector *_detector;
+    int _port;
+    ofxUDPManager _udp;
+    bool _first_packet;
+    uint32_t _next_sequence;
+    std::atomic<uint64_t> _received, _dropped, _lost_packets;
+};
+
+/*
+ * Stand-in for the amplifier: an eye that looks at the marker of the running
+ * session. It saccades to every new target after a latency, follows pursuit
+ * trajectories with a lag, and the channels see it through a slightly
+ * nonlinear gain with offset, drift and noise.
+ * Runs on its own thread against a steady clock, or is advanced from the
+ * state machine in headless runs.
+ */
+class SyntheticEog : public ofThread {
+public:
+    SyntheticEog(CalibrationClock *clock, PatternSchedule *schedule, SessionTimeline *timeline, TargetLayout *layout, EogRing *ring, double rate);
+    ~SyntheticEog();
+    void setFixationDetector(FixationDetector *detector);
+    void startSession(double session_start);
+    // stop producing samples, before the schedule is replaced
+    void stopSession();
+    // produce every sample up to this time
+    void advance(double time);
+    void start();
+    void stop();
+
+private:
+    void threadedFunction();
+    ofVec2f gaze(double time);
+
+    CalibrationClock *_clock;
+    PatternSchedule *_schedule;
+    SessionTimeline *_timeline;
+    TargetLayout *_layout;
+    EogRing *_ring;
+    FixationDetector *_detector;
+    double _period;
+    std::mutex _session_mutex;
+    double _session_start, _next_sample;
+    size_t _step;
+    int _pursuit_segment;
+    double _pursuit_start;
+    ofVec2f _fixation, _saccade_from;
+    double _saccade_time;
+    std::mt19937 _random;
+    std::normal_distribution<float> _noise;
+
+    // microvolts per screen width and height, offsets in microvolts, drift in microvolts per second
+    const float _gain_h = 600, _gain_v = 400;
+    const float _offset_h = 35, _offset_v = -20;
+    const float _drift_h = 0.5f, _drift_v = 0.8f;
+    const float _nonlinearity = 0.4f;
+    const float _saccade_latency = 0.2f, _saccade_tau = 0.015f, _pursuit_lag = 0.1f;
+};
+
+#endif /* eogInput_h */
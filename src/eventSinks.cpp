@@ -0,0 +1,142 @@
+//
+//  eventSinks.cpp
+//  phd_calibration_eog
+//
+
+#include "eventSinks.h"
+
+NetworkSinks::NetworkSinks(CalibrationClock *clock, UdpTrigger *trigger, ofxOscSender *osc, ofxUDPManager *osc_events, RemoteSoundChannel *remote, vector<ofSoundPlayer*> *commands, SoundCache *sounds)
+    : _osc_stream(_osc_buffer, sizeof(_osc_buffer)) {
+    this->_clock = clock;
+    this->_trigger = trigger;
+    this->_osc = osc;
+    this->_osc_events = osc_events;
+    this->_osc_clock = NULL;
+    this->_drift = NULL;
+    this->_metrics = NULL;
+    this->_in_batch = false;
+    this->_batch_size = 0;
+    this->_batch_planned_time = 0;
+    this->_osc_packets = 0;
+    this->_remote = remote;
+    this->_commands = commands;
+    this->_sounds = sounds;
+    this->_payloads.reserve(_payload_count);
+    for (int code = 0; code < _payload_count; code++) {
+        this->_payloads.push_back(ofToString(code));
+    }
+}
+
+void NetworkSinks::setClockSync(ClockSync *eye_tracker) {
+    this->_osc_clock = eye_tracker;
+}
+
+void NetworkSinks::setDriftTracker(EogDriftTracker *drift) {
+    this->_drift = drift;
+}
+
+void NetworkSinks::setMetrics(Metrics *metrics) {
+    this->_metrics = metrics;
+}
+
+void NetworkSinks::beginBatch(double planned_time) {
+    double unix_time = planned_time + this->_clock->getEpochUnixTime();
+    if (this->_osc_clock != NULL) {
+        unix_time = this->_osc_clock->toPeerTime(planned_time);
+    }
+    // NTP time: seconds since 1900 in the upper, fraction in the lower 32 bits
+    double ntp_time = unix_time + 2208988800.0;
+    uint64_t seconds = (uint64_t)ntp_time;
+    uint64_t fraction = (uint64_t)((ntp_time - seconds) * 4294967296.0);
+    this->_osc_stream.Clear();
+    this->_osc_stream << osc::BeginBundle((seconds << 32) | fraction);
+    this->_in_batch = true;
+    this->_batch_size = 0;
+    this->_batch_planned_time = planned_time;
+}
+
+void NetworkSinks::endBatch() {
+    this->_in_batch = false;
+    if (this->_batch_size == 0) {
+        return;
+    }
+    this->_osc_stream << osc::EndBundle;
+    int sent = this->_osc_events->Send(this->_osc_stream.Data(), this->_osc_stream.Size());
+    this->_osc_packets++;
+    if (this->_metrics != NULL) {
+        this->_metrics->add((sent == (int)this->_osc_stream.Size()) ? METRIC_OSC_SENT : METRIC_OSC_FAILED);
+    }
+}
+
+void NetworkSinks::startRecording() {
+    this->_trigger->startRecording();
+}
+
+void NetworkSinks::stopRecording() {
+    this->_trigger->stopRecording();
+}
+
+const char* NetworkSinks::formatTrigger(int code, char *buffer, size_t size) {
+    if ((code >= 0) && (code < _payload_count)) {
+        return this->_payloads[code].c_str();
+    }
+    snprintf(buffer, size, "%d", code);
+    return buffer;
+}
+
+void NetworkSinks::sendTrigger(int code) {
+    // the copy the addon takes fits the small string buffer
+    char text[16];
+    this->_trigger->sendTrigger(formatTrigger(code, text, sizeof(text)));
+    // the addon does not tell if the send failed
+    if (this->_metrics != NULL) {
+        this->_metrics->add(METRIC_TRIGGER_SENT);
+    }
+}
+
+void NetworkSinks::sendEyeTrackerEvent(int code) {
+    bool single = (this->_in_batch == false);
+    if (single == true) {
+        beginBatch(this->_clock->now());
+    }
+    char text[16];
+    this->_osc_stream << osc::BeginMessage("/set") << "trigger" << formatTrigger(code, text, sizeof(text)) << osc::EndMessage;
+    this->_batch_size++;
+    float baseline_h, baseline_v;
+    if ((this->_drift != NULL) && (this->_drift->getBaseline(this->_batch_planned_time, baseline_h, baseline_v) == true)) {
+        EogDriftEstimate drift = this->_drift->getEstimate();
+        this->_osc_stream << osc::BeginMessage("/eog/drift") << baseline_h << baseline_v << drift.drift_h << drift.drift_v
+            << (osc::int32)drift.epochs << osc::EndMessage;
+        this->_batch_size++;
+    }
+    if (single == true) {
+        endBatch();
+    }
+}
+
+void NetworkSinks::sendRemoteSound(int command) {
+    bool sent = this->_remote->send(command, this->_in_batch ? this->_batch_planned_time : this->_clock->now());
+    if (this->_metrics != NULL) {
+        this->_metrics->add((sent == true) ? METRIC_UDP_SENT : METRIC_UDP_FAILED);
+    }
+}
+
+void NetworkSinks::playCommand(int sound) {
+    if ((sound < 0) || (sound >= (int)this->_commands->size())) {
+        return;
+    }
+    if (this->_sounds->isLoaded() == false) {
+        ofLogWarning("NetworkSinks") << "commands are still loading, skipping command " << sound;
+    } else if ((*this->_commands)[sound] != NULL) {
+        (*this->_commands)[sound]->play();
+    }
+}
+
+uint64_t NetworkSinks::getOscPacketCount() {
+    return this->_osc_packets;
+}
+
+void NetworkSinks::sendControl(ofxOscMessage &msg) {
+    std::lock_guard<std::mutex> lock(this->_osc_mutex);
+    this->_osc->sendMessage(msg);
+}
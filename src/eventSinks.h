@@ -0,0 +1,98 @@
+//
+//  eventSinks.h
+//  phd_calibration_eog
+//
+
+#ifndef eventSinks_h
+#define eventSinks_h
+
+#include "ofMain.h"
+#include "ofx_udp_trigger.h"
+#include "ofxNetwork.h"
+#include "ofxOsc.h"
+#include "OscOutboundPacketStream.h"
+#include "soundCache.h"
+#include "calibrationClock.h"
+#include "remoteSound.h"
+#include "clockSync.h"
+#include "eogDrift.h"
+#include "metrics.h"
+
+/*
+ * Outputs of the state machine. The OutboundEventSender calls these from its
+ * I/O thread; the live app sends to the trigger host, the eye tracker and the
+ * remote sound receiver, headless runs use stand-ins.
+ */
+class EventSinks {
+public:
+    virtual ~EventSinks() {}
+    // everything sent between these belongs to one transition planned for the given time
+    virtual void beginBatch(double /*planned_time*/) {}
+    virtual void endBatch() {}
+    virtual void startRecording() = 0;
+    virtual void stopRecording() = 0;
+    virtual void sendTrigger(int code) = 0;
+    virtual void sendEyeTrackerEvent(int code) = 0;
+    virtual void sendRemoteSound(int command) = 0;
+    virtual void playCommand(int sound) = 0;
+    virtual void sendControl(ofxOscMessage &msg) = 0;
+};
+
+/*
+ * Eye tracker events of one transition go out as a single osc bundle whose
+ * NTP timetag is the planned onset, so the receiver can align them to the
+ * onset instead of the arrival. Bundles are built in place in a reused buffer
+ * and sent over their own socket; commands from the ui use the osc sender.
+ * With EOG input, every trigger event is followed in its bundle by
+ * /eog/drift: the reference baseline of both channels extrapolated to the
+ * onset, the drift per second and the number of reference fixations.
+ * Trigger codes are formatted once up front, so sending a transition does
+ * not touch the heap.
+ */
+class NetworkSinks : public EventSinks {
+public:
+    NetworkSinks(CalibrationClock *clock, UdpTrigger *trigger, ofxOscSender *osc, ofxUDPManager *osc_events, RemoteSoundChannel *remote, vector<ofSoundPlayer*> *commands, SoundCache *sounds);
+    // timetags in the eye tracker's clock once it is known, set before the first session
+    void setClockSync(ClockSync *eye_tracker);
+    // every eye tracker event carries the EOG baseline at its onset
+    void setDriftTracker(EogDriftTracker *drift);
+    // counts sent and failed packets, set before the first session
+    void setMetrics(Metrics *metrics);
+    void beginBatch(double planned_time);
+    void endBatch();
+    void startRecording();
+    void stopRecording();
+    void sendTrigger(int code);
+    void sendEyeTrackerEvent(int code);
+    void sendRemoteSound(int command);
+    void playCommand(int sound);
+    void sendControl(ofxOscMessage &msg);
+
+    uint64_t getOscPacketCount();
+
+private:
+    // the text of a trigger code, preformatted below _payload_count
+    const char* formatTrigger(int code, char *buffer, size_t size);
+
+    CalibrationClock *_clock;
+    UdpTrigger *_trigger;
+    ofxOscSender *_osc;
+    std::mutex _osc_mutex;
+    ofxUDPManager *_osc_events;
+    ClockSync *_osc_clock;
+    EogDriftTracker *_drift;
+    Metrics *_metrics;
+    char _osc_buffer[1024];
+    osc::OutboundPacketStream _osc_stream;
+    bool _in_batch;
+    int _batch_size;
+    double _batch_planned_time;
+    std::atomic<uint64_t> _osc_packets;
+    RemoteSoundChannel *_remote;
+    vector<ofSoundPlayer*> *_commands;
+    SoundCache *_sounds;
+    static const int _payload_count = 1024;
+    vector<string> _payloads;
+};
+
+#endif /* eventSinks_h */
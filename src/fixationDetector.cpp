@@ -0,0 +1,130 @@
+//
+//  fixationDetector.cpp
+//  phd_calibration_eog
+//
+
+#include "fixationDetector.h"
+
+FixationDetector::FixationDetector(double duration, float dispersion, std::function<void(double, double)> detected) {
+    this->_duration = duration;
+    this->_dispersion = dispersion;
+    this->_detected = detected;
+    this->_next_target.armed = false;
+    this->_target = this->_next_target;
+    this->_generation = 0;
+    this->_seen_generation = 0;
+    this->_fired = false;
+    this->_fixation_start = 0;
+    this->_sum_x = 0;
+    this->_sum_y = 0;
+    this->_count = 0;
+}
+
+void FixationDetector::arm(double onset, double deadline, bool same_position, ofVec2f position, float radius) {
+    {
+        std::lock_guard<std::mutex> lock(this->_target_mutex);
+        this->_next_target.armed = true;
+        this->_next_target.same_position = same_position;
+        this->_next_target.onset = onset;
+        this->_next_target.deadline = deadline;
+        this->_next_target.position = position;
+        this->_next_target.radius = radius;
+    }
+    this->_generation.fetch_add(1, std::memory_order_release);
+}
+
+void FixationDetector::disarm() {
+    {
+        std::lock_guard<std::mutex> lock(this->_target_mutex);
+        this->_next_target.armed = false;
+    }
+    this->_generation.fetch_add(1, std::memory_order_release);
+}
+
+void FixationDetector::addSample(double time, float x, float y) {
+    uint32_t generation = this->_generation.load(std::memory_order_acquire);
+    if (generation != this->_seen_generation) {
+        std::lock_guard<std::mutex> lock(this->_target_mutex);
+        this->_target = this->_next_target;
+        this->_seen_generation = generation;
+        this->_fired = false;
+    }
+
+    // the fixation goes on while the sample stays close to its centroid
+    float center_x = (this->_count > 0) ? this->_sum_x / this->_count : x;
+    float center_y = (this->_count > 0) ? this->_sum_y / this->_count : y;
+    float half = this->_dispersion / 2;
+    if ((this->_count == 0) || (fabs(x - center_x) > half) || (fabs(y - center_y) > half)) {
+        this->_fixation_start = time;
+        this->_sum_x = 0;
+        this->_sum_y = 0;
+        this->_count = 0;
+    }
+    this->_sum_x += x;
+    this->_sum_y += y;
+    this->_count++;
+
+    const Target &target = this->_target;
+    if ((target.armed == false) || (this->_fired == true) || (time < target.onset)) {
+        return;
+    }
+    // a fixation from before the onset is still on the previous target
+    bool moved = this->_fixation_start >= target.onset;
+    if ((moved == false) && (target.same_position == false)) {
+        return;
+    }
+    if (time - std::max(this->_fixation_start, target.onset) < this->_duration) {
+        return;
+    }
+    if ((target.radius > 0) && (ofVec2f(this->_sum_x / this->_count, this->_sum_y / this->_count).distance(target.position) > target.radius)) {
+        return;
+    }
+    this->_fired = true;
+    if (time < target.deadline) {
+        this->_detected(target.deadline, time);
+    }
+}
+
+OscGazeInput::OscGazeInput(CalibrationClock *clock, FixationDetector *detector, int port, string address) {
+    this->_clock = clock;
+    this->_detector = detector;
+    this->_port = port;
+    this->_address = address;
+    this->_received = 0;
+}
+
+OscGazeInput::~OscGazeInput() {
+    close();
+}
+
+bool OscGazeInput::open() {
+    if (this->_receiver.setup(this->_port) == false) {
+        ofLogError("OscGazeInput") << "could not listen on port " << this->_port;
+        return false;
+    }
+    startThread();
+    return true;
+}
+
+void OscGazeInput::close() {
+    if (isThreadRunning() == true) {
+        waitForThread(true);
+    }
+}
+
+uint64_t OscGazeInput::getReceivedCount() {
+    return this->_received.load(std::memory_order_relaxed);
+}
+
+void OscGazeInput::threadedFunction() {
+    // the receiver queues messages on its own thread, take every one of them
+    while (isThreadRunning() == true) {
+        while (this->_receiver.getNextMessage(this->_message) == true) {
+            if ((this->_message.getAddress() == this->_address) && (this->_message.getNumArgs() >= 2)) {
+                this->_detector->addSample(this->_clock->now(), this->_message.getArgAsFloat(0), this->_message.getArgAsFloat(1));
+                this->_received++;
+            }
+        }
+        sleep(1);
+    }
+}
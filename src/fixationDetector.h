@@ -0,0 +1,81 @@
+//
+//  fixationDetector.h
+//  phd_calibration_eog
+//
+
+#ifndef fixationDetector_h
+#define fixationDetector_h
+
+#include "ofMain.h"
+#include "ofxOsc.h"
+#include "calibrationClock.h"
+
+/*
+ * Online fixation detection for the adaptive mode. Runs on the thread that
+ * delivers the input, one constant time update per sample: the input is in
+ * a fixation as long as every sample stays within half the dispersion of the
+ * running centroid, a sample outside starts a new one.
+ * Once armed for a target, a fixation that started after the target appeared
+ * (or any, if the target did not move) and lasted long enough reports the
+ * transition it ends through the callback, at most once per target.
+ */
+class FixationDetector {
+public:
+    // callback(deadline, time): end the transition planned for deadline at time
+    FixationDetector(double duration, float dispersion, std::function<void(double, double)> detected);
+    // scheduler thread; radius > 0 also requires the centroid near position (gaze input only)
+    void arm(double onset, double deadline, bool same_position, ofVec2f position, float radius);
+    void disarm();
+    // input thread
+    void addSample(double time, float x, float y);
+
+private:
+    double _duration;
+    float _dispersion;
+    std::function<void(double, double)> _detected;
+
+    // set by the scheduler thread, picked up by the input thread when the generation changes
+    struct Target {
+        bool armed, same_position;
+        double onset, deadline;
+        ofVec2f position;
+        float radius;
+    };
+    std::mutex _target_mutex;
+    Target _next_target;
+    std::atomic<uint32_t> _generation;
+
+    // input thread only
+    Target _target;
+    uint32_t _seen_generation;
+    bool _fired;
+    double _fixation_start;
+    double _sum_x, _sum_y;
+    uint32_t _count;
+};
+
+/*
+ * Gaze from the eye tracker as osc messages (<address> x y, normalized screen
+ * position), fed into the fixation detector as they arrive.
+ */
+class OscGazeInput : public ofThread {
+public:
+    OscGazeInput(CalibrationClock *clock, FixationDetector *detector, int port, string address);
+    ~OscGazeInput();
+    bool open();
+    void close();
+    uint64_t getReceivedCount();
+
+private:
+    void threadedFunction();
+
+    CalibrationClock *_clock;
+    FixationDetector *_detector;
+    int _port;
+    string _address;
+    ofxOscReceiver _receiver;
+    ofxOscMessage _message;
+    std::atomic<uint64_t> _received;
+};
+
+#endif /* fixationDetector_h */
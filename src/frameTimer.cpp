@@ -0,0 +1,153 @@
+//
+//  frameTimer.cpp
+//  phd_calibration_eog
+//
+
+#include "frameTimer.h"
+
+static void clearEpoch(FrameEpoch &epoch, double start, int target, int order_position) {
+    epoch.start = start;
+    epoch.target = target;
+    epoch.order_position = order_position;
+    epoch.frames = 0;
+    epoch.missed = 0;
+    epoch.max_duration = 0;
+    epoch.update_time = 0;
+    epoch.max_update_time = 0;
+    epoch.draw_time = 0;
+    epoch.max_draw_time = 0;
+}
+
+static void addFrame(FrameEpoch &epoch, double duration, double update_time, double draw_time, uint32_t missed) {
+    epoch.frames++;
+    epoch.missed += missed;
+    epoch.max_duration = std::max(epoch.max_duration, duration);
+    epoch.update_time += update_time;
+    epoch.max_update_time = std::max(epoch.max_update_time, update_time);
+    epoch.draw_time += draw_time;
+    epoch.max_draw_time = std::max(epoch.max_draw_time, draw_time);
+}
+
+FrameTimer::FrameTimer(CalibrationClock *clock, float refresh_rate) {
+    this->_clock = clock;
+    this->_estimate_period = (refresh_rate <= 0);
+    this->_period = this->_estimate_period ? 0 : 1.0 / refresh_rate;
+    this->_metrics = NULL;
+    this->_frames = 0;
+    this->_current.duration = 0;
+    this->_current.update_time = 0;
+    this->_current.draw_time = 0;
+    this->_current.swap_time = 0;
+    this->_frame_start = -1;
+    this->_update_start = 0;
+    this->_draw_start = 0;
+    this->_draw_end = 0;
+    clearEpoch(this->_epoch, 0, -1, -1);
+    clearEpoch(this->_session, 0, -1, -1);
+}
+
+void FrameTimer::beginUpdate() {
+    double now = this->_clock->now();
+    if (this->_frame_start >= 0) {
+        finishFrame(now);
+    }
+    this->_frame_start = now;
+    this->_update_start = now;
+    this->_draw_end = now;
+    this->_current.update_time = 0;
+    this->_current.draw_time = 0;
+}
+
+void FrameTimer::endUpdate() {
+    this->_current.update_time = this->_clock->now() - this->_update_start;
+}
+
+void FrameTimer::beginDraw() {
+    this->_draw_start = this->_clock->now();
+}
+
+void FrameTimer::endDraw() {
+    this->_draw_end = this->_clock->now();
+    this->_current.draw_time = this->_draw_end - this->_draw_start;
+}
+
+void FrameTimer::finishFrame(double now) {
+    Frame &frame = this->_current;
+    frame.duration = now - this->_frame_start;
+    // the draw returned, the rest of the frame waited for the swap
+    frame.swap_time = now - this->_draw_end;
+    this->_ring[this->_frames % _ring_size] = frame;
+    this->_frames++;
+
+    uint32_t missed = 0;
+    if (this->_period > 0) {
+        // a frame of one and a half periods or more missed at least one refresh
+        missed = (uint32_t)std::max(0.0, floor(frame.duration / this->_period + 0.5) - 1);
+    }
+    if (this->_metrics != NULL) {
+        this->_metrics->add(METRIC_FRAMES);
+        this->_metrics->add(METRIC_MISSED_VSYNCS, missed);
+        this->_metrics->observe(METRIC_FRAME_TIME, frame.duration);
+    }
+    addFrame(this->_epoch, frame.duration, frame.update_time, frame.draw_time, missed);
+    addFrame(this->_session, frame.duration, frame.update_time, frame.draw_time, missed);
+    if ((this->_estimate_period == true) && (this->_frames % 128 == 0)) {
+        estimatePeriod();
+    }
+}
+
+void FrameTimer::estimatePeriod() {
+    size_t size = std::min(this->_frames, (uint64_t)_ring_size);
+    for (size_t i = 0; i < size; i++) {
+        this->_scratch[i] = this->_ring[i].duration;
+    }
+    std::nth_element(this->_scratch, this->_scratch + size / 2, this->_scratch + size);
+    this->_period = this->_scratch[size / 2];
+}
+
+FrameEpoch FrameTimer::startEpoch(double start, int target, int order_position) {
+    FrameEpoch ended = this->_epoch;
+    clearEpoch(this->_epoch, start, target, order_position);
+    return ended;
+}
+
+FrameEpoch FrameTimer::getSession() {
+    return this->_session;
+}
+
+void FrameTimer::resetSession() {
+    clearEpoch(this->_session, this->_clock->now(), -1, -1);
+}
+
+double FrameTimer::getRefreshPeriod() {
+    return this->_period;
+}
+
+void FrameTimer::setMetrics(Metrics *metrics) {
+    this->_metrics = metrics;
+}
+
+void FrameTimer::drawHud(float x, float y) {
+    size_t size = std::min(this->_frames, (uint64_t)_ring_size);
+    if (size == 0) {
+        return;
+    }
+    for (size_t i = 0; i < size; i++) {
+        this->_scratch[i] = this->_ring[i].duration;
+    }
+    std::sort(this->_scratch, this->_scratch + size);
+    const Frame &last = this->_ring[(this->_frames - 1) % _ring_size];
+    const FrameEpoch &session = this->_session;
+    double frames = std::max(session.frames, (uint32_t)1);
+    string text = "frame " + ofToString(last.duration * 1000, 2) + " ms (update " + ofToString(last.update_time * 1000, 2)
+        + ", draw " + ofToString(last.draw_time * 1000, 2) + ", swap " + ofToString(last.swap_time * 1000, 2) + ")\n"
+        + "last " + ofToString(size) + " frames: p50 " + ofToString(this->_scratch[size / 2] * 1000, 2)
+        + " ms, p99 " + ofToString(this->_scratch[std::min(size - 1, (size_t)(size * 0.99))] * 1000, 2)
+        + " ms, max " + ofToString(this->_scratch[size - 1] * 1000, 2) + " ms\n"
+        + "refresh " + ((this->_period > 0) ? ofToString(1 / this->_period, 1) + " Hz" : string("estimating")) + "\n"
+        + "missed vsyncs: " + ofToString(session.missed) + " in " + ofToString(session.frames) + " frames, "
+        + ofToString(this->_epoch.missed) + " this target\n"
+        + "cpu update " + ofToString(session.update_time / frames * 1000, 2) + " / " + ofToString(session.max_update_time * 1000, 2)
+        + " ms, draw " + ofToString(session.draw_time / frames * 1000, 2) + " / " + ofToString(session.max_draw_time * 1000, 2) + " ms (mean / max)";
+    ofDrawBitmapStringHighlight(text, x, y);
+}
@@ -0,0 +1,74 @@
+//
+//  frameTimer.h
+//  phd_calibration_eog
+//
+
+#ifndef frameTimer_h
+#define frameTimer_h
+
+#include "ofMain.h"
+#include "calibrationClock.h"
+#include "metrics.h"
+
+// frames of one target epoch, from one marker change to the next
+struct FrameEpoch {
+    double start;
+    int target, order_position;
+    uint32_t frames, missed;
+    double max_duration;
+    double update_time, max_update_time;    // sums and maxima, seconds of cpu on the render thread
+    double draw_time, max_draw_time;
+};
+
+/*
+ * Times every frame of the render thread: update, draw, and the wait for the
+ * buffer swap, which with vertical sync ends at the next refresh. The frame
+ * duration is the time from one update to the next; every refresh period a
+ * frame took beyond the first is a missed vsync. The last frames are kept in
+ * a fixed ring for the HUD, and the frames of every target epoch are summed
+ * up so bad epochs can be flagged in the session log.
+ * The refresh period is set, or estimated from the median frame duration.
+ * All methods have to be called from the render thread; apart from the HUD
+ * nothing allocates after construction.
+ */
+class FrameTimer {
+public:
+    // refresh rate of the display in Hz, 0 to estimate it
+    FrameTimer(CalibrationClock *clock, float refresh_rate);
+    void beginUpdate();
+    void endUpdate();
+    void beginDraw();
+    void endDraw();
+    // a new marker: returns the epoch that ended, its frames count from the last update on
+    FrameEpoch startEpoch(double start, int target, int order_position);
+    // totals since the last reset, the current epoch included
+    FrameEpoch getSession();
+    void resetSession();
+    double getRefreshPeriod();
+    // frame times and missed vsyncs go into these as well
+    void setMetrics(Metrics *metrics);
+    void drawHud(float x, float y);
+
+private:
+    struct Frame {
+        double duration, update_time, draw_time, swap_time;
+    };
+    void finishFrame(double now);
+    void estimatePeriod();
+
+    CalibrationClock *_clock;
+    double _period;
+    bool _estimate_period;
+    Metrics *_metrics;
+
+    static const size_t _ring_size = 1024;
+    Frame _ring[_ring_size];
+    double _scratch[_ring_size];
+    uint64_t _frames;
+    Frame _current;
+    double _frame_start, _update_start, _draw_start, _draw_end;
+
+    FrameEpoch _epoch, _session;
+};
+
+#endif /* frameTimer_h */
@@ -0,0 +1,411 @@
+//
+//  headlessRunner.cpp
+//  phd_calibration_eog
+//
+
+#include "headlessRunner.h"
+#include "allocationCounter.h"
+#include <unistd.h>
+
+RecordingSinks::RecordingSinks(CalibrationClock *clock) {
+    this->_clock = clock;
+    this->_overflow = 0;
+}
+
+void RecordingSinks::reserve(size_t capacity) {
+    this->_records.reserve(capacity);
+}
+
+void RecordingSinks::startRecording() {
+    record(START_RECORDING, -1);
+}
+
+void RecordingSinks::stopRecording() {
+    record(STOP_RECORDING, -1);
+}
+
+void RecordingSinks::sendTrigger(int code) {
+    record(TRIGGER, code);
+}
+
+void RecordingSinks::sendEyeTrackerEvent(int code) {
+    record(EYE_TRACKER, code);
+}
+
+void RecordingSinks::sendRemoteSound(int command) {
+    record(REMOTE_SOUND, command);
+}
+
+void RecordingSinks::playCommand(int sound) {
+    record(COMMAND, sound);
+}
+
+void RecordingSinks::sendControl(ofxOscMessage &/*msg*/) {
+}
+
+void RecordingSinks::clear() {
+    this->_records.clear();
+}
+
+const vector<RecordingSinks::Record>& RecordingSinks::getRecords() {
+    return this->_records;
+}
+
+uint64_t RecordingSinks::getOverflowCount() {
+    return this->_overflow;
+}
+
+void RecordingSinks::record(Kind kind, int code) {
+    // never grow, so recording does not allocate
+    if (this->_records.size() >= this->_records.capacity()) {
+        this->_overflow++;
+        return;
+    }
+    Record record;
+    record.kind = kind;
+    record.code = code;
+    record.time = this->_clock->now();
+    this->_records.push_back(record);
+}
+
+namespace {
+    // one step of a hand written schedule, as the original state machine ran it
+    struct ExpectedStep {
+        double onset;
+        CalibrationStates state;
+        uint8_t flags;
+        int16_t target, order_position, trigger, sound, remote_command;
+    };
+
+    const uint8_t MARKER = STEP_MARKER | STEP_BLINKY_ON;
+
+    // returning to item 0 (target 4) after every target, 2 s per target, 1 s pauses, local commands
+    // a.wav (sound 0) for items 0 and 2, b.wav (sound 1) for item 1
+    const char *reference_pattern =
+        "<order><verbal_commands>1</verbal_commands><reference>0</reference><size>3</size>"
+        "<item><n>4</n><command>a.wav</command></item>"
+        "<item><n>1</n><command>b.wav</command></item>"
+        "<item><n>7</n><command>a.wav</command></item></order>";
+    const ExpectedStep reference_steps[] = {
+        { 0, PAUSE2TARGET,    0,           -1, -1,  0,  0, -1},
+        { 1, TARGET,          MARKER,       4,  0,  0, -1, -1},
+        { 3, PAUSE2REFERENCE, 0,           -1,  0,  0,  0, -1},
+        { 4, REFERENCE,       MARKER,       4,  0,  0, -1, -1},
+        { 6, PAUSE2TARGET,    0,           -1,  0,  0,  1, -1},
+        { 7, TARGET,          MARKER,       1,  1,  1, -1, -1},
+        { 9, PAUSE2REFERENCE, 0,           -1,  1,  1,  0, -1},
+        {10, REFERENCE,       MARKER,       4,  0,  0, -1, -1},
+        {12, PAUSE2TARGET,    0,           -1,  1,  0,  0, -1},
+        {13, TARGET,          MARKER,       7,  2,  2, -1, -1},
+        {15, PAUSE2REFERENCE, 0,           -1,  2,  2,  0, -1},
+        {16, REFERENCE,       MARKER,       4,  0,  0, -1, -1},
+        {18, PAUSE2TARGET,    0,           -1,  2,  0, -1, -1},
+        {19, TARGET,          STEP_FINISH, -1,  3,  3, -1, -1}
+    };
+
+    // no reference: the pauses send trigger -1; the commands and beeps go to the remote receiver
+    const char *remote_pattern =
+        "<order><verbal_commands>1</verbal_commands><reference>-1</reference><size>2</size>"
+        "<item><n>2</n><command>a.wav</command></item>"
+        "<item><n>5</n></item></order>";
+    const ExpectedStep remote_steps[] = {
+        {0, PAUSE2TARGET, 0,                              -1, -1, -1, -1,  0},
+        {1, TARGET,       MARKER | STEP_REMOTE_BEEP,       2,  0,  0, -1, -1},
+        {3, PAUSE2TARGET, STEP_REMOTE_BEEP,               -1,  0, -1, -1,  1},
+        {4, TARGET,       MARKER | STEP_REMOTE_BEEP,       5,  1,  1, -1, -1},
+        {6, PAUSE2TARGET, STEP_REMOTE_BEEP,               -1,  1, -1, -1, -1},
+        {7, TARGET,       STEP_FINISH | STEP_REMOTE_BEEP, -1,  2,  2, -1, -1}
+    };
+
+    bool matchSchedule(string name, PatternSchedule &schedule, const ExpectedStep *steps, size_t count) {
+        if (schedule.size() != count) {
+            ofLogError("HeadlessRunner") << name << ": expected " << count << " steps, compiled " << schedule.size();
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            const ExpectedStep &step = steps[i];
+            if ((fabs(schedule.onset[i] - step.onset) > 1e-9) || (schedule.state[i] != step.state) || (schedule.flags[i] != step.flags)
+                || (schedule.target[i] != step.target) || (schedule.order_position[i] != step.order_position) || (schedule.trigger[i] != step.trigger)
+                || (schedule.sound[i] != step.sound) || (schedule.remote_command[i] != step.remote_command)) {
+                ofLogError("HeadlessRunner") << name << ", step " << i << ": expected " << step.onset << " s, state " << step.state
+                    << ", flags " << (int)step.flags << ", target " << step.target << ", position " << step.order_position << ", trigger " << step.trigger
+                    << ", sound " << step.sound << ", remote " << step.remote_command << "; compiled " << schedule.onset[i] << " s, state " << (int)schedule.state[i]
+                    << ", flags " << (int)schedule.flags[i] << ", target " << schedule.target[i] << ", position " << schedule.order_position[i]
+                    << ", trigger " << schedule.trigger[i] << ", sound " << schedule.sound[i] << ", remote " << schedule.remote_command[i];
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool compareSchedule(string directory, string name, const char *pattern, const ScheduleSettings &settings, const ExpectedStep *steps, size_t count) {
+        // the fixture and its compiled cache only live in the directory of the check
+        string filename = directory + "/" + name + ".xml";
+        std::ofstream file(filename.c_str(), std::ios::trunc);
+        file << pattern;
+        file.close();
+        PatternSchedule schedule;
+        bool passed = (schedule.load(filename, settings) == true) && (matchSchedule(name, schedule, steps, count) == true);
+        schedule.unload();
+        std::remove(filename.c_str());
+        std::remove((directory + "/" + name + ".sched").c_str());
+        return passed;
+    }
+}
+
+HeadlessRunner::HeadlessRunner(string pattern_filename) {
+    this->_clock = new VirtualClock();
+    this->_sinks = new RecordingSinks(this->_clock);
+    this->_pattern = new CalibrationPattern(this->_clock, this->_sinks, pattern_filename);
+    this->_audio = NULL;
+    // every step sends at most a beep, trigger, eye tracker event and command
+    this->_sinks->reserve(this->_pattern->getSchedule()->size() * 4 + 8);
+}
+
+HeadlessRunner::~HeadlessRunner() {
+    delete this->_pattern;
+    delete this->_audio;
+    delete this->_sinks;
+    delete this->_clock;
+}
+
+int HeadlessRunner::simulate(int sessions, const vector<string> &participants) {
+    int failed = 0;
+    int total = 0;
+    if (checkSchedule() == false) {
+        failed++;
+    }
+    size_t runs = std::max(participants.size(), (size_t)1);
+    for (size_t p = 0; p < runs; p++) {
+        if (participants.empty() == false) {
+            if (this->_pattern->loadParticipant(participants[p]) == false) {
+                failed++;
+                continue;
+            }
+            this->_sinks->reserve(this->_pattern->getSchedule()->size() * 4 + 8);
+        }
+        for (int i = 0; i < sessions; i++) {
+            this->_sinks->clear();
+            this->_pattern->startCalibration();
+            this->_pattern->runHeadless();
+            this->_pattern->reportSession();
+            if (verify() == false) {
+                failed++;
+            }
+            total++;
+        }
+        ofLogNotice("HeadlessRunner") << this->_pattern->getCodeword() << ": " << sessions << " sessions of " << this->_pattern->getSchedule()->size() << " steps";
+    }
+    ofLogNotice("HeadlessRunner") << total << " sessions of " << runs << " participants, "
+        << failed << " failed or did not match the schedule, ended at " << this->_clock->now() << " s virtual time";
+    return (failed == 0) ? 0 : 1;
+}
+
+int HeadlessRunner::benchmark(uint64_t transitions) {
+    size_t steps = this->_pattern->getSchedule()->size();
+    if (steps < 2) {
+        ofLogError("HeadlessRunner") << "no pattern to run";
+        return 1;
+    }
+    // the second pass updates a metrics registry on every send, its overhead is the difference
+    Metrics metrics;
+    for (int pass = 0; pass < 2; pass++) {
+        this->_pattern->setMetrics((pass == 1) ? &metrics : NULL);
+        uint64_t done = 0;
+        uint64_t sessions = 0;
+        uint64_t allocations = 0;
+        // keep the per session notices out of the measurement
+        ofSetLogLevel(OF_LOG_WARNING);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        while (done < transitions) {
+            this->_sinks->clear();
+            this->_pattern->startCalibration();
+            uint64_t before = getAllocationCount();
+            this->_pattern->runHeadless();
+            allocations += getAllocationCount() - before;
+            this->_pattern->reportSession();
+            done += steps - 1;
+            sessions++;
+        }
+        double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        ofSetLogLevel(OF_LOG_NOTICE);
+        std::ostringstream allocated;
+        if (isCountingAllocations() == true) {
+            allocated << ", " << allocations / (double)done << " allocations/transition";
+        }
+        ofLogNotice("HeadlessRunner") << done << " transitions in " << sessions << " sessions took " << duration * 1000 << " ms"
+            << ((pass == 1) ? " with metrics: " : ": ") << done / duration << " transitions/s" << allocated.str();
+    }
+    this->_pattern->setMetrics(NULL);
+    return 0;
+}
+
+int HeadlessRunner::checkAllocations(int sessions) {
+    if (this->_pattern->getSchedule()->size() < 2) {
+        ofLogError("HeadlessRunner") << "no pattern to run";
+        return 1;
+    }
+    if (isCountingAllocations() == false) {
+        ofLogError("HeadlessRunner") << "allocations are not counted, build with CHECK_ALLOCATIONS defined";
+        return 1;
+    }
+    // the first session sizes the reusable buffers, it is startup
+    this->_sinks->clear();
+    this->_pattern->startCalibration();
+    this->_pattern->runHeadless();
+    this->_pattern->reportSession();
+    int failed = 0;
+    for (int i = 0; i < sessions; i++) {
+        this->_sinks->clear();
+        uint64_t before = getAllocationCount();
+        this->_pattern->startCalibration();
+        this->_pattern->runHeadless();
+        uint64_t allocations = getAllocationCount() - before;
+        this->_pattern->reportSession();
+        if (allocations > 0) {
+            ofLogError("HeadlessRunner") << "session " << i << ": " << allocations << " allocations";
+            failed++;
+        }
+    }
+    ofLogNotice("HeadlessRunner") << sessions << " sessions of " << this->_pattern->getSchedule()->size() << " steps, "
+        << failed << " allocated on the transition path";
+    return (failed == 0) ? 0 : 1;
+}
+
+int HeadlessRunner::checkAudio(int sessions) {
+    // with remote sound the engine would have nothing to play
+    this->_pattern->useLocalSound();
+    PatternSchedule *schedule = this->_pattern->getSchedule();
+    if (schedule->size() < 2) {
+        ofLogError("HeadlessRunner") << "no pattern to run";
+        return 1;
+    }
+    // rendered on the virtual clock, everything played ends up in the file
+    const int rate = 48000;
+    this->_audio = new AudioEngine(this->_clock, rate, 64);
+    if (this->_audio->start(AUDIO_FILE, 0.005, "audio_check.wav", true) == false) {
+        return 1;
+    }
+    this->_pattern->attachAudio(this->_audio);
+    size_t commands = 0, beeps = 0;
+    for (size_t i = 0; i < schedule->size(); i++) {
+        if (schedule->sound[i] > -1) {
+            commands++;
+        }
+        if ((i > 0) && ((schedule->state[i] == PAUSE2TARGET) || (schedule->state[i] == PAUSE2REFERENCE))) {
+            beeps++;
+        }
+    }
+    if (commands + beeps == 0) {
+        ofLogError("HeadlessRunner") << "the pattern plays no commands or beeps, nothing to check";
+        return 1;
+    }
+    int failed = 0;
+    for (int i = 0; i < sessions; i++) {
+        this->_sinks->clear();
+        uint64_t before = getAllocationCount();
+        this->_pattern->startCalibration();
+        this->_pattern->runHeadless();
+        uint64_t allocations = getAllocationCount() - before;
+        // every cue was queued a step ahead, so it has to start within half a sample of its time;
+        // only the command of the first step is queued with the session start and comes one latency late
+        uint64_t late_allowed = (schedule->sound[0] > -1) ? 1 : 0;
+        bool on_time = (this->_audio->getLateCount() <= late_allowed) && (this->_audio->getDroppedCount() == 0)
+            && (this->_audio->getMaxError() <= 0.5 / rate + 1e-9) && (this->_audio->getCueCount() >= commands + beeps);
+        // the first session sizes the buffers
+        if ((i > 0) && (allocations > 0)) {
+            ofLogError("HeadlessRunner") << "session " << i << ": " << allocations << " allocations with the audio engine";
+            on_time = false;
+        }
+        if (on_time == false) {
+            ofLogError("HeadlessRunner") << "session " << i << ": " << this->_audio->getCueCount() << " cues for " << commands << " commands and " << beeps << " beeps, "
+                << this->_audio->getLateCount() << " late, " << this->_audio->getDroppedCount() << " dropped, max error "
+                << this->_audio->getMaxError() * 1e6 << " us";
+            failed++;
+        }
+        this->_pattern->reportSession();
+    }
+    this->_audio->stop();
+    ofLogNotice("HeadlessRunner") << sessions << " sessions with " << commands << " commands and " << beeps << " beeps each, " << failed
+        << " with cues off their sample or allocating, output in audio_check.wav";
+    return (failed == 0) ? 0 : 1;
+}
+
+bool HeadlessRunner::checkSchedule() {
+    ScheduleSettings settings;
+    settings.time_per_target = 2;
+    settings.pause_duration = 1;
+    settings.use_beeps = false;
+    settings.use_remote_sound = false;
+    // not in the data folder of the experiment, the fixtures are removed again
+    const char *temporary = getenv("TMPDIR");
+    string directory = string((temporary != NULL) ? temporary : "/tmp") + "/schedule_check_XXXXXX";
+    if (mkdtemp(&directory[0]) == NULL) {
+        ofLogError("HeadlessRunner") << "could not create a directory for the schedule check";
+        return false;
+    }
+    bool passed = compareSchedule(directory, "reference", reference_pattern, settings, reference_steps, sizeof(reference_steps) / sizeof(ExpectedStep));
+    settings.use_beeps = true;
+    settings.use_remote_sound = true;
+    passed &= compareSchedule(directory, "remote", remote_pattern, settings, remote_steps, sizeof(remote_steps) / sizeof(ExpectedStep));
+    rmdir(directory.c_str());
+    ofLogNotice("HeadlessRunner") << "schedule compiler " << (passed ? "matches" : "does not match") << " the hand written step tables";
+    return passed;
+}
+
+bool HeadlessRunner::verify() {
+    // expected outputs of every step, beeps aside
+    // steps may start early in the adaptive mode, the timeline has when they did
+    PatternSchedule *schedule = this->_pattern->getSchedule();
+    SessionTimeline *timeline = this->_pattern->getTimeline();
+    double start = this->_pattern->getSessionStart();
+    vector<RecordingSinks::Record> expected;
+    RecordingSinks::Record record;
+    record.kind = RecordingSinks::START_RECORDING;
+    record.code = -1;
+    record.time = start;
+    expected.push_back(record);
+    for (size_t i = 0; i < schedule->size(); i++) {
+        record.time = timeline->getOnset(i);
+        if (schedule->trigger[i] != NO_TRIGGER) {
+            record.kind = RecordingSinks::TRIGGER;
+            record.code = schedule->trigger[i];
+            expected.push_back(record);
+            record.kind = RecordingSinks::EYE_TRACKER;
+            expected.push_back(record);
+        }
+        if (schedule->remote_command[i] > -1) {
+            record.kind = RecordingSinks::REMOTE_SOUND;
+            record.code = schedule->remote_command[i];
+            expected.push_back(record);
+        }
+        if (schedule->sound[i] > -1) {
+            record.kind = RecordingSinks::COMMAND;
+            record.code = schedule->sound[i];
+            expected.push_back(record);
+        }
+    }
+    record.kind = RecordingSinks::STOP_RECORDING;
+    record.code = -1;
+    expected.push_back(record);
+
+    vector<RecordingSinks::Record> actual;
+    const vector<RecordingSinks::Record> &records = this->_sinks->getRecords();
+    for (size_t i = 0; i < records.size(); i++) {
+        if ((records[i].kind != RecordingSinks::REMOTE_SOUND) || (records[i].code != 9999)) {
+            actual.push_back(records[i]);
+        }
+    }
+    if (actual.size() != expected.size()) {
+        ofLogError("HeadlessRunner") << "expected " << expected.size() << " events, got " << actual.size();
+        return false;
+    }
+    for (size_t i = 0; i < expected.size(); i++) {
+        if ((actual[i].kind != expected[i].kind) || (actual[i].code != expected[i].code) || (fabs(actual[i].time - expected[i].time) > 1e-9)) {
+            ofLogError("HeadlessRunner") << "event " << i << ": expected " << expected[i].kind << "/" << expected[i].code << " at " << expected[i].time
+                << ", got " << actual[i].kind << "/" << actual[i].code << " at " << actual[i].time;
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,79 @@
+//
+//  headlessRunner.h
+//  phd_calibration_eog
+//
+
+#ifndef headlessRunner_h
+#define headlessRunner_h
+
+#include "ofMain.h"
+#include "calibrationPattern.h"
+#include "calibrationClock.h"
+#include "eventSinks.h"
+#include "audioEngine.h"
+
+/*
+ * Stand-in outputs that record what the state machine sent and when, into a
+ * buffer reserved up front.
+ */
+class RecordingSinks : public EventSinks {
+public:
+    enum Kind { START_RECORDING, STOP_RECORDING, TRIGGER, EYE_TRACKER, REMOTE_SOUND, COMMAND };
+    struct Record {
+        Kind kind;
+        int code;
+        double time;
+    };
+
+    RecordingSinks(CalibrationClock *clock);
+    void reserve(size_t capacity);
+    void startRecording();
+    void stopRecording();
+    void sendTrigger(int code);
+    void sendEyeTrackerEvent(int code);
+    void sendRemoteSound(int command);
+    void playCommand(int sound);
+    void sendControl(ofxOscMessage &msg);
+
+    void clear();
+    const vector<Record>& getRecords();
+    uint64_t getOverflowCount();
+
+private:
+    void record(Kind kind, int code);
+
+    CalibrationClock *_clock;
+    vector<Record> _records;
+    uint64_t _overflow;
+};
+
+/*
+ * Runs whole sessions without a window against a virtual clock and the
+ * recording sinks, checks the emitted events against the compiled schedule
+ * and measures how fast the state machine goes and that it does not allocate.
+ * The schedule compiler itself is checked against hand written step tables.
+ */
+class HeadlessRunner {
+public:
+    HeadlessRunner(string pattern_filename = "");
+    ~HeadlessRunner();
+    // every participant (codeword or pattern file) in turn, in one pattern instance
+    int simulate(int sessions, const vector<string> &participants = vector<string>());
+    int benchmark(uint64_t transitions);
+    // fails if a session after the first allocates between its start and its last transition
+    int checkAllocations(int sessions);
+    // sessions with the audio engine rendering to a file, fails if a cue starts off its sample or a session allocates
+    int checkAudio(int sessions);
+
+private:
+    bool verify();
+    // compiles fixed patterns and compares them to step tables written out by hand
+    bool checkSchedule();
+
+    VirtualClock *_clock;
+    RecordingSinks *_sinks;
+    CalibrationPattern *_pattern;
+    AudioEngine *_audio;
+};
+
+#endif /* headlessRunner_h */
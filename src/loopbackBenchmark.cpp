@@ -0,0 +1,389 @@
+//
+//  loopbackBenchmark.cpp
+//  phd_calibration_eog
+//
+
+#include "loopbackBenchmark.h"
+#include "allocationCounter.h"
+
+LoopbackReceiver::LoopbackReceiver(string name, int port, Format format, SteadyClock *clock, double epoch_unix_time) {
+    this->_name = name;
+    this->_epoch_unix_time = epoch_unix_time;
+    this->_port = port;
+    this->_format = format;
+    this->_clock = clock;
+    this->_count = 0;
+}
+
+LoopbackReceiver::~LoopbackReceiver() {
+    close();
+}
+
+bool LoopbackReceiver::open(size_t capacity) {
+    this->_arrivals.resize(capacity);
+    this->_count = 0;
+    this->_udp.Create();
+    this->_udp.SetReuseAddress(true);
+    if (this->_udp.Bind(this->_port) == false) {
+        ofLogError("LoopbackReceiver") << this->_name << ": could not bind port " << this->_port;
+        return false;
+    }
+    this->_udp.SetReceiveBufferSize(1 << 20);
+    // blocking receive that wakes up once a second to check if it should stop
+    this->_udp.SetNonBlocking(false);
+    this->_udp.SetTimeoutReceive(1);
+    startThread();
+    return true;
+}
+
+void LoopbackReceiver::close() {
+    if (isThreadRunning() == true) {
+        waitForThread(true);
+        this->_udp.Close();
+    }
+}
+
+void LoopbackReceiver::clear() {
+    // only between sessions, while nothing is sent
+    this->_count = 0;
+}
+
+size_t LoopbackReceiver::getCount() {
+    return this->_count.load(std::memory_order_acquire);
+}
+
+const vector<LoopbackReceiver::Arrival>& LoopbackReceiver::getArrivals() {
+    return this->_arrivals;
+}
+
+string LoopbackReceiver::getName() {
+    return this->_name;
+}
+
+void LoopbackReceiver::threadedFunction() {
+    char buffer[1024];
+    while (isThreadRunning() == true) {
+        int size = this->_udp.Receive(buffer, sizeof(buffer));
+        double time = this->_clock->now();
+        size_t count = this->_count.load(std::memory_order_relaxed);
+        if ((size > 0) && (count < this->_arrivals.size())) {
+            this->_arrivals[count].code = decode(buffer, size, this->_arrivals[count].tag_time);
+            this->_arrivals[count].time = time;
+            this->_count.store(count + 1, std::memory_order_release);
+        }
+    }
+}
+
+// what arrived was no code at all
+static const int INVALID_CODE = std::numeric_limits<int>::min();
+
+static int parseCode(const char *data, int size) {
+    int code = 0, digits = 0, sign = 1;
+    for (int i = 0; i < size; i++) {
+        if ((data[i] >= '0') && (data[i] <= '9')) {
+            code = code * 10 + (data[i] - '0');
+            digits++;
+        } else if ((data[i] == '-') && (i == 0)) {
+            // steps without a reference item send -1
+            sign = -1;
+        } else if ((data[i] == '\0') || (data[i] == '\n') || (data[i] == '\r')) {
+            break;
+        } else {
+            return INVALID_CODE;
+        }
+    }
+    return (digits > 0) ? sign * code : INVALID_CODE;
+}
+
+int LoopbackReceiver::decode(const char *data, int size, double &tag_time) {
+    tag_time = -1;
+    if (this->_format == ASCII) {
+        return parseCode(data, size);
+    }
+    if (this->_format == REMOTE_SOUND) {
+        RemoteSoundMessage message;
+        if ((size != sizeof(message)) || (memcmp(data, "EOGR", 4) != 0)) {
+            return INVALID_CODE;
+        }
+        memcpy(&message, data, sizeof(message));
+        return message.command;
+    }
+    if ((size >= 20) && (memcmp(data, "#bundle", 8) == 0)) {
+        // bundle: NTP timetag, then size prefixed elements; the events of a transition share one
+        uint32_t seconds = ((uint8_t)data[8] << 24) | ((uint8_t)data[9] << 16) | ((uint8_t)data[10] << 8) | (uint8_t)data[11];
+        uint32_t fraction = ((uint8_t)data[12] << 24) | ((uint8_t)data[13] << 16) | ((uint8_t)data[14] << 8) | (uint8_t)data[15];
+        tag_time = seconds - 2208988800.0 + fraction / 4294967296.0 - this->_epoch_unix_time;
+        int element_size = ((uint8_t)data[16] << 24) | ((uint8_t)data[17] << 16) | ((uint8_t)data[18] << 8) | (uint8_t)data[19];
+        data += 20;
+        size = std::min(size - 20, element_size);
+    }
+    // osc: padded address, padded type tags, then the arguments; the code is the last string
+    int position = (strnlen(data, size) / 4 + 1) * 4;
+    if ((position >= size) || (data[position] != ',')) {
+        return INVALID_CODE;
+    }
+    const char *tags = data + position + 1;
+    int number_of_tags = strnlen(data + position, size - position) - 1;
+    position += ((number_of_tags + 1) / 4 + 1) * 4;
+    int code = INVALID_CODE;
+    for (int i = 0; (i < number_of_tags) && (position < size); i++) {
+        if (tags[i] == 's') {
+            int length = strnlen(data + position, size - position);
+            code = parseCode(data + position, length);
+            position += (length / 4 + 1) * 4;
+        } else {
+            position += 4;
+        }
+    }
+    return code;
+}
+
+LoadThread::LoadThread(double busy_duration, double period) {
+    this->_busy_duration = busy_duration;
+    this->_period = period;
+    this->_stop_requested = false;
+    startThread();
+}
+
+void LoadThread::stop() {
+    this->_stop_requested = true;
+    waitForThread(true);
+}
+
+void LoadThread::threadedFunction() {
+    volatile double sink = 0;
+    std::chrono::steady_clock::time_point frame = std::chrono::steady_clock::now();
+    while (this->_stop_requested == false) {
+        std::chrono::steady_clock::time_point busy_until = frame + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(this->_busy_duration));
+        while (std::chrono::steady_clock::now() < busy_until) {
+            sink = sink + sqrt(sink + 1.0);
+        }
+        frame += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(this->_period));
+        if (this->_busy_duration < this->_period) {
+            std::this_thread::sleep_until(frame);
+        }
+    }
+}
+
+LoopbackBenchmark::LoopbackBenchmark(Options options) {
+    this->_options = options;
+    this->_clock = new SteadyClock();
+
+    // the live sinks, pointed at this machine
+    this->_trigger = new UdpTrigger("127.0.0.1");
+    this->_trigger->connectToHost();
+    this->_osc = new ofxOscSender();
+    this->_osc->setup("127.0.0.1", 8000);
+    this->_osc_events.Create();
+    this->_osc_events.Connect("127.0.0.1", 8000);
+    this->_osc_events.SetNonBlocking(true);
+    this->_udp.Create();
+    this->_udp.Connect("127.0.0.1", options.remote_port);
+    this->_udp.SetNonBlocking(true);
+    this->_remote = new RemoteSoundChannel(this->_clock, &this->_udp, false);
+    // no local commands, playing sounds is not part of the measurement
+    this->_sinks = new NetworkSinks(this->_clock, this->_trigger, this->_osc, &this->_osc_events, this->_remote, &this->_no_commands, NULL);
+    this->_pattern = new CalibrationPattern(this->_clock, this->_sinks, options.pattern_filename, true);
+
+    this->_trigger_receiver = new LoopbackReceiver("trigger", options.trigger_port, LoopbackReceiver::ASCII, this->_clock);
+    this->_osc_receiver = new LoopbackReceiver("eye tracker", 8000, LoopbackReceiver::OSC, this->_clock, this->_clock->getEpochUnixTime());
+    this->_remote_receiver = new LoopbackReceiver("remote sound", options.remote_port, LoopbackReceiver::REMOTE_SOUND, this->_clock);
+}
+
+LoopbackBenchmark::~LoopbackBenchmark() {
+    delete this->_remote_receiver;
+    delete this->_osc_receiver;
+    delete this->_trigger_receiver;
+    delete this->_pattern;
+    delete this->_sinks;
+    delete this->_remote;
+    delete this->_osc;
+    delete this->_trigger;
+    delete this->_clock;
+}
+
+int LoopbackBenchmark::run() {
+    size_t steps = this->_pattern->getSchedule()->size();
+    if (steps < 2) {
+        ofLogError("LoopbackBenchmark") << "no pattern to run";
+        return 1;
+    }
+    expect();
+    // every step sends at most one packet per receiver, plus beeps and recording control
+    size_t capacity = steps * 2 + 16;
+    if ((this->_trigger_receiver->open(capacity) == false) || (this->_osc_receiver->open(capacity) == false) || (this->_remote_receiver->open(capacity) == false)) {
+        return 1;
+    }
+
+    vector<LoadThread*> load;
+    for (int i = 0; i < this->_options.cpu_load_threads; i++) {
+        load.push_back(new LoadThread(0.01, 0.01));
+    }
+    if (this->_options.render_load > 0) {
+        load.push_back(new LoadThread(this->_options.render_load / 1000.0, 1.0 / 60.0));
+    }
+    ofLogNotice("LoopbackBenchmark") << this->_options.sessions << " sessions of " << this->_recording[1].planned_time << " s, "
+        << this->_options.cpu_load_threads << " cpu load threads, " << this->_options.render_load << " ms render load per frame";
+    ofSleepMillis(100);
+
+    vector<double> trigger_latencies, osc_latencies, remote_latencies, tag_errors;
+    int trigger_mismatched = 0, osc_mismatched = 0, remote_mismatched = 0;
+    int allocating_sessions = 0;
+    vector<Expected> none;
+    for (int i = 0; i < this->_options.sessions; i++) {
+        this->_trigger_receiver->clear();
+        this->_osc_receiver->clear();
+        this->_remote_receiver->clear();
+        this->_pattern->startCalibration();
+        // counted on every thread from the start of the scheduler thread until the last packet arrived
+        uint64_t before = getAllocationCount();
+        while (this->_pattern->isRunning() == true) {
+            ofSleepMillis(10);
+        }
+        // the stop recording command leaves the I/O thread after the last transition
+        if (waitForArrivals(1.0) == false) {
+            ofLogWarning("LoopbackBenchmark") << "session " << i << ": packets missing";
+        }
+        uint64_t allocations = getAllocationCount() - before;
+        this->_pattern->reportSession();
+        if (allocations > 0) {
+            ofLogError("LoopbackBenchmark") << "session " << i << ": " << allocations << " allocations on the scheduler and I/O threads";
+            allocating_sessions++;
+        }
+        trigger_mismatched += match(this->_trigger_receiver, this->_triggers, this->_recording, trigger_latencies, tag_errors);
+        osc_mismatched += match(this->_osc_receiver, this->_eye_tracker, none, osc_latencies, tag_errors);
+        remote_mismatched += match(this->_remote_receiver, this->_remote_sounds, none, remote_latencies, tag_errors);
+    }
+
+    for (size_t i = 0; i < load.size(); i++) {
+        load[i]->stop();
+        delete load[i];
+    }
+    this->_trigger_receiver->close();
+    this->_osc_receiver->close();
+    this->_remote_receiver->close();
+
+    report(this->_trigger_receiver->getName(), trigger_latencies, trigger_mismatched);
+    report(this->_osc_receiver->getName(), osc_latencies, osc_mismatched);
+    report(this->_remote_receiver->getName(), remote_latencies, remote_mismatched);
+    if (tag_errors.empty() == false) {
+        // how far the receiver would be off aligning to the timetag instead of the planned onset
+        double mean = 0, largest = 0;
+        for (size_t i = 0; i < tag_errors.size(); i++) {
+            mean += tag_errors[i] / tag_errors.size();
+            largest = std::max(largest, fabs(tag_errors[i]));
+        }
+        ofLogNotice("LoopbackBenchmark") << "osc timetags: " << tag_errors.size() << " bundles, mean skew to the planned onset "
+            << mean * 1e6 << " us, max " << largest * 1e6 << " us";
+    }
+    if (isCountingAllocations() == true) {
+        ofLogNotice("LoopbackBenchmark") << allocating_sessions << " of " << this->_options.sessions << " sessions allocated while running";
+    }
+    return ((trigger_mismatched + osc_mismatched + remote_mismatched + allocating_sessions) == 0) ? 0 : 1;
+}
+
+void LoopbackBenchmark::expect() {
+    PatternSchedule *schedule = this->_pattern->getSchedule();
+    Expected expected;
+    for (size_t i = 0; i < schedule->size(); i++) {
+        expected.planned_time = schedule->onset[i];
+        if (schedule->trigger[i] != NO_TRIGGER) {
+            expected.code = schedule->trigger[i];
+            this->_triggers.push_back(expected);
+            this->_eye_tracker.push_back(expected);
+        }
+        if (schedule->remote_command[i] > -1) {
+            expected.code = schedule->remote_command[i];
+            this->_remote_sounds.push_back(expected);
+        }
+    }
+    // recording starts with the session and stops with its last step
+    expected.code = INVALID_CODE;
+    expected.planned_time = 0;
+    this->_recording.push_back(expected);
+    expected.planned_time = schedule->onset[schedule->size() - 1];
+    this->_recording.push_back(expected);
+}
+
+bool LoopbackBenchmark::waitForArrivals(double timeout) {
+    double deadline = this->_clock->now() + timeout;
+    while (this->_clock->now() < deadline) {
+        if ((this->_trigger_receiver->getCount() >= this->_triggers.size() + this->_recording.size())
+            && (this->_osc_receiver->getCount() >= this->_eye_tracker.size())
+            && (this->_remote_receiver->getCount() >= this->_remote_sounds.size())) {
+            return true;
+        }
+        ofSleepMillis(1);
+    }
+    return false;
+}
+
+int LoopbackBenchmark::match(LoopbackReceiver *receiver, const vector<Expected> &numbered, const vector<Expected> &control, vector<double> &latencies, vector<double> &tag_errors) {
+    // udp on loopback keeps the order, so the n-th number belongs to the n-th expected one
+    double start = this->_pattern->getSessionStart();
+    const vector<LoopbackReceiver::Arrival> &arrivals = receiver->getArrivals();
+    size_t count = receiver->getCount();
+    size_t n = 0, c = 0;
+    int mismatched = 0;
+    for (size_t i = 0; i < count; i++) {
+        const LoopbackReceiver::Arrival &arrival = arrivals[i];
+        if (arrival.code == 9999) {
+            // beeps ride along with other packets
+            continue;
+        }
+        // the recording commands are no numbers
+        const vector<Expected> &expected = (arrival.code != INVALID_CODE) ? numbered : control;
+        size_t &position = (arrival.code != INVALID_CODE) ? n : c;
+        if ((position < expected.size()) && (expected[position].code == arrival.code)) {
+            latencies.push_back(arrival.time - (start + expected[position].planned_time));
+            if (arrival.tag_time >= 0) {
+                tag_errors.push_back(arrival.tag_time - (start + expected[position].planned_time));
+            }
+        } else {
+            mismatched++;
+        }
+        position++;
+    }
+    if (n < numbered.size()) {
+        mismatched += numbered.size() - n;
+    }
+    if (c < control.size()) {
+        mismatched += control.size() - c;
+    }
+    return mismatched;
+}
+
+void LoopbackBenchmark::report(string name, vector<double> &latencies, int mismatched) {
+    if (latencies.size() == 0) {
+        ofLogNotice("LoopbackBenchmark") << name << ": no packets, " << mismatched << " missing or unexpected";
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    size_t size = latencies.size();
+    ofLogNotice("LoopbackBenchmark") << name << ": " << size << " packets, " << mismatched << " missing or unexpected, latency"
+        << " p50 " << latencies[size / 2] * 1000 << " ms"
+        << ", p99 " << latencies[std::min(size - 1, (size_t)(size * 0.99))] * 1000 << " ms"
+        << ", max " << latencies[size - 1] * 1000 << " ms";
+
+    // doubling bins from 50 us, the last one takes everything above 12.8 ms
+    const int number_of_bins = 10;
+    int bins[number_of_bins] = {0};
+    for (size_t i = 0; i < size; i++) {
+        int bin = 0;
+        for (double edge = 50e-6; (latencies[i] >= edge) && (bin < number_of_bins - 1); edge *= 2) {
+            bin++;
+        }
+        bins[bin]++;
+    }
+    double edge = 0;
+    for (int i = 0; i < number_of_bins; i++) {
+        string label = ofToString(edge * 1000) + " ms";
+        edge = (i == 0) ? 50e-6 : edge * 2;
+        if (i < number_of_bins - 1) {
+            label += " - " + ofToString(edge * 1000) + " ms";
+        } else {
+            label += " -";
+        }
+        ofLogNotice("LoopbackBenchmark") << "  " << label << ": " << bins[i] << " " << string((bins[i] * 40 + size - 1) / size, '#');
+    }
+}
@@ -0,0 +1,118 @@
+//
+//  loopbackBenchmark.h
+//  phd_calibration_eog
+//
+
+#ifndef loopbackBenchmark_h
+#define loopbackBenchmark_h
+
+#include "ofMain.h"
+#include "ofxNetwork.h"
+#include "ofxOsc.h"
+#include "ofx_udp_trigger.h"
+#include "calibrationPattern.h"
+#include "calibrationClock.h"
+#include "eventSinks.h"
+#include "remoteSound.h"
+
+/*
+ * Stand-in for one receiving host on the local machine. Timestamps every
+ * datagram on the session clock as soon as it arrives, into a buffer reserved
+ * up front.
+ */
+class LoopbackReceiver : public ofThread {
+public:
+    enum Format { ASCII, OSC, REMOTE_SOUND };
+    struct Arrival {
+        int code;   // decoded payload, -1 if it is not a number (e.g. recording control)
+        double time;
+        double tag_time; // osc bundle timetag on the session clock, -1 without
+    };
+
+    // epoch_unix_time converts osc timetags to the session clock
+    LoopbackReceiver(string name, int port, Format format, SteadyClock *clock, double epoch_unix_time = 0);
+    ~LoopbackReceiver();
+    bool open(size_t capacity);
+    void close();
+    void clear();
+    size_t getCount();
+    const vector<Arrival>& getArrivals();
+    string getName();
+
+private:
+    void threadedFunction();
+    int decode(const char *data, int size, double &tag_time);
+
+    string _name;
+    double _epoch_unix_time;
+    int _port;
+    Format _format;
+    SteadyClock *_clock;
+    ofxUDPManager _udp;
+    vector<Arrival> _arrivals;
+    std::atomic<size_t> _count;
+};
+
+/*
+ * Keeps cores busy for a share of every period: continuous spinning for cpu
+ * load, or a slice of every frame to stand in for a heavy render loop.
+ */
+class LoadThread : public ofThread {
+public:
+    LoadThread(double busy_duration, double period);
+    void stop();
+
+private:
+    void threadedFunction();
+
+    double _busy_duration, _period;
+    std::atomic<bool> _stop_requested;
+};
+
+/*
+ * Runs the pattern in realtime on the scheduler and I/O threads against local
+ * receivers for the trigger host, the eye tracker (osc, port 8000) and the
+ * remote sound receiver, and reports the latency from the planned onset to
+ * the arrival of each packet per sink.
+ */
+class LoopbackBenchmark {
+public:
+    struct Options {
+        string pattern_filename;
+        int sessions;
+        int trigger_port, remote_port;
+        int cpu_load_threads;
+        double render_load;  // busy milliseconds per 60 Hz frame
+    };
+
+    LoopbackBenchmark(Options options);
+    ~LoopbackBenchmark();
+    int run();
+
+private:
+    struct Expected {
+        int code;
+        double planned_time;
+    };
+
+    void expect();
+    bool waitForArrivals(double timeout);
+    int match(LoopbackReceiver *receiver, const vector<Expected> &numbered, const vector<Expected> &control, vector<double> &latencies, vector<double> &tag_errors);
+    void report(string name, vector<double> &latencies, int mismatched);
+
+    Options _options;
+    SteadyClock *_clock;
+    UdpTrigger *_trigger;
+    ofxOscSender *_osc;
+    ofxUDPManager _osc_events, _udp;
+    RemoteSoundChannel *_remote;
+    vector<ofSoundPlayer*> _no_commands;
+    NetworkSinks *_sinks;
+    CalibrationPattern *_pattern;
+    LoopbackReceiver *_trigger_receiver, *_osc_receiver, *_remote_receiver;
+
+    // what each receiver should get in one session, in order
+    vector<Expected> _triggers, _recording, _eye_tracker, _remote_sounds;
+};
+
+#endif /* loopbackBenchmark_h */
@@ -1,13 +1,156 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "headlessRunner.h"
+#include "loopbackBenchmark.h"
+#include "renderBenchmark.h"
+#include "sessionReplay.h"
 
 //========================================================================
-int main( ){
+int main(int argc, char *argv[]){
+	// headless modes run the state machine without a window:
+	//   --simulate [sessions]      run whole sessions and check them against the schedule
+	//   --benchmark [transitions]  measure transitions per second and allocations
+	//   --check-allocations [sessions]  fail if a session after the first allocates
+	//   --check-audio [sessions]   fail if a cue of the audio engine starts off its sample
+	//   --loopback [sessions]      measure trigger latency against local stand-in receivers
+	//     --cpu-load <threads>     with threads spinning on the cpu
+	//     --render-load <ms>       with a thread busy for this long every 60 Hz frame
+	//     --trigger-port <port>    port the trigger addon sends to (default 5000)
+	//     --remote-port <port>     port of the remote sound receiver (default 12345)
+	//   --replay <file.evtrace>    run a recorded session again and diff its outputs against the trace
+	//     --realtime               at real speed on the scheduler and I/O threads, also compares the lateness
+	//     --tolerance <ms>         the p99 lateness may grow this much in realtime (default 1)
+	//     --record <file.evtrace>  write the trace of the replay, e.g. as a new reference
+	//   --pattern <file.xml>       use another pattern than the one from the settings
+	// in a window:
+	//   --render-benchmark [markers]  frame time of the marker renderer from 1 to this many markers
+	//   --operator                 second window for the operator, mirrored from a shared fbo,
+	//                              also with --render-benchmark
+	// batch runs go through the participants in one process, also with --simulate:
+	//   --batch <participants>     codewords or pattern files, or a text file listing one per line
+	//   --interval <s>             start the next session this long after the last one ended,
+	//                              without it the next session waits for the spacebar
+	string mode = "", pattern = "";
+	uint64_t count = 0;
+	vector<string> batch;
+	float interval = -1;
+	bool with_operator = false;
+	SessionReplay::Options replay;
+	replay.realtime = false;
+	replay.tolerance = 0.001;
+	LoopbackBenchmark::Options loopback;
+	loopback.cpu_load_threads = 0;
+	loopback.render_load = 0;
+	loopback.trigger_port = 5000;
+	loopback.remote_port = 12345;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if ((arg == "--simulate") || (arg == "--benchmark") || (arg == "--check-allocations") || (arg == "--check-audio") || (arg == "--loopback") || (arg == "--render-benchmark")) {
+			mode = arg;
+			if ((i+1 < argc) && (argv[i+1][0] != '-')) {
+				count = ofToInt(argv[++i]);
+			}
+		} else if (arg == "--batch") {
+			while ((i+1 < argc) && (argv[i+1][0] != '-')) {
+				string participant = argv[++i];
+				if (ofFilePath::getFileExt(participant) == "txt") {
+					vector<string> lines = ofSplitString(ofBufferFromFile(participant).getText(), "\n", true, true);
+					batch.insert(batch.end(), lines.begin(), lines.end());
+				} else {
+					batch.push_back(participant);
+				}
+			}
+		} else if ((arg == "--replay") && (i+1 < argc)) {
+			mode = arg;
+			replay.trace_filename = argv[++i];
+		} else if (arg == "--realtime") {
+			replay.realtime = true;
+		} else if ((arg == "--tolerance") && (i+1 < argc)) {
+			replay.tolerance = ofToFloat(argv[++i]) / 1000.0;
+		} else if ((arg == "--record") && (i+1 < argc)) {
+			replay.record_filename = argv[++i];
+		} else if (arg == "--operator") {
+			with_operator = true;
+		} else if ((arg == "--interval") && (i+1 < argc)) {
+			interval = ofToFloat(argv[++i]);
+		} else if ((arg == "--pattern") && (i+1 < argc)) {
+			pattern = argv[++i];
+		} else if ((arg == "--cpu-load") && (i+1 < argc)) {
+			loopback.cpu_load_threads = ofToInt(argv[++i]);
+		} else if ((arg == "--render-load") && (i+1 < argc)) {
+			loopback.render_load = ofToFloat(argv[++i]);
+		} else if ((arg == "--trigger-port") && (i+1 < argc)) {
+			loopback.trigger_port = ofToInt(argv[++i]);
+		} else if ((arg == "--remote-port") && (i+1 < argc)) {
+			loopback.remote_port = ofToInt(argv[++i]);
+		}
+	}
+	if (mode == "--simulate") {
+		HeadlessRunner runner(pattern);
+		return runner.simulate((count > 0) ? count : 1, batch);
+	}
+	if (mode == "--benchmark") {
+		HeadlessRunner runner(pattern);
+		return runner.benchmark((count > 0) ? count : 1000000);
+	}
+	if (mode == "--check-allocations") {
+		HeadlessRunner runner(pattern);
+		return runner.checkAllocations((count > 0) ? count : 10);
+	}
+	if (mode == "--check-audio") {
+		HeadlessRunner runner(pattern);
+		return runner.checkAudio((count > 0) ? count : 1);
+	}
+	if (mode == "--replay") {
+		replay.pattern_filename = pattern;
+		SessionReplay session(replay);
+		return session.run();
+	}
+	if (mode == "--loopback") {
+		loopback.pattern_filename = pattern;
+		loopback.sessions = (count > 0) ? count : 1;
+		LoopbackBenchmark benchmark(loopback);
+		return benchmark.run();
+	}
+
+	if (with_operator == true) {
+		// the operator window shares the GL context, so the stimulus texture is drawn in both
+		ofGLFWWindowSettings settings;
+		settings.setGLVersion(2, 1);
+		settings.setSize(1024, 768);
+		settings.setPosition(ofVec2f(0, 0));
+		settings.windowMode = OF_WINDOW;
+		shared_ptr<ofAppBaseWindow> main_window = ofCreateWindow(settings);
+		settings.setSize(1024, 600);
+		settings.setPosition(ofVec2f(1024, 0));
+		settings.title = "operator";
+		settings.shareContextWith = main_window;
+		shared_ptr<ofAppBaseWindow> operator_window = ofCreateWindow(settings);
+
+		if (mode == "--render-benchmark") {
+			shared_ptr<RenderBenchmark> benchmark = make_shared<RenderBenchmark>((count > 0) ? count : 100000);
+			benchmark->setOperatorWindow(operator_window);
+			ofRunApp(main_window, benchmark);
+			return ofRunMainLoop();
+		}
+		shared_ptr<ofApp> app = make_shared<ofApp>();
+		app->setBatch(batch, interval);
+		app->setOperatorWindow(operator_window);
+		ofRunApp(main_window, app);
+		return ofRunMainLoop();
+	}
+
 	ofSetupOpenGL(1024,768,OF_WINDOW);			// <-------- setup the GL context
 
+	if (mode == "--render-benchmark") {
+		return ofRunApp(new RenderBenchmark((count > 0) ? count : 100000));
+	}
+
 	// this kicks off the running of my app
 	// can be OF_WINDOW or OF_FULLSCREEN
 	// pass in width and height too:
-	ofRunApp(new ofApp());
+	ofApp *app = new ofApp();
+	app->setBatch(batch, interval);
+	ofRunApp(app);
 
 }
@@ -0,0 +1,190 @@
+//
+//  markerRenderer.cpp
+//  phd_calibration_eog
+//
+
+#include "markerRenderer.h"
+
+// a unit quad per instance, moved and scaled to the marker
+static const char *vertex_shader = R"(
+#version 120
+attribute vec2 corner;
+attribute vec3 marker;
+attribute vec4 marker_color;
+varying vec2 v_corner;
+varying vec4 v_color;
+void main() {
+    v_corner = corner;
+    v_color = marker_color;
+    gl_Position = gl_ModelViewProjectionMatrix * vec4(marker.xy + corner * marker.z, 0.0, 1.0);
+}
+)";
+
+// cut the quad down to a circle with an antialiased edge
+static const char *fragment_shader = R"(
+#version 120
+varying vec2 v_corner;
+varying vec4 v_color;
+void main() {
+    float distance = length(v_corner);
+    float edge = fwidth(distance);
+    float alpha = 1.0 - smoothstep(1.0 - edge, 1.0, distance);
+    if (alpha <= 0.0) {
+        discard;
+    }
+    gl_FragColor = vec4(v_color.rgb, v_color.a * alpha);
+}
+)";
+
+MarkerRenderer::MarkerRenderer() {
+    this->_instanced = false;
+    this->_capacity = 0;
+    this->_dirty_first = 0;
+    this->_dirty_last = 0;
+    this->_uploaded = 0;
+}
+
+bool MarkerRenderer::setup(size_t capacity, bool allow_instancing) {
+    this->_markers.clear();
+    this->_dirty_first = 0;
+    this->_dirty_last = 0;
+    this->_instanced = allow_instancing && ofGLCheckExtension("GL_ARB_instanced_arrays") && ofGLCheckExtension("GL_ARB_draw_instanced");
+    if ((this->_instanced == true) && (this->_shader.isLoaded() == false)) {
+        this->_shader.setupShaderFromSource(GL_VERTEX_SHADER, vertex_shader);
+        this->_shader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragment_shader);
+        this->_shader.bindDefaults();
+        this->_instanced = this->_shader.linkProgram();
+    }
+    if ((this->_instanced == false) && (allow_instancing == true)) {
+        ofLogWarning("MarkerRenderer") << "no instanced arrays, drawing every marker on its own";
+    } else if (this->_instanced == true) {
+        float corners[] = { -1, -1, 1, -1, -1, 1, 1, 1 };
+        this->_vbo.setAttributeData(this->_shader.getAttributeLocation("corner"), corners, 2, 4, GL_STATIC_DRAW);
+    }
+    allocate(std::max(capacity, (size_t)1));
+    return this->_instanced;
+}
+
+void MarkerRenderer::allocate(size_t capacity) {
+    this->_capacity = capacity;
+    this->_markers.reserve(capacity);
+    if (this->_instanced == false) {
+        return;
+    }
+    int marker = this->_shader.getAttributeLocation("marker");
+    int color = this->_shader.getAttributeLocation("marker_color");
+    this->_instances.allocate(capacity * sizeof(MarkerInstance), GL_DYNAMIC_DRAW);
+    this->_vbo.setAttributeBuffer(marker, this->_instances, 3, sizeof(MarkerInstance), offsetof(MarkerInstance, x));
+    this->_vbo.setAttributeBuffer(color, this->_instances, 4, sizeof(MarkerInstance), offsetof(MarkerInstance, r));
+    this->_vbo.setAttributeDivisor(marker, 1);
+    this->_vbo.setAttributeDivisor(color, 1);
+    // a new buffer has none of the markers yet
+    if (this->_markers.empty() == false) {
+        markDirty(0);
+        markDirty(this->_markers.size() - 1);
+    }
+}
+
+size_t MarkerRenderer::add(ofVec2f position, float radius, ofColor color) {
+    if (this->_markers.size() >= this->_capacity) {
+        allocate(this->_capacity * 2);
+    }
+    MarkerInstance marker;
+    marker.x = position.x;
+    marker.y = position.y;
+    marker.radius = radius;
+    marker.r = color.r / 255.0f;
+    marker.g = color.g / 255.0f;
+    marker.b = color.b / 255.0f;
+    marker.a = color.a / 255.0f;
+    this->_markers.push_back(marker);
+    markDirty(this->_markers.size() - 1);
+    return this->_markers.size() - 1;
+}
+
+void MarkerRenderer::clear() {
+    this->_markers.clear();
+    this->_dirty_first = 0;
+    this->_dirty_last = 0;
+}
+
+size_t MarkerRenderer::size() {
+    return this->_markers.size();
+}
+
+void MarkerRenderer::setPosition(size_t marker, ofVec2f position) {
+    MarkerInstance &m = this->_markers[marker];
+    if ((m.x != position.x) || (m.y != position.y)) {
+        m.x = position.x;
+        m.y = position.y;
+        markDirty(marker);
+    }
+}
+
+void MarkerRenderer::setRadius(size_t marker, float radius) {
+    MarkerInstance &m = this->_markers[marker];
+    if (m.radius != radius) {
+        m.radius = radius;
+        markDirty(marker);
+    }
+}
+
+void MarkerRenderer::setColor(size_t marker, ofColor color) {
+    MarkerInstance &m = this->_markers[marker];
+    m.r = color.r / 255.0f;
+    m.g = color.g / 255.0f;
+    m.b = color.b / 255.0f;
+    m.a = color.a / 255.0f;
+    markDirty(marker);
+}
+
+ofVec2f MarkerRenderer::getPosition(size_t marker) {
+    return ofVec2f(this->_markers[marker].x, this->_markers[marker].y);
+}
+
+void MarkerRenderer::draw() {
+    if (this->_markers.empty() == true) {
+        return;
+    }
+    if (this->_instanced == false) {
+        for (size_t i = 0; i < this->_markers.size(); i++) {
+            const MarkerInstance &m = this->_markers[i];
+            ofSetColor(m.r * 255, m.g * 255, m.b * 255, m.a * 255);
+            ofDrawCircle(m.x, m.y, m.radius);
+        }
+        return;
+    }
+    upload();
+    this->_shader.begin();
+    this->_vbo.drawInstanced(GL_TRIANGLE_STRIP, 0, 4, this->_markers.size());
+    this->_shader.end();
+}
+
+bool MarkerRenderer::isInstanced() {
+    return this->_instanced;
+}
+
+uint64_t MarkerRenderer::getUploadedCount() {
+    return this->_uploaded;
+}
+
+void MarkerRenderer::markDirty(size_t marker) {
+    if (this->_dirty_first >= this->_dirty_last) {
+        this->_dirty_first = marker;
+        this->_dirty_last = marker + 1;
+        return;
+    }
+    this->_dirty_first = std::min(this->_dirty_first, marker);
+    this->_dirty_last = std::max(this->_dirty_last, marker + 1);
+}
+
+void MarkerRenderer::upload() {
+    if ((this->_instanced == false) || (this->_dirty_first >= this->_dirty_last)) {
+        return;
+    }
+    size_t count = this->_dirty_last - this->_dirty_first;
+    this->_instances.updateData(this->_dirty_first * sizeof(MarkerInstance), count * sizeof(MarkerInstance), &this->_markers[this->_dirty_first]);
+    this->_uploaded += count;
+    this->_dirty_first = 0;
+    this->_dirty_last = 0;
+}
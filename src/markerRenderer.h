@@ -0,0 +1,60 @@
+//
+//  markerRenderer.h
+//  phd_calibration_eog
+//
+
+#ifndef markerRenderer_h
+#define markerRenderer_h
+
+#include "ofMain.h"
+
+// one marker as it is stored on the GPU
+struct MarkerInstance {
+    float x, y, radius;     // pixels
+    float r, g, b, a;       // 0-1
+};
+
+/*
+ * Draws many round markers (distractors, visual search displays) in one
+ * instanced draw call. Position, radius and color of every marker live in one
+ * buffer object; changes are collected as a dirty range and only that range
+ * is uploaded before the next draw, so static markers cost nothing per frame.
+ * Without instanced arrays every marker is drawn as a circle of its own.
+ * All methods have to be called from the render thread.
+ */
+class MarkerRenderer {
+public:
+    MarkerRenderer();
+    // room for capacity markers to start with, false if it falls back to one draw call per marker
+    bool setup(size_t capacity, bool allow_instancing = true);
+    size_t add(ofVec2f position, float radius, ofColor color);
+    void clear();
+    size_t size();
+    void setPosition(size_t marker, ofVec2f position);
+    void setRadius(size_t marker, float radius);
+    void setColor(size_t marker, ofColor color);
+    ofVec2f getPosition(size_t marker);
+    void draw();
+
+    bool isInstanced();
+    // markers uploaded so far, each upload counts every marker in the dirty range
+    uint64_t getUploadedCount();
+
+private:
+    void allocate(size_t capacity);
+    void markDirty(size_t marker);
+    void upload();
+
+    bool _instanced;
+    size_t _capacity;
+    vector<MarkerInstance> _markers;
+    // dirty markers are [_dirty_first, _dirty_last), empty if first >= last
+    size_t _dirty_first, _dirty_last;
+    uint64_t _uploaded;
+
+    ofShader _shader;
+    ofVbo _vbo;
+    ofBufferObject _instances;
+};
+
+#endif /* markerRenderer_h */
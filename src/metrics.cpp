@@ -0,0 +1,196 @@
+//
+//  metrics.cpp
+//  phd_calibration_eog
+//
+
+#include "metrics.h"
+
+const double Metrics::_bucket_bounds[Metrics::_bucket_count - 1] = {
+    0.00001, 0.000025, 0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1
+};
+
+namespace {
+    const char *counter_names[METRIC_COUNTER_COUNT] = {
+        "trigger_sent", "osc_sent", "osc_failed", "udp_sent", "udp_failed",
+        "transitions", "frames", "missed_vsyncs", "audio_cues", "audio_dropped"
+    };
+    const char *histogram_names[METRIC_HISTOGRAM_COUNT] = {
+        "send_latency_seconds", "frame_time_seconds", "transition_drift_seconds", "audio_latency_seconds"
+    };
+
+    struct ClaimedShard {
+        const void *owner;
+        void *shard;
+    };
+    thread_local ClaimedShard claimed_shard = {NULL, NULL};
+}
+
+Metrics::Metrics() {
+    for (int i = 0; i <= _shard_count; i++) {
+        Shard &shard = this->_shards[i];
+        for (int c = 0; c < METRIC_COUNTER_COUNT; c++) {
+            shard.counters[c] = 0;
+        }
+        for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++) {
+            for (int b = 0; b < _bucket_count; b++) {
+                shard.buckets[h][b] = 0;
+            }
+            shard.sums[h] = 0;
+            shard.maxima[h] = 0;
+        }
+    }
+    this->_claimed = 0;
+}
+
+void* Metrics::operator new(std::size_t size) {
+    void *memory = NULL;
+    if (posix_memalign(&memory, alignof(Metrics), size) != 0) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void Metrics::operator delete(void *memory) {
+    free(memory);
+}
+
+Metrics::Shard* Metrics::getShard(bool &shared) {
+    if (claimed_shard.owner != this) {
+        int index = this->_claimed.fetch_add(1);
+        claimed_shard.owner = this;
+        claimed_shard.shard = &this->_shards[std::min(index, (int)_shard_count)];
+    }
+    Shard *shard = (Shard*)claimed_shard.shard;
+    shared = (shard == &this->_shards[_shard_count]);
+    return shard;
+}
+
+void Metrics::add(MetricCounter counter, uint64_t count) {
+    bool shared;
+    Shard *shard = getShard(shared);
+    std::atomic<uint64_t> &value = shard->counters[counter];
+    if (shared == true) {
+        value.fetch_add(count, std::memory_order_relaxed);
+    } else {
+        value.store(value.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+    }
+}
+
+void Metrics::observe(MetricHistogram histogram, double seconds) {
+    bool shared;
+    Shard *shard = getShard(shared);
+    int bucket = 0;
+    while ((bucket < _bucket_count - 1) && (seconds > _bucket_bounds[bucket])) {
+        bucket++;
+    }
+    int64_t nanoseconds = (int64_t)(seconds * 1e9);
+    std::atomic<uint64_t> &count = shard->buckets[histogram][bucket];
+    std::atomic<int64_t> &sum = shard->sums[histogram];
+    std::atomic<int64_t> &maximum = shard->maxima[histogram];
+    if (shared == true) {
+        count.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+        int64_t current = maximum.load(std::memory_order_relaxed);
+        while ((nanoseconds > current) && (maximum.compare_exchange_weak(current, nanoseconds, std::memory_order_relaxed) == false)) {
+        }
+    } else {
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum.store(sum.load(std::memory_order_relaxed) + nanoseconds, std::memory_order_relaxed);
+        if (nanoseconds > maximum.load(std::memory_order_relaxed)) {
+            maximum.store(nanoseconds, std::memory_order_relaxed);
+        }
+    }
+}
+
+string Metrics::format() {
+    int shards = std::min(this->_claimed.load(), (int)_shard_count);
+    std::ostringstream text;
+    for (int c = 0; c < METRIC_COUNTER_COUNT; c++) {
+        uint64_t total = this->_shards[_shard_count].counters[c].load(std::memory_order_relaxed);
+        for (int i = 0; i < shards; i++) {
+            total += this->_shards[i].counters[c].load(std::memory_order_relaxed);
+        }
+        text << "# TYPE eog_" << counter_names[c] << "_total counter\n";
+        text << "eog_" << counter_names[c] << "_total " << total << "\n";
+    }
+    for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++) {
+        uint64_t buckets[_bucket_count] = {0};
+        int64_t sum = 0, maximum = 0;
+        for (int i = 0; i <= _shard_count; i++) {
+            if ((i >= shards) && (i < _shard_count)) {
+                continue;
+            }
+            for (int b = 0; b < _bucket_count; b++) {
+                buckets[b] += this->_shards[i].buckets[h][b].load(std::memory_order_relaxed);
+            }
+            sum += this->_shards[i].sums[h].load(std::memory_order_relaxed);
+            maximum = std::max(maximum, this->_shards[i].maxima[h].load(std::memory_order_relaxed));
+        }
+        string name = string("eog_") + histogram_names[h];
+        text << "# TYPE " << name << " histogram\n";
+        uint64_t cumulative = 0;
+        for (int b = 0; b < _bucket_count; b++) {
+            cumulative += buckets[b];
+            text << name << "_bucket{le=\"";
+            if (b < _bucket_count - 1) {
+                text << _bucket_bounds[b];
+            } else {
+                text << "+Inf";
+            }
+            text << "\"} " << cumulative << "\n";
+        }
+        text << name << "_sum " << sum * 1e-9 << "\n";
+        text << name << "_count " << cumulative << "\n";
+        text << "# TYPE " << name << "_max gauge\n";
+        text << name << "_max " << maximum * 1e-9 << "\n";
+    }
+    return text.str();
+}
+
+MetricsEndpoint::MetricsEndpoint(Metrics *metrics, int port) {
+    this->_metrics = metrics;
+    this->_port = port;
+    this->_requests = 0;
+}
+
+MetricsEndpoint::~MetricsEndpoint() {
+    waitForThread(true);
+    this->_udp.Close();
+}
+
+bool MetricsEndpoint::open() {
+    if ((this->_udp.Create() == false) || (this->_udp.Bind(this->_port) == false)) {
+        ofLogError("MetricsEndpoint") << "could not bind port " << this->_port;
+        return false;
+    }
+    // wakes up every second to see if it has to stop
+    this->_udp.SetTimeoutReceive(1);
+    startThread();
+    ofLogNotice("MetricsEndpoint") << "serving metrics on udp port " << this->_port;
+    return true;
+}
+
+uint64_t MetricsEndpoint::getRequestCount() {
+    return this->_requests;
+}
+
+void MetricsEndpoint::threadedFunction() {
+    char request[256];
+    while (isThreadRunning() == true) {
+        if (this->_udp.Receive(request, sizeof(request)) < 0) {
+            continue;
+        }
+        string host;
+        int port = 0;
+        if ((this->_udp.GetRemoteAddr(host, port) == false) || (port <= 0)) {
+            continue;
+        }
+        string text = this->_metrics->format();
+        ofxUDPManager reply;
+        if ((reply.Create() == true) && (reply.Connect(host.c_str(), port) == true)) {
+            reply.Send(text.c_str(), (int)text.size());
+        }
+        reply.Close();
+        this->_requests++;
+    }
+}
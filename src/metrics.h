@@ -0,0 +1,89 @@
+//
+//  metrics.h
+//  phd_calibration_eog
+//
+
+#ifndef metrics_h
+#define metrics_h
+
+#include "ofMain.h"
+#include "ofxNetwork.h"
+
+enum MetricCounter {
+    METRIC_TRIGGER_SENT,
+    METRIC_OSC_SENT,            // eye tracker event bundles
+    METRIC_OSC_FAILED,
+    METRIC_UDP_SENT,            // remote sound commands and beeps
+    METRIC_UDP_FAILED,
+    METRIC_TRANSITIONS,
+    METRIC_FRAMES,
+    METRIC_MISSED_VSYNCS,
+    METRIC_AUDIO_CUES,
+    METRIC_AUDIO_DROPPED,
+    METRIC_COUNTER_COUNT
+};
+
+enum MetricHistogram {
+    METRIC_SEND_LATENCY,        // queued by the state machine until all sends of the event returned
+    METRIC_FRAME_TIME,
+    METRIC_TRANSITION_DRIFT,    // a transition ran this long after its planned time
+    METRIC_AUDIO_LATENCY,       // first sample of a cue out minus its planned time
+    METRIC_HISTOGRAM_COUNT
+};
+
+/*
+ * Counters and histograms (seconds) of the running process. Every thread
+ * that updates a metric gets a shard of its own the first time it does, so an
+ * update is a relaxed load and store into memory only that thread writes:
+ * no locks, no shared cache lines, no allocation. Threads beyond the shards
+ * share one more, updated with atomic adds. A snapshot sums up the shards.
+ */
+class Metrics {
+public:
+    Metrics();
+    // the shards are aligned to cache lines, which plain new does not guarantee before c++17
+    static void* operator new(std::size_t size);
+    static void operator delete(void *memory);
+    void add(MetricCounter counter, uint64_t count = 1);
+    void observe(MetricHistogram histogram, double seconds);
+    // prometheus text format, off the hot path
+    string format();
+
+private:
+    static const int _bucket_count = 14;
+    static const double _bucket_bounds[_bucket_count - 1];
+    static const int _shard_count = 16;
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> counters[METRIC_COUNTER_COUNT];
+        std::atomic<uint64_t> buckets[METRIC_HISTOGRAM_COUNT][_bucket_count];
+        std::atomic<int64_t> sums[METRIC_HISTOGRAM_COUNT];     // nanoseconds
+        std::atomic<int64_t> maxima[METRIC_HISTOGRAM_COUNT];   // nanoseconds
+    };
+
+    Shard* getShard(bool &shared);
+
+    Shard _shards[_shard_count + 1];
+    std::atomic<int> _claimed;
+};
+
+/*
+ * Answers every datagram on its port with the current metrics, for a
+ * dashboard on the operator machine to poll (see bin/data/metrics_poll.py).
+ */
+class MetricsEndpoint : public ofThread {
+public:
+    MetricsEndpoint(Metrics *metrics, int port);
+    ~MetricsEndpoint();
+    bool open();
+    uint64_t getRequestCount();
+
+private:
+    void threadedFunction();
+
+    Metrics *_metrics;
+    int _port;
+    ofxUDPManager _udp;
+    std::atomic<uint64_t> _requests;
+};
+
+#endif /* metrics_h */
@@ -3,29 +3,153 @@
 //--------------------------------------------------------------
 void ofApp::setup(){
     pattern = new CalibrationPattern();
+    was_running = false;
+    next_start = -1;
+    batch_position = 0;
+    show_hud = false;
+    if (operator_window != NULL) {
+        stimulus.allocate(ofGetWidth(), ofGetHeight(), GL_RGB);
+    }
+}
+
+//--------------------------------------------------------------
+void ofApp::setBatch(vector<string> participants, float interval){
+    // before setup
+    batch = participants;
+    batch_interval = interval;
+}
+
+//--------------------------------------------------------------
+void ofApp::setOperatorWindow(shared_ptr<ofAppBaseWindow> window){
+    operator_window = window;
+    // its swap must never wait for a refresh of its own, the participant display paces the loop
+    operator_window->setVerticalSync(false);
+    ofAddListener(operator_window->events().draw, this, &ofApp::drawOperator);
+    ofAddListener(operator_window->events().keyPressed, this, &ofApp::keyPressedOperator);
 }
 
 //--------------------------------------------------------------
 void ofApp::update(){
+    // the frame timer shows up once the marker is set up
+    FrameTimer *frames = pattern->getFrameTimer();
+    if (frames != NULL) {
+        frames->beginUpdate();
+    }
     pattern->update();
+    if (pattern->isReady() == true) {
+        updateBatch();
+    }
+    if (frames != NULL) {
+        frames->endUpdate();
+    }
+}
+
+//--------------------------------------------------------------
+void ofApp::updateBatch(){
+    if ((batch.empty() == false) && (batch_position == 0)) {
+        nextParticipant();
+    }
+    bool running = pattern->isRunning();
+    if ((was_running == true) && (running == false) && (batch.empty() == false)) {
+        // the session ended or was stopped, the next participant is set up right away
+        pattern->stopRecordingEyeTracker();
+        ofShowCursor();
+        nextParticipant();
+    }
+    was_running = running;
+    if ((next_start >= 0) && (ofGetElapsedTimef() >= next_start)) {
+        next_start = -1;
+        startSession();
+    }
+}
+
+//--------------------------------------------------------------
+void ofApp::startSession(){
+    ofHideCursor();
+    pattern->recordEyeTracker();
+    pattern->startCalibration();
+}
+
+//--------------------------------------------------------------
+void ofApp::stopSession(){
+    pattern->stopCalibration();
+    pattern->stopRecordingEyeTracker();
+    ofShowCursor();
+}
+
+//--------------------------------------------------------------
+void ofApp::nextParticipant(){
+    // participants whose pattern cannot be loaded are skipped
+    while (batch_position < batch.size()) {
+        string participant = batch[batch_position++];
+        if (pattern->loadParticipant(participant) == true) {
+            ofLogNotice("ofApp") << "participant " << batch_position << " of " << batch.size() << ": " << pattern->getCodeword();
+            if (batch_interval >= 0) {
+                next_start = ofGetElapsedTimef() + batch_interval;
+            }
+            return;
+        }
+        ofLogError("ofApp") << "skipping " << participant;
+    }
+    ofLogNotice("ofApp") << "batch of " << batch.size() << " participants done";
+    batch.clear();
 }
 
 //--------------------------------------------------------------
 void ofApp::draw(){
-    pattern->draw();
+    FrameTimer *frames = pattern->getFrameTimer();
+    if (frames != NULL) {
+        frames->beginDraw();
+    }
+    if (operator_window == NULL) {
+        pattern->draw();
+        if (show_hud == true) {
+            pattern->drawHud(20, 20);
+        }
+    } else {
+        stimulus.begin();
+        pattern->draw();
+        stimulus.end();
+        ofSetColor(255);
+        stimulus.draw(0, 0);
+    }
+    if (frames != NULL) {
+        frames->endDraw();
+    }
+}
+
+//--------------------------------------------------------------
+void ofApp::drawOperator(ofEventArgs &/*args*/){
+    // the texture of this frame's stimulus, scaled into the left of the operator window
+    ofClear(ofColor(40));
+    float scale = std::min(ofGetWidth() * 0.6f / stimulus.getWidth(), (ofGetHeight() - 20.0f) / stimulus.getHeight());
+    ofSetColor(255);
+    stimulus.draw(10, 10, stimulus.getWidth() * scale, stimulus.getHeight() * scale);
+    float x = stimulus.getWidth() * scale + 20;
+    pattern->drawStatus(x, 20);
+    if (show_hud == true) {
+        pattern->drawHud(x, 160);
+    }
+}
+
+//--------------------------------------------------------------
+void ofApp::keyPressedOperator(ofKeyEventArgs &args){
+    keyPressed(args.key);
 }
 
 //--------------------------------------------------------------
 void ofApp::keyPressed(int key){
+    if (pattern->isReady() == false) {
+        ofLogWarning("ofApp") << "still starting up, ignoring key " << key;
+        return;
+    }
+    pattern->traceKey(key);
     if (key == 32) { // spacebar
+        next_start = -1;
         if (pattern->isRunning() == false) {
-            ofHideCursor();
-            pattern->recordEyeTracker();
-            pattern->startCalibration();
+            startSession();
         } else {
-            pattern->stopCalibration();
-            pattern->stopRecordingEyeTracker();
-            ofShowCursor();
+            stopSession();
         }
     }
 
@@ -44,22 +168,28 @@ void ofApp::keyPressed(int key){
     if (key == 'c') { // calibrate
         pattern->calibrateEyeTracker();
     }
+    if (key == 'h') { // frame timing overlay for the operator, in the operator window if there is one
+        show_hud = !show_hud;
+    }
     if (key == 'q') { // end
         pattern->stopRecordingEyeTracker();
     }
 }
 
 //--------------------------------------------------------------
-void ofApp::keyReleased(int key){
+void ofApp::keyReleased(int /*key*/){
 
 }
 
 //--------------------------------------------------------------
 void ofApp::windowResized(int w, int h){
     pattern->resizePattern(w, h);
+    if (operator_window != NULL) {
+        stimulus.allocate(w, h, GL_RGB);
+    }
 }
 
 //--------------------------------------------------------------
-void ofApp::gotMessage(ofMessage msg){
+void ofApp::gotMessage(ofMessage /*msg*/){
 
 }
@@ -14,6 +14,29 @@ class ofApp : public ofBaseApp{
 		void keyReleased(int key);
 		void windowResized(int w, int h);
 		void gotMessage(ofMessage msg);
+
+		// participants to run one after another, interval < 0 waits for the spacebar
+		void setBatch(vector<string> participants, float interval);
+		// second window for the operator, sharing the GL context of the participant window; before setup
+		void setOperatorWindow(shared_ptr<ofAppBaseWindow> window);
+		void drawOperator(ofEventArgs &args);
+		void keyPressedOperator(ofKeyEventArgs &args);
 		
 		CalibrationPattern *pattern;
+
+	private:
+		void startSession();
+		void stopSession();
+		void nextParticipant();
+		void updateBatch();
+
+		vector<string> batch;
+		size_t batch_position;
+		float batch_interval, next_start;
+		bool was_running;
+		bool show_hud;
+
+		// with an operator window the stimulus is rendered once into the fbo and shown in both
+		shared_ptr<ofAppBaseWindow> operator_window;
+		ofFbo stimulus;
 };
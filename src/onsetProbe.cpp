@@ -0,0 +1,146 @@
+//
+//  onsetProbe.cpp
+//  phd_calibration_eog
+//
+
+#include "onsetProbe.h"
+
+OnsetProbe::OnsetProbe(CalibrationClock *clock, SessionLog *log) {
+    this->_clock = clock;
+    this->_log = log;
+    this->_use_timer_queries = ofGLCheckExtension("GL_ARB_timer_query");
+    this->_next_slot = 0;
+    this->_gpu_to_steady_offset = 0;
+    for (int i = 0; i < this->_max_pending; i++) {
+        this->_pending[i].stage = IDLE;
+        this->_pending[i].query = 0;
+        if (this->_use_timer_queries == true) {
+            glGenQueries(1, &this->_pending[i].query);
+        }
+    }
+    // keep room for a long session so measuring never allocates
+    this->_latencies.reserve(4096);
+    if (this->_use_timer_queries == false) {
+        ofLogWarning("OnsetProbe") << "no GL timer queries, falling back to glFinish after the swap";
+    }
+}
+
+OnsetProbe::~OnsetProbe() {
+    if (this->_use_timer_queries == true) {
+        for (int i = 0; i < this->_max_pending; i++) {
+            glDeleteQueries(1, &this->_pending[i].query);
+        }
+    }
+}
+
+void OnsetProbe::markerChanged(double planned_time, int target, int order_position) {
+    Measurement &measurement = this->_pending[this->_next_slot];
+    if (measurement.stage != IDLE) {
+        ofLogWarning("OnsetProbe") << "too many pending onsets, dropping one";
+    }
+    measurement.stage = CHANGED;
+    measurement.planned_time = planned_time;
+    measurement.target = target;
+    measurement.order_position = order_position;
+    this->_next_slot = (this->_next_slot + 1) % this->_max_pending;
+}
+
+void OnsetProbe::drawn() {
+    for (int i = 0; i < this->_max_pending; i++) {
+        Measurement &measurement = this->_pending[i];
+        if (measurement.stage == CHANGED) {
+            measurement.stage = DRAWN;
+        }
+    }
+}
+
+void OnsetProbe::swapped() {
+    // called at the start of the next frame, i.e. after the previous frame was swapped
+    for (int i = 0; i < this->_max_pending; i++) {
+        Measurement &measurement = this->_pending[i];
+        if (measurement.stage != DRAWN) {
+            continue;
+        }
+        if (this->_use_timer_queries == true) {
+            glQueryCounter(measurement.query, GL_TIMESTAMP);
+            // pair the current gpu time with the steady clock to convert query results
+            GLint64 gpu_time = 0;
+            glGetInteger64v(GL_TIMESTAMP, &gpu_time);
+            this->_gpu_to_steady_offset = this->_clock->now() - gpu_time * 1e-9;
+            measurement.stage = SWAPPED;
+        } else {
+            glFinish();
+            complete(measurement, this->_clock->now());
+        }
+    }
+    if (this->_use_timer_queries == false) {
+        return;
+    }
+    for (int i = 0; i < this->_max_pending; i++) {
+        Measurement &measurement = this->_pending[i];
+        if (measurement.stage != SWAPPED) {
+            continue;
+        }
+        GLint available = 0;
+        glGetQueryObjectiv(measurement.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available != 0) {
+            GLuint64 gpu_time = 0;
+            glGetQueryObjectui64v(measurement.query, GL_QUERY_RESULT, &gpu_time);
+            complete(measurement, gpu_time * 1e-9 + this->_gpu_to_steady_offset);
+        }
+    }
+}
+
+void OnsetProbe::complete(Measurement &measurement, double onset_time) {
+    measurement.stage = IDLE;
+    double latency = onset_time - measurement.planned_time;
+    if (this->_latencies.size() < this->_latencies.capacity()) {
+        this->_latencies.push_back(latency);
+    }
+    if (this->_log != NULL) {
+        SessionLogRecord record;
+        record.type = LOG_ONSET;
+        record.state = 0;
+        record.target = measurement.target;
+        record.order_position = measurement.order_position;
+        record.reserved = 0;
+        record.planned_time = measurement.planned_time;
+        record.steady_time = onset_time;
+        record.trigger_done = -1;
+        record.osc_done = -1;
+        record.udp_done = -1;
+        record.value = latency;
+        this->_log->append(record);
+    }
+}
+
+void OnsetProbe::report() {
+    if (this->_latencies.empty() == true) {
+        return;
+    }
+    vector<double> sorted = this->_latencies;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0;
+    for (size_t i = 0; i < sorted.size(); i++) {
+        sum += sorted[i];
+    }
+    double mean = sum / sorted.size();
+    double variance = 0;
+    for (size_t i = 0; i < sorted.size(); i++) {
+        variance += (sorted[i] - mean) * (sorted[i] - mean);
+    }
+    double sd = sqrt(variance / sorted.size());
+    ofLogNotice("OnsetProbe") << "onset latency over " << sorted.size() << " onsets [ms]:"
+        << " min " << sorted.front() * 1000
+        << ", median " << sorted[sorted.size() / 2] * 1000
+        << ", p95 " << sorted[(sorted.size() * 95) / 100] * 1000
+        << ", max " << sorted.back() * 1000
+        << ", mean " << mean * 1000 << " +- " << sd * 1000;
+}
+
+void OnsetProbe::reset() {
+    this->_latencies.clear();
+    for (int i = 0; i < this->_max_pending; i++) {
+        this->_pending[i].stage = IDLE;
+    }
+}
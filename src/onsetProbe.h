@@ -0,0 +1,53 @@
+//
+//  onsetProbe.h
+//  phd_calibration_eog
+//
+
+#ifndef onsetProbe_h
+#define onsetProbe_h
+
+#include "ofMain.h"
+#include "sessionLog.h"
+#include "calibrationClock.h"
+
+/*
+ * Estimates when the first frame showing a new marker position reached the
+ * display. A GL timestamp query is issued after the swap of the frame that
+ * drew the marker; its result is converted to the steady clock and taken as
+ * the presentation time. Results are read back without
+ * stalling in later frames. Without timer queries the probe falls back to
+ * glFinish() after the swap, which blocks the render thread.
+ * All methods have to be called from the render thread.
+ */
+class OnsetProbe {
+public:
+    OnsetProbe(CalibrationClock *clock, SessionLog *log);
+    ~OnsetProbe();
+    void markerChanged(double planned_time, int target, int order_position);
+    void drawn();
+    void swapped();
+    void report();
+    void reset();
+
+private:
+    enum Stage { IDLE, CHANGED, DRAWN, SWAPPED };
+    struct Measurement {
+        Stage stage;
+        double planned_time;
+        int target, order_position;
+        GLuint query;
+    };
+
+    void complete(Measurement &measurement, double onset_time);
+
+    CalibrationClock *_clock;
+    SessionLog *_log;
+    bool _use_timer_queries;
+    static const int _max_pending = 8;
+    Measurement _pending[_max_pending];
+    int _next_slot;
+    double _gpu_to_steady_offset;
+    vector<double> _latencies;
+};
+
+#endif /* onsetProbe_h */
@@ -0,0 +1,309 @@
+//
+//  outboundEvents.cpp
+//  phd_calibration_eog
+//
+
+#include "outboundEvents.h"
+
+OutboundEventSender::OutboundEventSender(CalibrationClock *clock, EventSinks *sinks, bool threaded) {
+    this->_clock = clock;
+    this->_sinks = sinks;
+    this->_threaded = threaded;
+    this->_log = NULL;
+    this->_clock_syncs[PEER_TRIGGER_HOST] = NULL;
+    this->_clock_syncs[PEER_EYE_TRACKER] = NULL;
+    this->_logged_generation[PEER_TRIGGER_HOST] = 0;
+    this->_logged_generation[PEER_EYE_TRACKER] = 0;
+    this->_audio = NULL;
+    this->_trace = NULL;
+    this->_metrics = NULL;
+    this->_consumer_sleeping = false;
+    this->_flush_waiters = 0;
+    resetStats();
+    if (this->_threaded == true) {
+        startThread();
+    }
+}
+
+OutboundEventSender::~OutboundEventSender() {
+    stopThread();
+    this->_wakeup.notify_all();
+    waitForThread(false);
+}
+
+double OutboundEventSender::now() {
+    return this->_clock->now();
+}
+
+bool OutboundEventSender::push(const OutboundEvent &event) {
+    if (this->_queue.push(event) == false) {
+        this->_dropped_count++;
+        return false;
+    }
+    this->_pushed_count++;
+    size_t depth = this->_queue.size();
+    if (depth > this->_max_depth) {
+        this->_max_depth = depth;
+    }
+    if (this->_threaded == false) {
+        drain();
+        return true;
+    }
+    // only wake the I/O thread when it actually went to sleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (this->_consumer_sleeping == true) {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->_wakeup.notify_one();
+    }
+    return true;
+}
+
+void OutboundEventSender::drain() {
+    OutboundEvent event;
+    while (this->_queue.pop(event) == true) {
+        send(event);
+    }
+}
+
+void OutboundEventSender::flush() {
+    // wait until everything queued so far went out
+    std::unique_lock<std::mutex> lock(this->_flush_mutex);
+    this->_flush_waiters++;
+    this->_flushed.wait(lock, [this]() { return this->_sent_count >= this->_pushed_count; });
+    this->_flush_waiters--;
+}
+
+void OutboundEventSender::setLog(SessionLog *log) {
+    // only call while the queue is flushed, the I/O thread reads this without locking
+    flush();
+    this->_log = log;
+    // a new log starts with the current estimates
+    this->_logged_generation[PEER_TRIGGER_HOST] = 0;
+    this->_logged_generation[PEER_EYE_TRACKER] = 0;
+}
+
+void OutboundEventSender::setClockSyncs(ClockSync *trigger_host, ClockSync *eye_tracker) {
+    flush();
+    this->_clock_syncs[PEER_TRIGGER_HOST] = trigger_host;
+    this->_clock_syncs[PEER_EYE_TRACKER] = eye_tracker;
+}
+
+void OutboundEventSender::setAudioEngine(AudioEngine *audio) {
+    flush();
+    this->_audio = audio;
+}
+
+void OutboundEventSender::setTrace(SessionTrace *trace) {
+    flush();
+    this->_trace = trace;
+}
+
+void OutboundEventSender::setMetrics(Metrics *metrics) {
+    this->_metrics = metrics;
+}
+
+void OutboundEventSender::resetStats() {
+    // sent and pushed are equal after a flush, the I/O thread does not touch them until the next push
+    this->_pushed_count = 0;
+    this->_sent_count = 0;
+    this->_dropped_count = 0;
+    this->_latency_sum = 0;
+    this->_latency_max = 0;
+    this->_max_depth = 0;
+}
+
+void OutboundEventSender::sendControl(ofxOscMessage &msg) {
+    this->_sinks->sendControl(msg);
+}
+
+size_t OutboundEventSender::getDepth() {
+    return this->_queue.size();
+}
+
+size_t OutboundEventSender::getMaxDepth() {
+    return this->_max_depth;
+}
+
+uint64_t OutboundEventSender::getSentCount() {
+    return this->_sent_count;
+}
+
+uint64_t OutboundEventSender::getDroppedCount() {
+    return this->_dropped_count;
+}
+
+double OutboundEventSender::getMeanSendLatency() {
+    uint64_t count = this->_sent_count;
+    if (count == 0) {
+        return 0;
+    }
+    return (this->_latency_sum / (double)count) * 1e-6;
+}
+
+double OutboundEventSender::getMaxSendLatency() {
+    return this->_latency_max * 1e-6;
+}
+
+void OutboundEventSender::threadedFunction() {
+    OutboundEvent event;
+    while (isThreadRunning()) {
+        if (this->_queue.pop(event) == true) {
+            send(event);
+            continue;
+        }
+        // announce the sleep before the last look at the queue, push() checks the flag after queueing
+        this->_consumer_sleeping = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (this->_queue.empty() == true) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->_wakeup.wait_for(lock, std::chrono::milliseconds(1));
+        }
+        this->_consumer_sleeping = false;
+    }
+    // flush what is left, e.g. the stop recording command
+    drain();
+}
+
+void OutboundEventSender::send(const OutboundEvent &event) {
+    SessionLogRecord record;
+    record.state = event.state;
+    record.target = event.target;
+    record.order_position = event.order_position;
+    record.reserved = 0;
+    record.planned_time = event.planned_time;
+    record.steady_time = event.queued_time;
+    record.trigger_done = -1;
+    record.osc_done = -1;
+    record.udp_done = -1;
+    record.value = (event.trigger != NO_TRIGGER) ? event.trigger : -1;
+
+    this->_sinks->beginBatch(event.planned_time);
+    if (event.remote_beep == true) {
+        this->_sinks->sendRemoteSound(9999);
+        record.udp_done = now();
+        trace(TRACE_REMOTE_SOUND, event, 9999);
+    }
+    switch (event.type) {
+        case EVENT_START_RECORDING:
+            this->_sinks->startRecording();
+            record.type = LOG_START_RECORDING;
+            record.trigger_done = now();
+            trace(TRACE_START_RECORDING, event, -1);
+            break;
+        case EVENT_STOP_RECORDING:
+            this->_sinks->stopRecording();
+            record.type = LOG_STOP_RECORDING;
+            record.trigger_done = now();
+            trace(TRACE_STOP_RECORDING, event, -1);
+            break;
+        default:
+            record.type = LOG_TRANSITION;
+            break;
+    }
+    if (event.trigger != NO_TRIGGER) {
+        this->_sinks->sendTrigger(event.trigger);
+        record.trigger_done = now();
+        trace(TRACE_TRIGGER, event, event.trigger);
+        this->_sinks->sendEyeTrackerEvent(event.trigger);
+    }
+    if (event.remote_command > -1) {
+        this->_sinks->sendRemoteSound(event.remote_command);
+        record.udp_done = now();
+        trace(TRACE_REMOTE_SOUND, event, event.remote_command);
+    }
+    // the eye tracker event leaves with the bundle
+    this->_sinks->endBatch();
+    if (event.trigger != NO_TRIGGER) {
+        record.osc_done = now();
+        trace(TRACE_EYE_TRACKER, event, event.trigger);
+    }
+    if (event.local_command > -1) {
+        this->_sinks->playCommand(event.local_command);
+        trace(TRACE_COMMAND, event, event.local_command);
+    }
+    if (this->_log != NULL) {
+        logClockSyncs();
+        this->_log->append(record);
+    }
+    logAudioCues();
+
+    double seconds = std::max(0.0, now() - event.queued_time);
+    if (this->_metrics != NULL) {
+        this->_metrics->observe(METRIC_SEND_LATENCY, seconds);
+    }
+    uint64_t latency = (uint64_t)(seconds * 1e6);
+    this->_latency_sum += latency;
+    if (latency > this->_latency_max) {
+        this->_latency_max = latency;
+    }
+    this->_sent_count++;
+    // only between sessions, the I/O thread takes no lock while one runs
+    if (this->_flush_waiters > 0) {
+        std::lock_guard<std::mutex> lock(this->_flush_mutex);
+        this->_flushed.notify_all();
+    }
+}
+
+void OutboundEventSender::logClockSyncs() {
+    // every estimate a session used ends up in its log, so events can be mapped to the peer's clock afterwards
+    for (int16_t peer = PEER_TRIGGER_HOST; peer <= PEER_EYE_TRACKER; peer++) {
+        ClockSync *sync = this->_clock_syncs[peer];
+        if ((sync == NULL) || (sync->getGeneration() == this->_logged_generation[peer])) {
+            continue;
+        }
+        this->_logged_generation[peer] = sync->getGeneration();
+        ClockEstimate estimate = sync->getEstimate();
+        SessionLogRecord record;
+        memset(&record, 0, sizeof(record));
+        record.type = LOG_CLOCK_SYNC;
+        record.target = peer;
+        record.order_position = -1;
+        record.planned_time = estimate.reference_time;
+        record.steady_time = now();
+        record.value = estimate.offset;
+        record.trigger_done = estimate.drift;
+        record.osc_done = estimate.uncertainty;
+        record.udp_done = estimate.delay;
+        this->_log->append(record);
+    }
+}
+
+void OutboundEventSender::logAudioCues() {
+    // cues are reported once their block is rendered, ahead of their time; taken off the engine even without a log
+    if (this->_audio == NULL) {
+        return;
+    }
+    AudioCueReport report;
+    while (this->_audio->popReport(report) == true) {
+        if (this->_metrics != NULL) {
+            if (report.output_time >= 0) {
+                this->_metrics->add(METRIC_AUDIO_CUES);
+                this->_metrics->observe(METRIC_AUDIO_LATENCY, report.output_time - report.planned_time);
+            } else {
+                this->_metrics->add(METRIC_AUDIO_DROPPED);
+            }
+        }
+        if (this->_log == NULL) {
+            continue;
+        }
+        SessionLogRecord record;
+        memset(&record, 0, sizeof(record));
+        record.type = LOG_AUDIO;
+        record.target = report.clip;
+        record.order_position = -1;
+        record.reserved = report.tag;
+        record.planned_time = report.planned_time;
+        record.steady_time = report.output_time;
+        record.trigger_done = -1;
+        record.osc_done = -1;
+        record.udp_done = -1;
+        record.value = (report.output_time >= 0) ? report.output_time - report.planned_time : -1;
+        this->_log->append(record);
+    }
+}
+
+void OutboundEventSender::trace(SessionTraceRecordType type, const OutboundEvent &event, int code) {
+    if (this->_trace != NULL) {
+        this->_trace->record(type, event.step, code, now(), event.planned_time);
+    }
+}
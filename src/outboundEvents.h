@@ -0,0 +1,108 @@
+//
+//  outboundEvents.h
+//  phd_calibration_eog
+//
+
+#ifndef outboundEvents_h
+#define outboundEvents_h
+
+#include "ofMain.h"
+#include "ofxOsc.h"
+#include "spscQueue.h"
+#include "audioEngine.h"
+#include "sessionLog.h"
+#include "sessionTrace.h"
+#include "calibrationClock.h"
+#include "eventSinks.h"
+#include "clockSync.h"
+#include "metrics.h"
+
+enum OutboundEventType : uint8_t {
+    EVENT_TRANSITION,
+    EVENT_START_RECORDING,
+    EVENT_STOP_RECORDING
+};
+
+// the event sends no trigger; -1 is a code of its own, the pauses before a target send it without a reference item
+static const int16_t NO_TRIGGER = INT16_MIN;
+
+struct OutboundEvent {
+    OutboundEventType type;
+    uint8_t state;          // CalibrationStates after the transition
+    int16_t target;         // target index shown by the transition, -1 for none
+    int16_t order_position; // position in the target order, -1 for none
+    int16_t step;           // step of the schedule, -1 for none
+    int16_t trigger;        // sent to the trigger host and the eye tracker, NO_TRIGGER for none
+    int16_t remote_command; // sent to the remote sound receiver, -1 for none
+    int16_t local_command;  // sound id of the verbal command to play here, -1 for none
+    bool remote_beep;       // send a beep (9999) to the remote sound receiver first
+    double planned_time, queued_time;
+};
+
+/*
+ * Sends the events of the state machine to the trigger host, the eye tracker
+ * (osc) and the remote sound receiver from a dedicated I/O thread, so the
+ * thread running the transitions never waits for a socket.
+ * Events are queued through a single-producer ring buffer: only one thread may
+ * call push() at a time (the scheduler while a session runs, the main thread
+ * before it starts and after it was stopped).
+ * Without a thread (headless runs) push() drains the queue right away.
+ */
+class OutboundEventSender : public ofThread {
+public:
+    OutboundEventSender(CalibrationClock *clock, EventSinks *sinks, bool threaded);
+    ~OutboundEventSender();
+    double now();
+    bool push(const OutboundEvent &event);
+    void drain();
+    void flush();
+    // the counters below start over, only after flush() with nothing queued
+    void resetStats();
+    void setLog(SessionLog *log);
+    // new estimates of these are logged along with the events, set before the first session
+    void setClockSyncs(ClockSync *trigger_host, ClockSync *eye_tracker);
+    // the output times of its cues are logged along with the events, set before the first session
+    void setAudioEngine(AudioEngine *audio);
+    // every send is traced as it returns, set between sessions
+    void setTrace(SessionTrace *trace);
+    // send and audio cue latencies go into these, set before the first session
+    void setMetrics(Metrics *metrics);
+    void sendControl(ofxOscMessage &msg);
+
+    size_t getDepth();
+    size_t getMaxDepth();
+    uint64_t getSentCount();
+    uint64_t getDroppedCount();
+    double getMeanSendLatency();
+    double getMaxSendLatency();
+
+private:
+    void threadedFunction();
+    void send(const OutboundEvent &event);
+    void logClockSyncs();
+    void logAudioCues();
+    void trace(SessionTraceRecordType type, const OutboundEvent &event, int code);
+
+    CalibrationClock *_clock;
+    bool _threaded;
+    SpscQueue<OutboundEvent, 256> _queue;
+    std::condition_variable _wakeup;
+    std::atomic<bool> _consumer_sleeping;
+    // flush() sleeps on this until the I/O thread sent everything
+    std::mutex _flush_mutex;
+    std::condition_variable _flushed;
+    std::atomic<int> _flush_waiters;
+
+    EventSinks *_sinks;
+    SessionLog *_log;
+    ClockSync *_clock_syncs[2];
+    uint32_t _logged_generation[2];
+    AudioEngine *_audio;
+    SessionTrace *_trace;
+    Metrics *_metrics;
+
+    // latency from queueing an event until all of its sends returned, in microseconds
+    std::atomic<uint64_t> _pushed_count, _sent_count, _dropped_count, _latency_sum, _latency_max, _max_depth;
+};
+
+#endif /* outboundEvents_h */
@@ -0,0 +1,496 @@
+//
+//  patternSchedule.cpp
+//  phd_calibration_eog
+//
+
+#include "patternSchedule.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const uint32_t SCHEDULE_VERSION = 2;
+
+static uint64_t hashBytes(const char *data, size_t length, uint64_t hash = 14695981039346656037ULL) {
+    // FNV-1a
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint64_t alignOffset(uint64_t offset) {
+    return (offset + 7) & ~((uint64_t)7);
+}
+
+template <typename T>
+static uint64_t appendArray(vector<char> &image, const vector<T> &values) {
+    uint64_t offset = alignOffset(image.size());
+    image.resize(offset + values.size() * sizeof(T));
+    if (values.empty() == false) {
+        memcpy(&image[offset], &values[0], values.size() * sizeof(T));
+    }
+    return offset;
+}
+
+// samples the <pursuit> block the xml is pointing at, returns the segment duration
+static double sampleTrajectory(ofxXmlSettings &xml, vector<float> &u, vector<float> &v) {
+    string type = xml.getValue("type", "line");
+    double duration = xml.getValue("duration", 2.0);
+    float x = xml.getValue("x", 0.5);
+    float y = xml.getValue("y", 0.5);
+    float to_x = xml.getValue("to_x", 0.5);
+    float to_y = xml.getValue("to_y", 0.5);
+    float radius_x = xml.getValue("radius_x", 0.5);
+    float radius_y = xml.getValue("radius_y", 0.5);
+    float frequency_x = xml.getValue("frequency_x", 1.0);
+    float frequency_y = xml.getValue("frequency_y", 1.0);
+    float phase = xml.getValue("phase", 0.0);
+    if (duration <= 0) {
+        duration = 1.0 / PURSUIT_SAMPLE_RATE;
+    }
+    size_t samples = (size_t)ceil(duration * PURSUIT_SAMPLE_RATE) + 1;
+    for (size_t i = 0; i < samples; i++) {
+        // fraction of the segment, the frequencies count cycles per segment
+        double t = std::min(1.0, i / (duration * PURSUIT_SAMPLE_RATE));
+        double su, sv;
+        if (type == "circle") {
+            // clockwise from the top, like the polar layout
+            su = x + radius_x * sin(TWO_PI * frequency_x * t + phase);
+            sv = y - radius_y * cos(TWO_PI * frequency_x * t + phase);
+        } else if (type == "lissajous") {
+            su = x + radius_x * sin(TWO_PI * frequency_x * t + phase);
+            sv = y + radius_y * sin(TWO_PI * frequency_y * t);
+        } else {
+            su = x + (to_x - x) * t;
+            sv = y + (to_y - y) * t;
+        }
+        u.push_back(ofClamp(su, 0, 1));
+        v.push_back(ofClamp(sv, 0, 1));
+    }
+    if ((type != "circle") && (type != "lissajous") && (type != "line")) {
+        ofLogWarning("PatternSchedule") << "unknown pursuit type " << type << ", using a line";
+    }
+    return duration;
+}
+
+PatternSchedule::PatternSchedule() {
+    this->_header = NULL;
+    this->_mapping = NULL;
+    this->_mapped_size = 0;
+    this->onset = NULL;
+    this->state = NULL;
+    this->flags = NULL;
+    this->target = NULL;
+    this->order_position = NULL;
+    this->trigger = NULL;
+    this->sound = NULL;
+    this->remote_command = NULL;
+    this->segment_first = NULL;
+    this->segment_length = NULL;
+    this->trajectory_u = NULL;
+    this->trajectory_v = NULL;
+}
+
+PatternSchedule::~PatternSchedule() {
+    unload();
+}
+
+bool PatternSchedule::load(string pattern_filename, const ScheduleSettings &settings) {
+    unload();
+    ofBuffer xml = ofBufferFromFile(pattern_filename, true);
+    if (xml.size() == 0) {
+        ofLogError("PatternSchedule") << "could not read " << pattern_filename;
+        return false;
+    }
+    uint64_t xml_hash = hashBytes(xml.getData(), xml.size());
+    uint64_t settings_hash = hashBytes((const char*)&settings.time_per_target, sizeof(double));
+    settings_hash = hashBytes((const char*)&settings.pause_duration, sizeof(double), settings_hash);
+    char switches[2] = {(char)settings.use_beeps, (char)settings.use_remote_sound};
+    settings_hash = hashBytes(switches, sizeof(switches), settings_hash);
+
+    string schedule_filename = pattern_filename;
+    size_t extension = schedule_filename.rfind(".xml");
+    if (extension != string::npos) {
+        schedule_filename = schedule_filename.substr(0, extension);
+    }
+    schedule_filename += ".sched";
+
+    if (map(schedule_filename, xml_hash, settings_hash) == true) {
+        ofLogNotice("PatternSchedule") << "using compiled " << schedule_filename << " (" << size() << " steps)";
+        return true;
+    }
+    vector<char> image;
+    if (compile(pattern_filename, settings, xml_hash, settings_hash, image) == false) {
+        return false;
+    }
+    ofstream file(ofToDataPath(schedule_filename, true).c_str(), ios::binary | ios::trunc);
+    file.write(&image[0], image.size());
+    file.close();
+    if ((file.fail() == false) && (map(schedule_filename, xml_hash, settings_hash) == true)) {
+        ofLogNotice("PatternSchedule") << "compiled " << pattern_filename << " into " << schedule_filename << " (" << size() << " steps)";
+        return true;
+    }
+    // keep the compiled timeline in memory if it could not be cached
+    ofLogWarning("PatternSchedule") << "could not cache " << schedule_filename;
+    this->_image.swap(image);
+    assign(&this->_image[0]);
+    return true;
+}
+
+void PatternSchedule::unload() {
+    if (this->_mapping != NULL) {
+        munmap(this->_mapping, this->_mapped_size);
+        this->_mapping = NULL;
+        this->_mapped_size = 0;
+    }
+    this->_image.clear();
+    this->_sound_files.clear();
+    this->_header = NULL;
+}
+
+size_t PatternSchedule::size() {
+    if (this->_header == NULL) {
+        return 0;
+    }
+    return this->_header->step_count;
+}
+
+int PatternSchedule::getNumberOfItems() {
+    if (this->_header == NULL) {
+        return 0;
+    }
+    return this->_header->number_of_items;
+}
+
+int PatternSchedule::getReference() {
+    if (this->_header == NULL) {
+        return -1;
+    }
+    return this->_header->reference;
+}
+
+const vector<string>& PatternSchedule::getSoundFiles() {
+    return this->_sound_files;
+}
+
+size_t PatternSchedule::getSegmentCount() {
+    if (this->_header == NULL) {
+        return 0;
+    }
+    return this->_header->segment_count;
+}
+
+ofVec2f PatternSchedule::getTrajectoryPoint(int segment, double time) {
+    if ((segment < 0) || (segment >= (int)getSegmentCount())) {
+        return ofVec2f(0.5f, 0.5f);
+    }
+    uint32_t first = this->segment_first[segment];
+    uint32_t last = first + this->segment_length[segment] - 1;
+    double position = std::max(0.0, time * PURSUIT_SAMPLE_RATE);
+    uint32_t index = first + (uint32_t)std::min(position, (double)(last - first));
+    if (index >= last) {
+        return ofVec2f(this->trajectory_u[last], this->trajectory_v[last]);
+    }
+    float fraction = position - (index - first);
+    return ofVec2f(this->trajectory_u[index] + (this->trajectory_u[index+1] - this->trajectory_u[index]) * fraction,
+                   this->trajectory_v[index] + (this->trajectory_v[index+1] - this->trajectory_v[index]) * fraction);
+}
+
+bool PatternSchedule::map(string schedule_filename, uint64_t xml_hash, uint64_t settings_hash) {
+    string path = ofToDataPath(schedule_filename, true);
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if ((fstat(fd, &info) != 0) || (info.st_size < (off_t)sizeof(ScheduleFileHeader))) {
+        ::close(fd);
+        return false;
+    }
+    void *mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    const ScheduleFileHeader *header = (const ScheduleFileHeader*)mapping;
+    uint64_t size = info.st_size;
+    uint64_t steps = header->step_count;
+    bool valid = (memcmp(header->magic, "EOGSCH01", 8) == 0)
+        && (header->version == SCHEDULE_VERSION)
+        && (header->xml_hash == xml_hash)
+        && (header->settings_hash == settings_hash)
+        && (header->onset_offset + steps * sizeof(double) <= size)
+        && (header->state_offset + steps <= size)
+        && (header->flags_offset + steps <= size)
+        && (header->target_offset + steps * sizeof(int16_t) <= size)
+        && (header->order_offset + steps * sizeof(int16_t) <= size)
+        && (header->trigger_offset + steps * sizeof(int16_t) <= size)
+        && (header->sound_offset + steps * sizeof(int16_t) <= size)
+        && (header->remote_offset + steps * sizeof(int16_t) <= size)
+        && (header->sound_table_offset <= size)
+        && (header->segment_first_offset + header->segment_count * sizeof(uint32_t) <= size)
+        && (header->segment_length_offset + header->segment_count * sizeof(uint32_t) <= size)
+        && (header->trajectory_u_offset + header->sample_count * sizeof(float) <= size)
+        && (header->trajectory_v_offset + header->sample_count * sizeof(float) <= size);
+    if (valid == false) {
+        munmap(mapping, info.st_size);
+        return false;
+    }
+    this->_mapping = (char*)mapping;
+    this->_mapped_size = info.st_size;
+    assign(this->_mapping);
+
+    // sound table: length prefixed file names
+    uint64_t offset = header->sound_table_offset;
+    for (uint32_t i = 0; i < header->sound_count; i++) {
+        uint16_t length = 0;
+        if (offset + sizeof(uint16_t) > size) {
+            break;
+        }
+        memcpy(&length, this->_mapping + offset, sizeof(uint16_t));
+        offset += sizeof(uint16_t);
+        if (offset + length > size) {
+            break;
+        }
+        this->_sound_files.push_back(string(this->_mapping + offset, length));
+        offset += length;
+    }
+    if ((this->_sound_files.size() != header->sound_count) || (checkTables() == false)) {
+        unload();
+        return false;
+    }
+    return true;
+}
+
+bool PatternSchedule::checkTables() {
+    // a cache that passed the hashes can still be truncated or corrupt, nothing may index past its tables
+    const ScheduleFileHeader *header = this->_header;
+    for (uint32_t i = 0; i < header->segment_count; i++) {
+        if ((this->segment_length[i] == 0) || ((uint64_t)this->segment_first[i] + this->segment_length[i] > header->sample_count)) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->step_count; i++) {
+        if (((this->flags[i] & STEP_PURSUIT) != 0) && ((this->target[i] < 0) || (this->target[i] >= (int)header->segment_count))) {
+            return false;
+        }
+        if ((this->sound[i] < -1) || (this->sound[i] >= (int)header->sound_count)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void PatternSchedule::assign(const char *base) {
+    this->_header = (const ScheduleFileHeader*)base;
+    this->onset = (const double*)(base + this->_header->onset_offset);
+    this->state = (const uint8_t*)(base + this->_header->state_offset);
+    this->flags = (const uint8_t*)(base + this->_header->flags_offset);
+    this->target = (const int16_t*)(base + this->_header->target_offset);
+    this->order_position = (const int16_t*)(base + this->_header->order_offset);
+    this->trigger = (const int16_t*)(base + this->_header->trigger_offset);
+    this->sound = (const int16_t*)(base + this->_header->sound_offset);
+    this->remote_command = (const int16_t*)(base + this->_header->remote_offset);
+    this->segment_first = (const uint32_t*)(base + this->_header->segment_first_offset);
+    this->segment_length = (const uint32_t*)(base + this->_header->segment_length_offset);
+    this->trajectory_u = (const float*)(base + this->_header->trajectory_u_offset);
+    this->trajectory_v = (const float*)(base + this->_header->trajectory_v_offset);
+    if (this->_image.empty() == false) {
+        // in-memory image, rebuild the sound table from the compiler output
+        uint64_t offset = this->_header->sound_table_offset;
+        this->_sound_files.clear();
+        for (uint32_t i = 0; i < this->_header->sound_count; i++) {
+            uint16_t length = 0;
+            memcpy(&length, base + offset, sizeof(uint16_t));
+            offset += sizeof(uint16_t);
+            this->_sound_files.push_back(string(base + offset, length));
+            offset += length;
+        }
+    }
+}
+
+bool PatternSchedule::compile(string pattern_filename, const ScheduleSettings &settings, uint64_t xml_hash, uint64_t settings_hash, vector<char> &image) {
+    ofxXmlSettings xml;
+    if (xml.loadFile(pattern_filename) == false) {
+        ofLogError("PatternSchedule") << "could not parse " << pattern_filename;
+        return false;
+    }
+    bool use_commands;
+    int reference, number_of_items;
+    vector<int16_t> item_target, item_sound, item_segment;
+    vector<string> sound_files;
+    // pursuit items: one trajectory segment each
+    vector<uint32_t> segment_first, segment_length;
+    vector<double> segment_duration, segment_interval;
+    vector<float> trajectory_u, trajectory_v;
+    std::map<string, int16_t> sound_ids;
+    xml.pushTag("order");
+    {
+        use_commands = xml.getValue("verbal_commands", 0);
+        reference = xml.getValue("reference", -1);
+        number_of_items = xml.getValue("size", 0);
+        for (int i = 0; i < number_of_items; i++) {
+            xml.pushTag("item", i);
+            {
+                int16_t segment = -1;
+                if (xml.tagExists("pursuit") == true) {
+                    segment = segment_first.size();
+                    xml.pushTag("pursuit");
+                    segment_first.push_back(trajectory_u.size());
+                    segment_duration.push_back(sampleTrajectory(xml, trajectory_u, trajectory_v));
+                    segment_length.push_back(trajectory_u.size() - segment_first.back());
+                    segment_interval.push_back(xml.getValue("trigger_interval", 0.0));
+                    xml.popTag();
+                }
+                item_segment.push_back(segment);
+                item_target.push_back((segment > -1) ? segment : xml.getValue("n", 0));
+                string filename = xml.getValue("command", "");
+                int16_t id = -1;
+                if (filename != "") {
+                    std::map<string, int16_t>::iterator it = sound_ids.find(filename);
+                    if (it == sound_ids.end()) {
+                        id = sound_files.size();
+                        sound_ids[filename] = id;
+                        sound_files.push_back(filename);
+                    } else {
+                        id = it->second;
+                    }
+                }
+                item_sound.push_back(id);
+            }
+            xml.popTag();
+        }
+    }
+    xml.popTag();
+    bool use_reference = (reference > -1) && (reference < number_of_items);
+    if ((reference > -1) && (use_reference == false)) {
+        ofLogWarning("PatternSchedule") << "reference item " << reference << " does not exist";
+    }
+    if ((use_reference == true) && (item_segment[reference] > -1)) {
+        ofLogWarning("PatternSchedule") << "reference item " << reference << " is a pursuit, not returning to it";
+        use_reference = false;
+    }
+
+    // run the state machine once, every transition becomes a step
+    vector<double> onsets;
+    vector<uint8_t> states, step_flags;
+    vector<int16_t> targets, positions, triggers, sounds, remotes;
+    CalibrationStates current_state = REFERENCE;
+    int current = -1;
+    double time = 0;
+    auto emit = [&](uint8_t flags, int16_t target, int16_t position, int16_t trigger, int command) {
+        onsets.push_back(time);
+        states.push_back(current_state);
+        step_flags.push_back(flags);
+        targets.push_back(target);
+        positions.push_back(position);
+        triggers.push_back(trigger);
+        bool has_command = use_commands && (command > -1) && (command < number_of_items);
+        sounds.push_back((has_command && !settings.use_remote_sound) ? item_sound[command] : -1);
+        remotes.push_back((has_command && settings.use_remote_sound) ? command : -1);
+    };
+    auto pause = [&](bool beep) {
+        uint8_t flags = beep ? STEP_REMOTE_BEEP : 0;
+        if (((current_state == TARGET) || (current_state == PURSUIT)) && use_reference) {
+            current_state = PAUSE2REFERENCE;
+            emit(flags, -1, current, current, reference);
+        } else {
+            current_state = PAUSE2TARGET;
+            emit(flags, -1, current, reference, ((current+1) < number_of_items) ? current+1 : -1);
+        }
+    };
+    auto nextTarget = [&]() {
+        current_state = TARGET;
+        current++;
+        uint8_t flags = settings.use_remote_sound ? STEP_REMOTE_BEEP : 0;
+        int16_t target = -1;
+        if (current < number_of_items) {
+            flags |= STEP_MARKER | STEP_BLINKY_ON;
+            target = item_target[current];
+            if (item_segment[current] > -1) {
+                current_state = PURSUIT;
+                flags |= STEP_PURSUIT;
+            }
+        } else {
+            // stop pattern after last target
+            flags |= STEP_FINISH;
+        }
+        emit(flags, target, current, current, -1);
+    };
+    auto backToReference = [&]() {
+        current_state = REFERENCE;
+        uint8_t flags = STEP_MARKER | STEP_BLINKY_ON | (settings.use_remote_sound ? STEP_REMOTE_BEEP : 0);
+        emit(flags, item_target[reference], reference, reference, -1);
+    };
+
+    pause(false);
+    time += settings.pause_duration;
+    while (true) {
+        if ((current_state == PAUSE2REFERENCE) && use_reference) {
+            backToReference();
+        } else {
+            nextTarget();
+        }
+        if (current >= number_of_items) {
+            break;
+        }
+        if (current_state == PURSUIT) {
+            // sample triggers while the marker moves, the segment ends with the pause
+            int segment = item_segment[current];
+            double start = time;
+            double interval = segment_interval[segment];
+            int samples = 0;
+            if (interval > 0) {
+                for (double offset = interval; offset < segment_duration[segment] - 1e-9; offset += interval) {
+                    time = start + offset;
+                    emit(0, -1, current, PURSUIT_SAMPLE_TRIGGER + samples, -1);
+                    samples++;
+                }
+            }
+            time = start + segment_duration[segment];
+        } else {
+            time += settings.time_per_target;
+        }
+        pause(settings.use_remote_sound && settings.use_beeps);
+        time += settings.pause_duration;
+    }
+
+    ScheduleFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "EOGSCH01", 8);
+    header.version = SCHEDULE_VERSION;
+    header.step_count = onsets.size();
+    header.xml_hash = xml_hash;
+    header.settings_hash = settings_hash;
+    header.number_of_items = number_of_items;
+    header.reference = use_reference ? reference : -1;
+    header.use_commands = use_commands;
+    header.sound_count = sound_files.size();
+    header.segment_count = segment_first.size();
+    header.sample_count = trajectory_u.size();
+
+    image.assign(sizeof(ScheduleFileHeader), 0);
+    header.onset_offset = appendArray(image, onsets);
+    header.state_offset = appendArray(image, states);
+    header.flags_offset = appendArray(image, step_flags);
+    header.target_offset = appendArray(image, targets);
+    header.order_offset = appendArray(image, positions);
+    header.trigger_offset = appendArray(image, triggers);
+    header.sound_offset = appendArray(image, sounds);
+    header.remote_offset = appendArray(image, remotes);
+    header.segment_first_offset = appendArray(image, segment_first);
+    header.segment_length_offset = appendArray(image, segment_length);
+    header.trajectory_u_offset = appendArray(image, trajectory_u);
+    header.trajectory_v_offset = appendArray(image, trajectory_v);
+    header.sound_table_offset = alignOffset(image.size());
+    image.resize(header.sound_table_offset);
+    for (size_t i = 0; i < sound_files.size(); i++) {
+        uint16_t length = sound_files[i].size();
+        image.insert(image.end(), (const char*)&length, (const char*)&length + sizeof(uint16_t));
+        image.insert(image.end(), sound_files[i].begin(), sound_files[i].end());
+    }
+    memcpy(&image[0], &header, sizeof(header));
+    return true;
+}
@@ -0,0 +1,111 @@
+//
+//  patternSchedule.h
+//  phd_calibration_eog
+//
+
+#ifndef patternSchedule_h
+#define patternSchedule_h
+
+#include "ofMain.h"
+#include "ofxXmlSettings.h"
+
+enum CalibrationStates {
+    OFF,
+    TARGET,
+    PAUSE2REFERENCE,
+    REFERENCE,
+    PAUSE2TARGET,
+    PURSUIT
+};
+
+enum ScheduleStepFlags : uint8_t {
+    STEP_MARKER      = 1 << 0, // move the marker to the target of the step
+    STEP_BLINKY_ON   = 1 << 1, // marker blinks after the step
+    STEP_REMOTE_BEEP = 1 << 2, // send a beep to the remote sound receiver
+    STEP_FINISH      = 1 << 3, // last step, the pattern stops afterwards
+    STEP_PURSUIT     = 1 << 4  // the marker follows the trajectory of segment <target>
+};
+
+// trajectories are sampled at this rate when the pattern is compiled
+static const double PURSUIT_SAMPLE_RATE = 1000.0;
+// triggers sent while following a trajectory count up from here
+static const int16_t PURSUIT_SAMPLE_TRIGGER = 1000;
+
+// settings from calibrationSettings.xml that shape the timeline
+struct ScheduleSettings {
+    double time_per_target, pause_duration;
+    bool use_beeps, use_remote_sound;
+};
+
+struct ScheduleFileHeader {
+    char magic[8];          // "EOGSCH01"
+    uint32_t version;
+    uint32_t step_count;
+    uint64_t xml_hash, settings_hash;
+    int32_t number_of_items, reference, use_commands;
+    uint32_t sound_count;
+    uint64_t onset_offset, state_offset, flags_offset, target_offset, order_offset;
+    uint64_t trigger_offset, sound_offset, remote_offset, sound_table_offset;
+    uint32_t segment_count, sample_count;
+    uint64_t segment_first_offset, segment_length_offset, trajectory_u_offset, trajectory_v_offset;
+};
+
+/*
+ * A calibration pattern compiled into a flat timeline. Every transition of the
+ * state machine is one step; the steps are stored as a struct of arrays (onset
+ * relative to the start, state afterwards, target to show, trigger code, sound
+ * id, remote sound command and flags), so running a session is just advancing
+ * a cursor.
+ * Smooth pursuit items are sampled into a trajectory table (normalized
+ * positions at PURSUIT_SAMPLE_RATE, one segment per item), so following the
+ * marker is one interpolated read per frame.
+ * The compiled timeline is cached as <pattern>.sched next to the pattern xml
+ * and memory-mapped; it is only rebuilt when the xml or the timing settings
+ * changed.
+ */
+class PatternSchedule {
+public:
+    PatternSchedule();
+    ~PatternSchedule();
+    bool load(string pattern_filename, const ScheduleSettings &settings);
+    void unload();
+
+    size_t size();
+    int getNumberOfItems();
+    int getReference();
+    const vector<string>& getSoundFiles();
+    size_t getSegmentCount();
+    // normalized marker position <time> seconds into a segment, holds the last sample afterwards
+    ofVec2f getTrajectoryPoint(int segment, double time);
+
+    // timeline arrays, valid while loaded
+    const double *onset;
+    const uint8_t *state;
+    const uint8_t *flags;
+    const int16_t *target;
+    const int16_t *order_position;
+    const int16_t *trigger;
+    const int16_t *sound;
+    const int16_t *remote_command;
+
+    // trajectory table, the samples of segment i start at segment_first[i]
+    const uint32_t *segment_first;
+    const uint32_t *segment_length;
+    const float *trajectory_u;
+    const float *trajectory_v;
+
+private:
+    bool compile(string pattern_filename, const ScheduleSettings &settings, uint64_t xml_hash, uint64_t settings_hash, vector<char> &image);
+    bool map(string schedule_filename, uint64_t xml_hash, uint64_t settings_hash);
+    // segments within the trajectory table, pursuit steps on a segment, sounds in the sound table
+    bool checkTables();
+    void assign(const char *base);
+
+    const ScheduleFileHeader *_header;
+    vector<string> _sound_files;
+    vector<char> _image;
+    char *_mapping;
+    size_t _mapped_size;
+};
+
+#endif /* patternSchedule_h */
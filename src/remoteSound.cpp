@@ -0,0 +1,131 @@
+//
+//  remoteSound.cpp
+//  phd_calibration_eog
+//
+
+#include "remoteSound.h"
+
+RemoteSoundChannel::RemoteSoundChannel(CalibrationClock *clock, ofxUDPManager *udp, bool acks) {
+    this->_clock = clock;
+    this->_udp = udp;
+    this->_epoch_unix_time = clock->getEpochUnixTime();
+    this->_acks = acks;
+    startSession();
+    if (this->_acks == true) {
+        // wake up once a second to check if the thread should stop
+        this->_udp->SetTimeoutReceive(1);
+        startThread();
+    }
+}
+
+RemoteSoundChannel::~RemoteSoundChannel() {
+    waitForThread(true);
+}
+
+bool RemoteSoundChannel::send(int command, double planned_time) {
+    RemoteSoundMessage message;
+    memcpy(message.magic, "EOGR", 4);
+    message.version = 1;
+    message.flags = this->_acks ? REMOTE_ACK_REQUESTED : 0;
+    message.reserved = 0;
+    message.sequence = this->_sequence.fetch_add(1, std::memory_order_relaxed);
+    message.command = command;
+    message.play_time = planned_time + this->_epoch_unix_time;
+    double now = this->_clock->now();
+    message.send_time = now + this->_epoch_unix_time;
+    if (this->_acks == true) {
+        double previous = this->_pending_time[message.sequence % _window].exchange(now);
+        if (previous >= 0) {
+            this->_overwritten_count++;
+        }
+    }
+    return (this->_udp->Send((const char*)&message, sizeof(message)) == sizeof(message));
+}
+
+void RemoteSoundChannel::startSession() {
+    // only while nothing is sent
+    this->_sequence = 0;
+    for (uint32_t i = 0; i < _window; i++) {
+        this->_pending_time[i] = -1;
+    }
+    this->_acked_count = 0;
+    this->_overwritten_count = 0;
+    this->_rtt_sum = 0;
+    this->_rtt_max = 0;
+}
+
+void RemoteSoundChannel::report() {
+    if (this->_acks == false) {
+        ofLogNotice("RemoteSoundChannel") << "sent " << getSentCount() << " commands without acks";
+        return;
+    }
+    ofLogNotice("RemoteSoundChannel") << "sent " << getSentCount() << " commands, acked " << getAckedCount()
+        << ", lost " << getLostCount() << ", in flight " << getInFlightCount()
+        << ", mean rtt " << getMeanRoundTrip() * 1000 << " ms, max rtt " << getMaxRoundTrip() * 1000 << " ms";
+}
+
+uint64_t RemoteSoundChannel::getSentCount() {
+    return this->_sequence;
+}
+
+uint64_t RemoteSoundChannel::getAckedCount() {
+    return this->_acked_count;
+}
+
+uint64_t RemoteSoundChannel::getLostCount() {
+    uint64_t lost = this->_overwritten_count;
+    double now = this->_clock->now();
+    for (uint32_t i = 0; i < _window; i++) {
+        double time = this->_pending_time[i];
+        if ((time >= 0) && (now - time > this->_ack_timeout)) {
+            lost++;
+        }
+    }
+    return lost;
+}
+
+uint64_t RemoteSoundChannel::getInFlightCount() {
+    uint64_t in_flight = 0;
+    double now = this->_clock->now();
+    for (uint32_t i = 0; i < _window; i++) {
+        double time = this->_pending_time[i];
+        if ((time >= 0) && (now - time <= this->_ack_timeout)) {
+            in_flight++;
+        }
+    }
+    return in_flight;
+}
+
+double RemoteSoundChannel::getMeanRoundTrip() {
+    uint64_t count = this->_acked_count;
+    if (count == 0) {
+        return 0;
+    }
+    return this->_rtt_sum / (double)count / 1e6;
+}
+
+double RemoteSoundChannel::getMaxRoundTrip() {
+    return this->_rtt_max / 1e6;
+}
+
+void RemoteSoundChannel::threadedFunction() {
+    RemoteSoundMessage message;
+    while (isThreadRunning() == true) {
+        int size = this->_udp->Receive((char*)&message, sizeof(message));
+        double now = this->_clock->now();
+        if ((size != sizeof(message)) || (memcmp(message.magic, "EOGR", 4) != 0) || ((message.flags & REMOTE_ACK) == 0)) {
+            continue;
+        }
+        // duplicates and acks of overwritten messages find no pending entry
+        double sent = this->_pending_time[message.sequence % _window].exchange(-1);
+        if (sent < 0) {
+            continue;
+        }
+        uint64_t rtt = (uint64_t)(std::max(0.0, now - (message.send_time - this->_epoch_unix_time)) * 1e6);
+        this->_rtt_sum += rtt;
+        if (rtt > this->_rtt_max) {
+            this->_rtt_max = rtt;
+        }
+        this->_acked_count++;
+    }
+}
@@ -0,0 +1,72 @@
+//
+//  remoteSound.h
+//  phd_calibration_eog
+//
+
+#ifndef remoteSound_h
+#define remoteSound_h
+
+#include "ofMain.h"
+#include "ofxNetwork.h"
+#include "calibrationClock.h"
+
+enum RemoteSoundFlags : uint8_t {
+    REMOTE_ACK_REQUESTED = 1 << 0, // the receiver should echo the message
+    REMOTE_ACK           = 1 << 1  // this is the echo
+};
+
+// one datagram, little endian; bin/data/remote_sound_receiver.py is the reference receiver
+struct RemoteSoundMessage {
+    char magic[4];       // "EOGR"
+    uint8_t version;     // 1
+    uint8_t flags;       // RemoteSoundFlags
+    uint16_t reserved;
+    uint32_t sequence;   // counts up from 0 every session
+    int32_t command;     // item index, 9999 for a beep
+    double play_time;    // planned onset, unix time in seconds
+    double send_time;    // unix time when the message left, echoed in the ack
+};
+static_assert(sizeof(RemoteSoundMessage) == 32, "remote sound messages are 32 bytes");
+
+/*
+ * Sends commands to the remote sound receiver. With acks enabled a thread
+ * reads the echoes from the same socket and measures round-trip time and loss
+ * per session. send() is called from the I/O thread only.
+ */
+class RemoteSoundChannel : public ofThread {
+public:
+    RemoteSoundChannel(CalibrationClock *clock, ofxUDPManager *udp, bool acks);
+    ~RemoteSoundChannel();
+    // false if the datagram could not be sent
+    bool send(int command, double planned_time);
+    void startSession();
+    void report();
+
+    uint64_t getSentCount();
+    uint64_t getAckedCount();
+    // lost: not acknowledged within the timeout, in flight: sent more recently
+    uint64_t getLostCount();
+    uint64_t getInFlightCount();
+    double getMeanRoundTrip();
+    double getMaxRoundTrip();
+
+private:
+    void threadedFunction();
+
+    CalibrationClock *_clock;
+    ofxUDPManager *_udp;
+    double _epoch_unix_time;
+    bool _acks;
+    std::atomic<uint32_t> _sequence;
+
+    // unacknowledged messages by sequence number, older ones are overwritten
+    static const uint32_t _window = 1024;
+    std::atomic<double> _pending_time[_window];
+    // an ack that takes longer than this counts as lost
+    const double _ack_timeout = 0.5;
+
+    // round-trip times in microseconds
+    std::atomic<uint64_t> _acked_count, _overwritten_count, _rtt_sum, _rtt_max;
+};
+
+#endif /* remoteSound_h */
@@ -0,0 +1,170 @@
+//
+//  renderBenchmark.cpp
+//  phd_calibration_eog
+//
+
+#include "renderBenchmark.h"
+
+static double median(vector<double> &values) {
+    std::sort(values.begin(), values.end());
+    return values.empty() ? 0 : values[values.size() / 2];
+}
+
+RenderBenchmark::RenderBenchmark(int max_markers) {
+    this->_max_markers = max_markers;
+    for (int count = 1; count <= max_markers; count *= 10) {
+        this->_counts.push_back(count);
+    }
+    this->_modes.push_back(INSTANCED);
+    this->_modes.push_back(ONE_CALL_EACH);
+    this->_step = 0;
+    this->_mode = 0;
+    this->_instanced = true;
+    this->_frame = 0;
+    this->_uploaded = 0;
+    this->_direct_draw_time = 0;
+}
+
+void RenderBenchmark::setOperatorWindow(shared_ptr<ofAppBaseWindow> window) {
+    this->_operator_window = window;
+    this->_operator_window->setVerticalSync(false);
+    ofAddListener(this->_operator_window->events().draw, this, &RenderBenchmark::drawOperator);
+    this->_modes.insert(this->_modes.begin() + 1, MIRRORED);
+}
+
+void RenderBenchmark::setup() {
+    ofSetVerticalSync(false);
+    ofSetFrameRate(0);
+    ofSeedRandom(1);
+    this->_frame_times.reserve(this->_measured_frames);
+    this->_draw_times.reserve(this->_measured_frames);
+    this->_operator_times.reserve(this->_measured_frames);
+    if (this->_counts.empty() == true) {
+        ofExit(1);
+        return;
+    }
+    if (this->_operator_window != NULL) {
+        this->_stimulus.allocate(ofGetWidth(), ofGetHeight(), GL_RGB);
+    }
+    startStep();
+}
+
+void RenderBenchmark::startStep() {
+    int count = this->_counts[this->_step];
+    // without instancing every count is measured with one call per marker only
+    bool instancing = (this->_modes[this->_mode] != ONE_CALL_EACH);
+    this->_instanced = this->_renderer.setup(count, instancing);
+    if ((instancing == true) && (this->_instanced == false)) {
+        this->_modes.assign(1, ONE_CALL_EACH);
+        this->_mode = 0;
+    }
+    this->_velocity.assign(count, ofVec2f(0, 0));
+    for (int i = 0; i < count; i++) {
+        this->_renderer.add(ofVec2f(ofRandom(ofGetWidth()), ofRandom(ofGetHeight())), 8, ofColor(ofRandom(64, 255), ofRandom(64, 255), ofRandom(64, 255)));
+        // the last tenth moves, so the dirty range stays short
+        if (i >= count - count / 10) {
+            this->_velocity[i] = ofVec2f(ofRandom(-200, 200), ofRandom(-200, 200));
+        }
+    }
+    this->_frame = 0;
+    this->_frame_times.clear();
+    this->_draw_times.clear();
+    this->_operator_times.clear();
+}
+
+void RenderBenchmark::finishStep() {
+    Mode mode = this->_modes[this->_mode];
+    size_t size = this->_frame_times.size();
+    double draw_time = median(this->_draw_times);
+    double frame_time = median(this->_frame_times);
+    ofLogNotice("RenderBenchmark") << this->_counts[this->_step] << " markers, "
+        << ((mode == INSTANCED) ? "instanced" : (mode == MIRRORED) ? "instanced and mirrored" : "one call each")
+        << ": frame p50 " << frame_time * 1000 << " ms"
+        << ", p99 " << this->_frame_times[std::min(size - 1, (size_t)(size * 0.99))] * 1000 << " ms"
+        << ", draw p50 " << draw_time * 1000 << " ms"
+        << ", " << (this->_renderer.getUploadedCount() - this->_uploaded) / (double)size << " markers uploaded per frame";
+    if (mode == INSTANCED) {
+        this->_direct_draw_time = draw_time;
+    } else if (mode == MIRRORED) {
+        double operator_time = median(this->_operator_times);
+        ofLogNotice("RenderBenchmark") << "  the operator view adds " << (draw_time - this->_direct_draw_time) * 1000
+            << " ms to the participant draw (fbo) and takes " << operator_time * 1000 << " ms of its own per frame";
+    }
+
+    // every mode of a count, then the next count
+    this->_mode++;
+    if (this->_mode == this->_modes.size()) {
+        this->_mode = 0;
+        this->_step++;
+    }
+    if (this->_step == this->_counts.size()) {
+        ofExit(0);
+        return;
+    }
+    startStep();
+}
+
+void RenderBenchmark::update() {
+    float dt = ofGetLastFrameTime();
+    for (size_t i = 0; i < this->_velocity.size(); i++) {
+        if ((this->_velocity[i].x == 0) && (this->_velocity[i].y == 0)) {
+            continue;
+        }
+        ofVec2f position = this->_renderer.getPosition(i) + this->_velocity[i] * dt;
+        if ((position.x < 0) || (position.x > ofGetWidth())) {
+            this->_velocity[i].x = -this->_velocity[i].x;
+        }
+        if ((position.y < 0) || (position.y > ofGetHeight())) {
+            this->_velocity[i].y = -this->_velocity[i].y;
+        }
+        this->_renderer.setPosition(i, position);
+    }
+}
+
+void RenderBenchmark::drawMarkers() {
+    ofClear(ofColor::black);
+    this->_renderer.draw();
+}
+
+void RenderBenchmark::draw() {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (this->_modes[this->_mode] == MIRRORED) {
+        this->_stimulus.begin();
+        drawMarkers();
+        this->_stimulus.end();
+        ofSetColor(255);
+        this->_stimulus.draw(0, 0);
+    } else {
+        drawMarkers();
+    }
+    // include the gpu work of this frame
+    glFinish();
+    double draw_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    this->_frame++;
+    if (this->_frame <= this->_warmup_frames) {
+        // the markers added by the step are uploaded during the warmup
+        this->_uploaded = this->_renderer.getUploadedCount();
+        return;
+    }
+    this->_frame_times.push_back(ofGetLastFrameTime());
+    this->_draw_times.push_back(draw_time);
+    if ((int)this->_draw_times.size() == this->_measured_frames) {
+        finishStep();
+    }
+}
+
+void RenderBenchmark::drawOperator(ofEventArgs &/*args*/) {
+    // what the app's operator view draws: the shared texture, scaled
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ofClear(ofColor(40));
+    if (this->_modes[this->_mode] != MIRRORED) {
+        return;
+    }
+    float scale = std::min(ofGetWidth() * 0.6f / this->_stimulus.getWidth(), (ofGetHeight() - 20.0f) / this->_stimulus.getHeight());
+    ofSetColor(255);
+    this->_stimulus.draw(10, 10, this->_stimulus.getWidth() * scale, this->_stimulus.getHeight() * scale);
+    glFinish();
+    if (this->_frame > this->_warmup_frames) {
+        this->_operator_times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+}
@@ -0,0 +1,56 @@
+//
+//  renderBenchmark.h
+//  phd_calibration_eog
+//
+
+#ifndef renderBenchmark_h
+#define renderBenchmark_h
+
+#include "ofMain.h"
+#include "markerRenderer.h"
+
+/*
+ * Measures the frame time of the marker renderer as the number of markers
+ * grows, instanced and with one draw call per marker, with a tenth of the
+ * markers moving every frame. Runs in a window without vertical sync and
+ * exits when done. With an operator window, every count is also measured
+ * mirrored: rendered into an fbo, shown in the window and drawn a second time
+ * from the shared texture in the operator window, as the app does.
+ */
+class RenderBenchmark : public ofBaseApp {
+public:
+    // counts grow tenfold from 1 to max_markers
+    RenderBenchmark(int max_markers);
+    // before setup
+    void setOperatorWindow(shared_ptr<ofAppBaseWindow> window);
+    void setup();
+    void update();
+    void draw();
+    void drawOperator(ofEventArgs &args);
+
+private:
+    enum Mode { INSTANCED, MIRRORED, ONE_CALL_EACH };
+
+    void startStep();
+    void finishStep();
+    void drawMarkers();
+
+    int _max_markers;
+    vector<int> _counts;
+    vector<Mode> _modes;
+    size_t _step, _mode;
+    bool _instanced;
+    int _frame;
+    uint64_t _uploaded;
+    vector<ofVec2f> _velocity;
+    vector<double> _frame_times, _draw_times, _operator_times;
+    MarkerRenderer _renderer;
+    shared_ptr<ofAppBaseWindow> _operator_window;
+    ofFbo _stimulus;
+    // draw p50 of the instanced step of the current count, the mirrored one is compared to it
+    double _direct_draw_time;
+
+    const int _warmup_frames = 30, _measured_frames = 200;
+};
+
+#endif /* renderBenchmark_h */
@@ -0,0 +1,116 @@
+//
+//  sessionLog.cpp
+//  phd_calibration_eog
+//
+
+#include "sessionLog.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+SessionLog::SessionLog() {
+    this->_fd = -1;
+    this->_mapped_size = 0;
+    this->_mapping = NULL;
+    this->_header = NULL;
+    this->_records = NULL;
+    this->_capacity = 0;
+    this->_next = 0;
+    this->_dropped = 0;
+}
+
+SessionLog::~SessionLog() {
+    close();
+}
+
+bool SessionLog::open(string filename, string codeword, uint64_t capacity, double epoch_unix_time) {
+    close();
+    string path = ofToDataPath(filename, true);
+    this->_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (this->_fd < 0) {
+        ofLogError("SessionLog") << "could not create " << path;
+        return false;
+    }
+    this->_mapped_size = sizeof(SessionLogHeader) + capacity * sizeof(SessionLogRecord);
+    if (ftruncate(this->_fd, this->_mapped_size) != 0) {
+        ofLogError("SessionLog") << "could not size " << path;
+        ::close(this->_fd);
+        this->_fd = -1;
+        return false;
+    }
+    void *mapping = mmap(NULL, this->_mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, this->_fd, 0);
+    if (mapping == MAP_FAILED) {
+        ofLogError("SessionLog") << "could not map " << path;
+        ::close(this->_fd);
+        this->_fd = -1;
+        return false;
+    }
+    this->_mapping = (char*)mapping;
+    // touch every page now so appends never fault during the session
+    memset(this->_mapping, 0, this->_mapped_size);
+
+    this->_header = (SessionLogHeader*)this->_mapping;
+    this->_records = (SessionLogRecord*)(this->_mapping + sizeof(SessionLogHeader));
+    memcpy(this->_header->magic, "EOGLOG01", 8);
+    this->_header->version = 1;
+    this->_header->record_size = sizeof(SessionLogRecord);
+    this->_header->capacity = capacity;
+    this->_header->count = 0;
+    this->_header->epoch_unix_time = epoch_unix_time;
+    strncpy(this->_header->codeword, codeword.c_str(), sizeof(this->_header->codeword) - 1);
+    this->_capacity = capacity;
+    this->_next = 0;
+    this->_dropped = 0;
+    return true;
+}
+
+void SessionLog::close() {
+    if (this->_mapping == NULL) {
+        return;
+    }
+    uint64_t count = std::min(this->_next.load(), this->_capacity);
+    this->_header->count = count;
+    msync(this->_mapping, this->_mapped_size, MS_SYNC);
+    munmap(this->_mapping, this->_mapped_size);
+    // drop the unused capacity from the file
+    if (ftruncate(this->_fd, sizeof(SessionLogHeader) + count * sizeof(SessionLogRecord)) != 0) {
+        ofLogWarning("SessionLog") << "could not truncate log";
+    }
+    ::close(this->_fd);
+    this->_fd = -1;
+    this->_mapping = NULL;
+    this->_header = NULL;
+    this->_records = NULL;
+}
+
+bool SessionLog::isOpen() {
+    return this->_mapping != NULL;
+}
+
+bool SessionLog::append(SessionLogRecord record) {
+    if (this->_mapping == NULL) {
+        return false;
+    }
+    uint64_t slot = this->_next.fetch_add(1);
+    if (slot >= this->_capacity) {
+        this->_dropped++;
+        return false;
+    }
+    record.sequence = (uint32_t)slot;
+    record.committed = 0;
+    SessionLogRecord *target = &this->_records[slot];
+    memcpy(target, &record, sizeof(SessionLogRecord));
+    // the commit flag has to reach memory after the rest of the record
+    std::atomic_thread_fence(std::memory_order_release);
+    ((volatile SessionLogRecord*)target)->committed = 1;
+    __atomic_fetch_add(&this->_header->count, 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+uint64_t SessionLog::getCount() {
+    return std::min(this->_next.load(), this->_capacity);
+}
+
+uint64_t SessionLog::getDroppedCount() {
+    return this->_dropped;
+}
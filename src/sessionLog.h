@@ -0,0 +1,97 @@
+//
+//  sessionLog.h
+//  phd_calibration_eog
+//
+
+#ifndef sessionLog_h
+#define sessionLog_h
+
+#include "ofMain.h"
+
+enum SessionLogRecordType : uint16_t {
+    LOG_TRANSITION = 1,
+    LOG_START_RECORDING,
+    LOG_STOP_RECORDING,
+    LOG_ONSET,              // value: measured onset latency
+    // new clock estimate of peer <target> (ClockSyncPeer): planned_time is the
+    // reference time, value the offset, trigger_done the drift, osc_done the
+    // uncertainty and udp_done the round trip
+    LOG_CLOCK_SYNC,
+    // frames while a marker was shown: planned_time is its onset, value the
+    // missed vsyncs, trigger_done the longest frame, osc_done and udp_done the
+    // mean update and draw time, reserved the number of frames
+    LOG_FRAMES,
+    // a cue of the audio engine: target is the clip, reserved the step that
+    // queued it, planned_time when it should play, steady_time when its first
+    // sample left the output (-1 if dropped) and value the difference
+    LOG_AUDIO
+};
+
+enum ClockSyncPeer : int16_t {
+    PEER_TRIGGER_HOST = 0,
+    PEER_EYE_TRACKER
+};
+
+/*
+ * One fixed-size (64 byte) record of the binary session log.
+ * Times are seconds on the steady clock of the session, -1 if not applicable.
+ */
+struct SessionLogRecord {
+    uint32_t sequence;
+    uint16_t type;          // SessionLogRecordType
+    uint8_t state;          // CalibrationStates after the event
+    uint8_t committed;      // set last, records without it were cut off by a crash
+    int16_t target;         // target index (position in the layout)
+    int16_t order_position; // position in the target order of the pattern
+    uint32_t reserved;
+    double planned_time;    // when the event should have happened
+    double steady_time;     // when the state machine processed it
+    double trigger_done;    // when the send to the trigger host returned
+    double osc_done;        // when the send to the eye tracker returned
+    double udp_done;        // when the send to the remote sound receiver returned
+    double value;           // free field for the record type
+};
+
+static_assert(sizeof(SessionLogRecord) == 64, "session log records are 64 bytes");
+
+struct SessionLogHeader {
+    char magic[8];          // "EOGLOG01"
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t capacity;
+    uint64_t count;         // number of reserved records
+    double epoch_unix_time; // wall clock time of steady time 0
+    char codeword[24];
+};
+
+static_assert(sizeof(SessionLogHeader) == 64, "the session log header is 64 bytes");
+
+/*
+ * Append-only binary log backed by a memory-mapped file. The file is sized for
+ * its capacity when it is opened, appends are a lock-free slot reservation and
+ * a copy into the mapping (any thread may append) and the kernel keeps all
+ * written records even if the process dies.
+ * Convert with bin/data/session_log_to_csv.py.
+ */
+class SessionLog {
+public:
+    SessionLog();
+    ~SessionLog();
+    bool open(string filename, string codeword, uint64_t capacity, double epoch_unix_time);
+    void close();
+    bool isOpen();
+    bool append(SessionLogRecord record);
+    uint64_t getCount();
+    uint64_t getDroppedCount();
+
+private:
+    int _fd;
+    size_t _mapped_size;
+    char *_mapping;
+    SessionLogHeader *_header;
+    SessionLogRecord *_records;
+    uint64_t _capacity;
+    std::atomic<uint64_t> _next, _dropped;
+};
+
+#endif /* sessionLog_h */
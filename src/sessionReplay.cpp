@@ -0,0 +1,213 @@
+//
+//  sessionReplay.cpp
+//  phd_calibration_eog
+//
+
+#include "sessionReplay.h"
+
+SessionReplay::SessionReplay(Options options) {
+    this->_options = options;
+    this->_recorded = new SessionTrace(0);
+    this->_replayed = NULL;
+    this->_clock = NULL;
+    this->_sinks = NULL;
+    this->_pattern = NULL;
+}
+
+SessionReplay::~SessionReplay() {
+    delete this->_pattern;
+    delete this->_sinks;
+    delete this->_clock;
+    delete this->_replayed;
+    delete this->_recorded;
+}
+
+int SessionReplay::run() {
+    if (this->_recorded->load(this->_options.trace_filename) == false) {
+        return 1;
+    }
+    // the inputs, in the order they happened
+    vector<SessionTraceRecord> inputs;
+    double recorded_start = -1;
+    int steps = 0;
+    for (size_t i = 0; i < this->_recorded->getCount(); i++) {
+        const SessionTraceRecord &record = this->_recorded->getRecord(i);
+        if ((record.type == TRACE_START) && (recorded_start < 0)) {
+            recorded_start = record.time;
+            steps = record.code;
+        } else if ((record.type == TRACE_FIXATION) || (record.type == TRACE_STOP)) {
+            inputs.push_back(record);
+        }
+    }
+    if (recorded_start < 0) {
+        ofLogError("SessionReplay") << this->_options.trace_filename << " has no session start";
+        return 1;
+    }
+    std::stable_sort(inputs.begin(), inputs.end(), [](const SessionTraceRecord &a, const SessionTraceRecord &b) { return a.time < b.time; });
+
+    string pattern_filename = (this->_options.pattern_filename != "") ? this->_options.pattern_filename : this->_recorded->getPatternFilename();
+    if (this->_options.realtime == true) {
+        this->_clock = new SteadyClock();
+    } else {
+        this->_clock = new VirtualClock();
+    }
+    this->_sinks = new RecordingSinks(this->_clock);
+    this->_pattern = new CalibrationPattern(this->_clock, this->_sinks, pattern_filename, this->_options.realtime, true);
+    PatternSchedule *schedule = this->_pattern->getSchedule();
+    if ((int)schedule->size() != steps) {
+        ofLogError("SessionReplay") << pattern_filename << " has " << schedule->size() << " steps, the session of the trace had " << steps;
+        return 1;
+    }
+    this->_sinks->reserve(schedule->size() * 4 + 8);
+    this->_replayed = new SessionTrace(this->_recorded->getCount() + 16);
+    this->_pattern->setTrace(this->_replayed);
+    reportInputs();
+
+    // virtual: the replay runs at the very times of the trace; realtime: shifted to its start
+    this->_clock->sleepUntil((this->_options.realtime == true) ? this->_clock->now() + 0.1 : recorded_start);
+    this->_pattern->startCalibration();
+    double offset = this->_pattern->getSessionStart() - recorded_start;
+    int missed = 0;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        double time = inputs[i].time + offset;
+        if (this->_options.realtime == false) {
+            this->_pattern->runHeadless(time);
+            this->_clock->sleepUntil(time);
+        } else if (inputs[i].type == TRACE_FIXATION) {
+            // a little early, the scheduler moves the transition to the exact time
+            this->_clock->sleepUntil(time - 0.005);
+        } else {
+            this->_clock->sleepUntil(time);
+        }
+        if (inputs[i].type == TRACE_STOP) {
+            this->_pattern->stopCalibration();
+        } else if (this->_pattern->replayFixation(inputs[i].step, time) == false) {
+            ofLogError("SessionReplay") << "the fixation at " << inputs[i].time - recorded_start << " s did not end step " << inputs[i].step;
+            missed++;
+        }
+    }
+    if (this->_options.realtime == false) {
+        this->_pattern->runHeadless();
+    }
+    while (this->_pattern->isRunning() == true) {
+        ofSleepMillis(1);
+    }
+    // waits for the last sends
+    this->_pattern->setTrace(NULL);
+    this->_pattern->reportSession();
+    if (this->_options.record_filename != "") {
+        this->_replayed->save(this->_options.record_filename);
+    }
+
+    vector<Output> recorded, replayed;
+    collect(this->_recorded, recorded);
+    collect(this->_replayed, replayed);
+    int mismatched = diff(recorded, replayed);
+
+    vector<double> recorded_lateness, replayed_lateness;
+    for (size_t i = 0; i < recorded.size(); i++) {
+        recorded_lateness.push_back(recorded[i].lateness);
+    }
+    for (size_t i = 0; i < replayed.size(); i++) {
+        replayed_lateness.push_back(replayed[i].lateness);
+    }
+    reportLateness("recorded", recorded_lateness);
+    bool regressed = false;
+    if (this->_options.realtime == true) {
+        reportLateness("replayed", replayed_lateness);
+        double recorded_p99 = recorded_lateness.empty() ? 0 : recorded_lateness[(size_t)(recorded_lateness.size() * 0.99)];
+        double replayed_p99 = replayed_lateness.empty() ? 0 : replayed_lateness[(size_t)(replayed_lateness.size() * 0.99)];
+        if (replayed_p99 > recorded_p99 + this->_options.tolerance) {
+            ofLogError("SessionReplay") << "timing regression: p99 lateness " << replayed_p99 * 1000 << " ms, recorded "
+                << recorded_p99 * 1000 << " ms, tolerance " << this->_options.tolerance * 1000 << " ms";
+            regressed = true;
+        }
+    }
+    ofLogNotice("SessionReplay") << this->_recorded->getCodeword() << ": " << replayed.size() << " of " << recorded.size() << " outputs replayed, "
+        << mismatched << " differ, " << missed << " fixations missed" << (regressed ? ", later than recorded" : "");
+    return ((mismatched == 0) && (missed == 0) && (regressed == false)) ? 0 : 1;
+}
+
+void SessionReplay::collect(SessionTrace *trace, vector<Output> &outputs) {
+    double session_start = 0;
+    for (size_t i = 0; i < trace->getCount(); i++) {
+        const SessionTraceRecord &record = trace->getRecord(i);
+        if (record.type == TRACE_START) {
+            session_start = record.time;
+        }
+        if (record.type < TRACE_START_RECORDING) {
+            continue;
+        }
+        Output output;
+        output.type = record.type;
+        output.step = record.step;
+        output.code = record.code;
+        output.planned_time = record.value - session_start;
+        output.lateness = record.time - record.value;
+        outputs.push_back(output);
+    }
+}
+
+int SessionReplay::diff(const vector<Output> &recorded, const vector<Output> &replayed) {
+    // planned times are computed the same way both times, they may only differ by rounding;
+    // in realtime the operator's stop comes as late as the replay wakes up for it
+    const double epsilon = (this->_options.realtime == true) ? 0.001 : 1e-6;
+    const char *names[] = {"", "start", "stop", "key", "frame", "fixation", "start recording", "stop recording", "trigger", "eye tracker", "remote sound", "command"};
+    int mismatched = 0;
+    size_t count = std::min(recorded.size(), replayed.size());
+    for (size_t i = 0; i < count; i++) {
+        const Output &a = recorded[i];
+        const Output &b = replayed[i];
+        if ((a.type == b.type) && (a.step == b.step) && (a.code == b.code) && (fabs(a.planned_time - b.planned_time) <= epsilon)) {
+            continue;
+        }
+        if (mismatched < 10) {
+            ofLogError("SessionReplay") << "output " << i << ": recorded " << names[a.type] << " " << a.code << " of step " << a.step << " at " << a.planned_time
+                << " s, replayed " << names[b.type] << " " << b.code << " of step " << b.step << " at " << b.planned_time << " s";
+        }
+        mismatched++;
+    }
+    if (recorded.size() != replayed.size()) {
+        ofLogError("SessionReplay") << recorded.size() << " outputs recorded, " << replayed.size() << " replayed";
+        mismatched += std::max(recorded.size(), replayed.size()) - count;
+    }
+    return mismatched;
+}
+
+void SessionReplay::reportLateness(string name, vector<double> &lateness) {
+    if (lateness.empty() == true) {
+        return;
+    }
+    std::sort(lateness.begin(), lateness.end());
+    size_t size = lateness.size();
+    ofLogNotice("SessionReplay") << name << " sends after their planned time: p50 " << lateness[size / 2] * 1000 << " ms, p99 "
+        << lateness[(size_t)(size * 0.99)] * 1000 << " ms, max " << lateness[size - 1] * 1000 << " ms";
+}
+
+void SessionReplay::reportInputs() {
+    int keys = 0, fixations = 0, stops = 0;
+    vector<double> frames;
+    double last_frame = -1;
+    for (size_t i = 0; i < this->_recorded->getCount(); i++) {
+        const SessionTraceRecord &record = this->_recorded->getRecord(i);
+        if (record.type == TRACE_KEY) {
+            keys++;
+        } else if (record.type == TRACE_FIXATION) {
+            fixations++;
+        } else if (record.type == TRACE_STOP) {
+            stops++;
+        } else if (record.type == TRACE_FRAME) {
+            if (last_frame >= 0) {
+                frames.push_back(record.time - last_frame);
+            }
+            last_frame = record.time;
+        }
+    }
+    ofLogNotice("SessionReplay") << this->_options.trace_filename << ": " << this->_recorded->getCodeword() << ", " << fixations << " fixations, "
+        << keys << " key presses, " << (stops > 0 ? "stopped by the operator" : "ran to its end");
+    if (frames.empty() == false) {
+        std::sort(frames.begin(), frames.end());
+        ofLogNotice("SessionReplay") << frames.size() + 1 << " frames recorded, median " << frames[frames.size() / 2] * 1000
+            << " ms, longest " << frames.back() * 1000 << " ms";
+    }
+}
@@ -0,0 +1,60 @@
+//
+//  sessionReplay.h
+//  phd_calibration_eog
+//
+
+#ifndef sessionReplay_h
+#define sessionReplay_h
+
+#include "ofMain.h"
+#include "calibrationPattern.h"
+#include "calibrationClock.h"
+#include "headlessRunner.h"
+#include "sessionTrace.h"
+
+/*
+ * Feeds the inputs of a recorded session trace back through the pattern, the
+ * session start, the fixations that ended steps early and the operator's stop,
+ * at their recorded times, and diffs what it sends against the trace: every
+ * output has to come in the same order with the same code and planned time.
+ * As fast as possible on a virtual clock, or in realtime on the scheduler and
+ * I/O threads, where the lateness of the sends is compared as well.
+ * Key presses and frames are reported but not replayed, the state machine does
+ * not depend on them.
+ */
+class SessionReplay {
+public:
+    struct Options {
+        string trace_filename;
+        string pattern_filename;    // the one of the trace if empty
+        bool realtime;
+        double tolerance;           // seconds the p99 lateness may grow in realtime
+        string record_filename;     // trace of the replay, none if empty
+    };
+
+    SessionReplay(Options options);
+    ~SessionReplay();
+    int run();
+
+private:
+    struct Output {
+        uint8_t type;
+        int step, code;
+        double planned_time;        // from the session start
+        double lateness;
+    };
+
+    // planned times from the session start of the trace
+    void collect(SessionTrace *trace, vector<Output> &outputs);
+    int diff(const vector<Output> &recorded, const vector<Output> &replayed);
+    void reportLateness(string name, vector<double> &lateness);
+    void reportInputs();
+
+    Options _options;
+    SessionTrace *_recorded, *_replayed;
+    CalibrationClock *_clock;
+    RecordingSinks *_sinks;
+    CalibrationPattern *_pattern;
+};
+
+#endif /* sessionReplay_h */
@@ -0,0 +1,55 @@
+//
+//  sessionTimeline.h
+//  phd_calibration_eog
+//
+
+#ifndef sessionTimeline_h
+#define sessionTimeline_h
+
+#include <atomic>
+#include <limits>
+#include <memory>
+
+/*
+ * When the steps of the running session actually started, on the session
+ * clock. Steps can start earlier than compiled (adaptive advance), so
+ * everything that sorts input into steps reads the onsets from here. The
+ * scheduler thread writes each onset once, any thread may read; steps that
+ * did not start yet read as the largest double.
+ */
+class SessionTimeline {
+public:
+    SessionTimeline() : _size(0) {}
+
+    // between sessions only
+    void reset(size_t steps) {
+        if (steps != this->_size) {
+            this->_onset.reset(new std::atomic<double>[steps]);
+            this->_size = steps;
+        }
+        for (size_t i = 0; i < steps; i++) {
+            this->_onset[i].store(std::numeric_limits<double>::max(), std::memory_order_relaxed);
+        }
+    }
+
+    void setOnset(size_t step, double time) {
+        this->_onset[step].store(time, std::memory_order_release);
+    }
+
+    double getOnset(size_t step) const {
+        if (step >= this->_size) {
+            return std::numeric_limits<double>::max();
+        }
+        return this->_onset[step].load(std::memory_order_acquire);
+    }
+
+    size_t size() const {
+        return this->_size;
+    }
+
+private:
+    std::unique_ptr<std::atomic<double>[]> _onset;
+    size_t _size;
+};
+
+#endif /* sessionTimeline_h */
@@ -0,0 +1,113 @@
+//
+//  sessionTrace.cpp
+//  phd_calibration_eog
+//
+
+#include "sessionTrace.h"
+
+SessionTrace::SessionTrace(size_t capacity) {
+    this->_records.resize(capacity);
+    memset(&this->_header, 0, sizeof(SessionTraceHeader));
+    this->_next = 0;
+    this->_dropped = 0;
+}
+
+void SessionTrace::start(const string &codeword, const string &pattern_filename, double epoch_unix_time) {
+    memset(&this->_header, 0, sizeof(SessionTraceHeader));
+    memcpy(this->_header.magic, "EOGTRC01", 8);
+    this->_header.version = 1;
+    this->_header.record_size = sizeof(SessionTraceRecord);
+    this->_header.epoch_unix_time = epoch_unix_time;
+    strncpy(this->_header.codeword, codeword.c_str(), sizeof(this->_header.codeword) - 1);
+    strncpy(this->_header.pattern, pattern_filename.c_str(), sizeof(this->_header.pattern) - 1);
+    this->_next = 0;
+    this->_dropped = 0;
+}
+
+bool SessionTrace::record(SessionTraceRecordType type, int step, int code, double time, double value) {
+    uint64_t slot = this->_next.fetch_add(1);
+    if (slot >= this->_records.size()) {
+        this->_dropped++;
+        return false;
+    }
+    SessionTraceRecord *target = &this->_records[slot];
+    target->committed = 0;
+    target->time = time;
+    target->value = value;
+    target->type = type;
+    target->step = step;
+    target->code = code;
+    // the commit flag has to be written after the rest of the record
+    std::atomic_thread_fence(std::memory_order_release);
+    ((volatile SessionTraceRecord*)target)->committed = 1;
+    return true;
+}
+
+bool SessionTrace::save(string filename) {
+    string path = ofToDataPath(filename, true);
+    std::ofstream file(path, std::ios::binary);
+    if (file.is_open() == false) {
+        ofLogError("SessionTrace") << "could not create " << path;
+        return false;
+    }
+    // records still being written when the session ended are left out
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t count = getCount();
+    SessionTraceHeader header = this->_header;
+    header.count = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        if (this->_records[i].committed == 1) {
+            header.count++;
+        }
+    }
+    file.write((const char*)&header, sizeof(SessionTraceHeader));
+    for (uint64_t i = 0; i < count; i++) {
+        if (this->_records[i].committed == 1) {
+            file.write((const char*)&this->_records[i], sizeof(SessionTraceRecord));
+        }
+    }
+    if (this->_dropped > 0) {
+        ofLogWarning("SessionTrace") << this->_dropped << " records did not fit into the trace, raise <log><trace_capacity>";
+    }
+    return file.good();
+}
+
+bool SessionTrace::load(string filename) {
+    string path = ofToDataPath(filename, true);
+    std::ifstream file(path, std::ios::binary);
+    SessionTraceHeader header;
+    if ((file.read((char*)&header, sizeof(SessionTraceHeader)).good() == false)
+        || (memcmp(header.magic, "EOGTRC01", 8) != 0) || (header.record_size != sizeof(SessionTraceRecord))) {
+        ofLogError("SessionTrace") << path << " is no session trace";
+        return false;
+    }
+    this->_records.resize(header.count);
+    if (file.read((char*)this->_records.data(), header.count * sizeof(SessionTraceRecord)).good() == false) {
+        ofLogError("SessionTrace") << path << " is cut off";
+        return false;
+    }
+    this->_header = header;
+    this->_next = header.count;
+    this->_dropped = 0;
+    return true;
+}
+
+uint64_t SessionTrace::getCount() {
+    return std::min(this->_next.load(), (uint64_t)this->_records.size());
+}
+
+uint64_t SessionTrace::getDroppedCount() {
+    return this->_dropped;
+}
+
+const SessionTraceRecord& SessionTrace::getRecord(size_t index) {
+    return this->_records[index];
+}
+
+string SessionTrace::getCodeword() {
+    return string(this->_header.codeword);
+}
+
+string SessionTrace::getPatternFilename() {
+    return string(this->_header.pattern);
+}
@@ -0,0 +1,83 @@
+//
+//  sessionTrace.h
+//  phd_calibration_eog
+//
+
+#ifndef sessionTrace_h
+#define sessionTrace_h
+
+#include "ofMain.h"
+
+enum SessionTraceRecordType : uint8_t {
+    // inputs
+    TRACE_START = 1,        // the session started: code is the number of steps
+    TRACE_STOP,             // the operator stopped the session in step <step>
+    TRACE_KEY,              // a key press of the operator: code is the key
+    TRACE_FRAME,            // the render thread started a frame
+    TRACE_FIXATION,         // a fixation ended step <step>: value is the time the step would have ended
+    // outputs, as they were sent: time is when the send returned, value the planned time
+    TRACE_START_RECORDING,
+    TRACE_STOP_RECORDING,
+    TRACE_TRIGGER,          // code: trigger code
+    TRACE_EYE_TRACKER,      // code: trigger code
+    TRACE_REMOTE_SOUND,     // code: remote command, 9999 for a beep
+    TRACE_COMMAND           // code: sound id
+};
+
+/*
+ * One fixed-size (24 byte) record of a session trace.
+ * Times are seconds on the clock of the session.
+ */
+struct SessionTraceRecord {
+    double time;
+    double value;           // free field for the record type
+    uint8_t type;           // SessionTraceRecordType
+    uint8_t committed;      // set last, the record is complete
+    int16_t step;           // step of the schedule, -1 if none
+    int32_t code;
+};
+
+static_assert(sizeof(SessionTraceRecord) == 24, "session trace records are 24 bytes");
+
+struct SessionTraceHeader {
+    char magic[8];          // "EOGTRC01"
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t count;
+    double epoch_unix_time; // wall clock time of time 0
+    char codeword[32];
+    char pattern[64];       // pattern file the session ran
+};
+
+static_assert(sizeof(SessionTraceHeader) == 128, "the session trace header is 128 bytes");
+
+/*
+ * Everything that went into a session and everything that came out of it:
+ * the operator's keys, the frames, the fixations that ended steps early and
+ * every packet and command, for replaying the session later. Records are
+ * appended lock-free from any thread into memory reserved up front and
+ * written to a file once the session is over.
+ */
+class SessionTrace {
+public:
+    SessionTrace(size_t capacity);
+    // drops the records of the last session, no thread may record meanwhile
+    void start(const string &codeword, const string &pattern_filename, double epoch_unix_time);
+    bool record(SessionTraceRecordType type, int step, int code, double time, double value);
+    bool save(string filename);
+    // replaces the records, sized to the file
+    bool load(string filename);
+
+    uint64_t getCount();
+    uint64_t getDroppedCount();
+    const SessionTraceRecord& getRecord(size_t index);
+    string getCodeword();
+    string getPatternFilename();
+
+private:
+    SessionTraceHeader _header;
+    vector<SessionTraceRecord> _records;
+    std::atomic<uint64_t> _next, _dropped;
+};
+
+#endif /* sessionTrace_h */
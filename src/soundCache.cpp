@@ -0,0 +1,75 @@
+//
+//  soundCache.cpp
+//  phd_calibration_eog
+//
+
+#include "soundCache.h"
+
+SoundCache::SoundCache() {
+    this->_loaded = true;
+    this->_load_duration = 0;
+}
+
+SoundCache::~SoundCache() {
+    waitForThread(false);
+    for (map<string, ofSoundPlayer*>::iterator it = this->_players.begin(); it != this->_players.end(); ++it) {
+        delete it->second;
+    }
+}
+
+ofSoundPlayer* SoundCache::get(string filename) {
+    if (filename == "") {
+        return NULL;
+    }
+    map<string, ofSoundPlayer*>::iterator it = this->_players.find(filename);
+    if (it != this->_players.end()) {
+        return it->second;
+    }
+    ofSoundPlayer *player = new ofSoundPlayer();
+    this->_players[filename] = player;
+    this->_pending.push_back(make_pair(filename, player));
+    this->_loaded = false;
+    return player;
+}
+
+void SoundCache::load(bool in_background) {
+    if (this->_pending.empty() == true) {
+        return;
+    }
+    if (in_background == true) {
+        waitForThread(false);
+        startThread();
+    } else {
+        loadPending();
+    }
+}
+
+bool SoundCache::isLoaded() {
+    return this->_loaded;
+}
+
+size_t SoundCache::size() {
+    return this->_players.size();
+}
+
+double SoundCache::getLoadDuration() {
+    // only valid once isLoaded() returned true
+    return this->_load_duration;
+}
+
+void SoundCache::threadedFunction() {
+    loadPending();
+}
+
+void SoundCache::loadPending() {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < this->_pending.size(); i++) {
+        if (this->_pending[i].second->load(this->_pending[i].first) == false) {
+            ofLogWarning("SoundCache") << "could not load " << this->_pending[i].first;
+        }
+    }
+    this->_load_duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ofLogNotice("SoundCache") << "decoded " << this->_pending.size() << " sound files in " << this->_load_duration * 1000 << " ms";
+    this->_pending.clear();
+    this->_loaded = true;
+}
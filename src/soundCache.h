@@ -0,0 +1,37 @@
+//
+//  soundCache.h
+//  phd_calibration_eog
+//
+
+#ifndef soundCache_h
+#define soundCache_h
+
+#include "ofMain.h"
+
+/*
+ * Keeps one decoded ofSoundPlayer per sound file, shared by every pattern item
+ * using it. get() only registers a file, load() decodes all registered files
+ * once, either right away or on a background thread while the window comes up.
+ * Register every file before calling load().
+ */
+class SoundCache : public ofThread {
+public:
+    SoundCache();
+    ~SoundCache();
+    ofSoundPlayer* get(string filename);
+    void load(bool in_background);
+    bool isLoaded();
+    size_t size();
+    double getLoadDuration();
+
+private:
+    void threadedFunction();
+    void loadPending();
+
+    map<string, ofSoundPlayer*> _players;
+    vector<pair<string, ofSoundPlayer*> > _pending;
+    std::atomic<bool> _loaded;
+    double _load_duration;
+};
+
+#endif /* soundCache_h */
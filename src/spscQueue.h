@@ -0,0 +1,64 @@
+//
+//  spscQueue.h
+//  phd_calibration_eog
+//
+
+#ifndef spscQueue_h
+#define spscQueue_h
+
+#include <atomic>
+#include <cstddef>
+
+/*
+ * Bounded lock-free ring buffer for exactly one producer and one consumer
+ * thread. Capacity has to be a power of two. push() and pop() never block and
+ * never allocate, push() fails when the buffer is full.
+ */
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert((Capacity > 1) && ((Capacity & (Capacity - 1)) == 0), "capacity must be a power of two");
+public:
+    SpscQueue() : _head(0), _tail(0) {}
+
+    bool push(const T &item) {
+        size_t tail = this->_tail.load(std::memory_order_relaxed);
+        if ((tail - this->_head.load(std::memory_order_acquire)) >= Capacity) {
+            return false;
+        }
+        this->_items[tail & (Capacity - 1)] = item;
+        this->_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item) {
+        size_t head = this->_head.load(std::memory_order_relaxed);
+        if (head == this->_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = this->_items[head & (Capacity - 1)];
+        this->_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const {
+        return this->_tail.load(std::memory_order_acquire) - this->_head.load(std::memory_order_acquire);
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    size_t capacity() const {
+        return Capacity;
+    }
+
+private:
+    // keep both indices on their own cache line to avoid false sharing
+    std::atomic<size_t> _head;
+    char _head_padding[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> _tail;
+    char _tail_padding[64 - sizeof(std::atomic<size_t>)];
+    T _items[Capacity];
+};
+
+#endif /* spscQueue_h */
@@ -0,0 +1,183 @@
+//
+//  startupTasks.cpp
+//  phd_calibration_eog
+//
+
+#include "startupTasks.h"
+
+StartupTasks::StartupTasks(CalibrationClock *clock) {
+    this->_clock = clock;
+    this->_start = 0;
+    this->_reported = false;
+}
+
+StartupTasks::~StartupTasks() {
+    for (size_t i = 0; i < this->_workers.size(); i++) {
+        this->_workers[i]->waitForThread(false);
+        delete this->_workers[i];
+    }
+    for (size_t i = 0; i < this->_tasks.size(); i++) {
+        delete this->_tasks[i];
+    }
+}
+
+void StartupTasks::add(string name, vector<string> after, std::function<bool()> task, bool required, bool render_thread) {
+    // before start()
+    Task *t = new Task();
+    t->name = name;
+    for (size_t i = 0; i < after.size(); i++) {
+        size_t index = 0;
+        while ((index < this->_tasks.size()) && (this->_tasks[index]->name != after[i])) {
+            index++;
+        }
+        if (index == this->_tasks.size()) {
+            ofLogError("StartupTasks") << name << " depends on " << after[i] << ", which was not added before";
+            continue;
+        }
+        t->after.push_back(index);
+    }
+    t->run = task;
+    t->required = required;
+    t->render_thread = render_thread;
+    t->state = WAITING;
+    t->begin = 0;
+    t->end = 0;
+    this->_tasks.push_back(t);
+}
+
+void StartupTasks::start() {
+    this->_start = this->_clock->now();
+    for (size_t i = 0; i < this->_tasks.size(); i++) {
+        if (this->_tasks[i]->render_thread == false) {
+            Worker *worker = new Worker(this, i);
+            this->_workers.push_back(worker);
+            worker->startThread();
+        }
+    }
+}
+
+void StartupTasks::poll() {
+    for (size_t i = 0; i < this->_tasks.size(); i++) {
+        Task *t = this->_tasks[i];
+        if ((t->render_thread == false) || (t->state.load(std::memory_order_acquire) != WAITING)) {
+            continue;
+        }
+        int due = isDue(i);
+        if (due < 0) {
+            std::lock_guard<std::mutex> lock(this->_mutex);
+            t->state.store(SKIPPED, std::memory_order_release);
+            this->_finished.notify_all();
+        } else if (due > 0) {
+            run(i);
+        }
+    }
+    if ((this->_reported == false) && (isFinished() == true)) {
+        this->_reported = true;
+        report();
+    }
+}
+
+bool StartupTasks::isReady() {
+    for (size_t i = 0; i < this->_tasks.size(); i++) {
+        if ((this->_tasks[i]->required == true) && (this->_tasks[i]->state.load(std::memory_order_acquire) != DONE)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool StartupTasks::isFinished() {
+    for (size_t i = 0; i < this->_tasks.size(); i++) {
+        int state = this->_tasks[i]->state.load(std::memory_order_acquire);
+        if ((state == WAITING) || (state == RUNNING)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void StartupTasks::draw(float x, float y) {
+    static const char *names[] = { "waiting", "running", "done", "failed", "skipped" };
+    double now = this->_clock->now();
+    ofSetColor(255, 255, 255);
+    ofDrawBitmapString("starting up, sessions can start once every required task is done", x, y);
+    for (size_t i = 0; i < this->_tasks.size(); i++) {
+        Task *t = this->_tasks[i];
+        int state = t->state.load(std::memory_order_acquire);
+        string line = t->name + (t->required ? "" : " (optional)") + ": " + names[state];
+        if (state == RUNNING) {
+            line += " for " + ofToString((now - t->begin) * 1000, 0) + " ms";
+        } else if ((state == DONE) || (state == FAILED)) {
+            line += " in " + ofToString((t->end - t->begin) * 1000, 0) + " ms";
+        }
+        ofDrawBitmapString(line, x, y + 20 * (i + 1));
+    }
+}
+
+int StartupTasks::isDue(size_t index) {
+    const vector<size_t> &after = this->_tasks[index]->after;
+    int due = 1;
+    for (size_t i = 0; i < after.size(); i++) {
+        int state = this->_tasks[after[i]]->state.load(std::memory_order_acquire);
+        if ((state == FAILED) || (state == SKIPPED)) {
+            return -1;
+        }
+        if (state != DONE) {
+            due = 0;
+        }
+    }
+    return due;
+}
+
+void StartupTasks::run(size_t index) {
+    Task *t = this->_tasks[index];
+    t->begin = this->_clock->now();
+    t->state.store(RUNNING, std::memory_order_release);
+    bool success = t->run();
+    t->end = this->_clock->now();
+    if (success == false) {
+        ofLogError("StartupTasks") << t->name << " failed";
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        t->state.store(success ? DONE : FAILED, std::memory_order_release);
+    }
+    this->_finished.notify_all();
+}
+
+void StartupTasks::runWhenDue(size_t index) {
+    int due = 0;
+    {
+        std::unique_lock<std::mutex> lock(this->_mutex);
+        this->_finished.wait(lock, [this, index, &due]() { due = isDue(index); return due != 0; });
+        if (due < 0) {
+            this->_tasks[index]->state.store(SKIPPED, std::memory_order_release);
+        }
+    }
+    if (due < 0) {
+        this->_finished.notify_all();
+        return;
+    }
+    run(index);
+}
+
+void StartupTasks::report() {
+    double ready = 0;
+    double finished = 0;
+    for (size_t i = 0; i < this->_tasks.size(); i++) {
+        Task *t = this->_tasks[i];
+        int state = t->state.load(std::memory_order_acquire);
+        if (state == SKIPPED) {
+            ofLogNotice("StartupTasks") << t->name << ": skipped";
+            continue;
+        }
+        ofLogNotice("StartupTasks") << t->name << ((state == FAILED) ? " (failed)" : "") << ": "
+            << (t->begin - this->_start) * 1000 << " ms to " << (t->end - this->_start) * 1000 << " ms after start, took "
+            << (t->end - t->begin) * 1000 << " ms" << (t->render_thread ? " on the render thread" : "");
+        if (t->required == true) {
+            ready = std::max(ready, t->end - this->_start);
+        }
+        finished = std::max(finished, t->end - this->_start);
+    }
+    ofLogNotice("StartupTasks") << "ready after " << ready * 1000 << " ms, all tasks finished after " << finished * 1000 << " ms";
+}
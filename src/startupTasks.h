@@ -0,0 +1,69 @@
+//
+//  startupTasks.h
+//  phd_calibration_eog
+//
+
+#ifndef startupTasks_h
+#define startupTasks_h
+
+#include "ofMain.h"
+#include "calibrationClock.h"
+
+/*
+ * Startup as a set of tasks with explicit dependencies. Each task runs on a
+ * thread of its own as soon as every task it depends on is done, so the
+ * window comes up right away while independent work (sockets, pattern,
+ * sounds) runs in parallel; tasks that need the GL context run on the render
+ * thread in poll(). A task that fails skips everything depending on it.
+ * Sessions can start once the required tasks are done. The time of every
+ * phase is kept and reported once all tasks finished.
+ */
+class StartupTasks {
+public:
+    enum State { WAITING, RUNNING, DONE, FAILED, SKIPPED };
+
+    StartupTasks(CalibrationClock *clock);
+    ~StartupTasks();
+    // after: names of tasks added before; task returns false if it failed
+    void add(string name, vector<string> after, std::function<bool()> task, bool required = true, bool render_thread = false);
+    void start();
+    // render thread: run the render thread tasks that are due, report once all finished
+    void poll();
+    bool isReady();
+    bool isFinished();
+    void draw(float x, float y);
+
+private:
+    struct Task {
+        string name;
+        vector<size_t> after;
+        std::function<bool()> run;
+        bool required, render_thread;
+        std::atomic<int> state;
+        double begin, end;
+    };
+    class Worker : public ofThread {
+    public:
+        Worker(StartupTasks *tasks, size_t index) : _tasks(tasks), _index(index) {}
+    private:
+        void threadedFunction() { this->_tasks->runWhenDue(this->_index); }
+        StartupTasks *_tasks;
+        size_t _index;
+    };
+
+    // -1: a dependency failed, 0: still waiting, 1: due
+    int isDue(size_t index);
+    void run(size_t index);
+    void runWhenDue(size_t index);
+    void report();
+
+    CalibrationClock *_clock;
+    double _start;
+    bool _reported;
+    vector<Task*> _tasks;
+    vector<Worker*> _workers;
+    std::mutex _mutex;
+    std::condition_variable _finished;
+};
+
+#endif /* startupTasks_h */
@@ -0,0 +1,126 @@
+//
+//  targetLayout.cpp
+//  phd_calibration_eog
+//
+
+#include "targetLayout.h"
+
+TargetLayout::TargetLayout() {
+    this->_width = 0;
+    this->_height = 0;
+    this->_margin = 0;
+    this->_use_margin = true;
+}
+
+void TargetLayout::clear() {
+    this->_u.clear();
+    this->_v.clear();
+    this->_shift_x.clear();
+    this->_shift_y.clear();
+    this->_x.clear();
+    this->_y.clear();
+    this->_use_margin = true;
+}
+
+void TargetLayout::addTarget(float u, float v, float shift_x, float shift_y) {
+    this->_u.push_back(ofClamp(u, 0, 1));
+    this->_v.push_back(ofClamp(v, 0, 1));
+    this->_shift_x.push_back(shift_x);
+    this->_shift_y.push_back(shift_y);
+    this->_x.push_back(0);
+    this->_y.push_back(0);
+}
+
+void TargetLayout::makeDefault() {
+    clear();
+    /*
+     * 1    2    3
+     *    9   10
+     * 8    0    4
+     *   12   11
+     * 7    6    5
+     */
+    // the original positions on the whole window and their corrections, half a radius included
+    addTarget(0.5f,  0.5f,  -0.5f, -0.5f); // center center
+    addTarget(0.0f,  0.0f,   1.5f,  1.5f); // top    left   corner
+    addTarget(0.5f,  0.0f,  -0.5f,  1.5f); // top    center
+    addTarget(1.0f,  0.0f,  -1.5f,  1.5f); // top    right  corner
+    addTarget(1.0f,  0.5f,  -1.5f, -0.5f); // right  center
+    addTarget(1.0f,  1.0f,  -1.5f, -1.5f); // bottom right  corner
+    addTarget(0.5f,  1.0f,  -0.5f, -1.5f); // bottom center
+    addTarget(0.0f,  1.0f,   1.5f, -1.5f); // bottom left   corner
+    addTarget(0.0f,  0.5f,   1.5f, -0.5f); // left   center
+    addTarget(0.25f, 0.25f,  0.0f,  0.0f);
+    addTarget(0.75f, 0.25f, -1.0f,  0.0f);
+    addTarget(0.75f, 0.75f, -1.0f, -1.0f);
+    addTarget(0.25f, 0.75f,  0.0f, -1.0f);
+    this->_use_margin = false;
+}
+
+void TargetLayout::makeGrid(int columns, int rows) {
+    clear();
+    for (int row = 0; row < rows; row++) {
+        for (int column = 0; column < columns; column++) {
+            addTarget((columns > 1) ? column / (float)(columns - 1) : 0.5f, (rows > 1) ? row / (float)(rows - 1) : 0.5f);
+        }
+    }
+}
+
+void TargetLayout::makePolar(int rings, int spokes) {
+    clear();
+    addTarget(0.5f, 0.5f);
+    for (int ring = 1; ring <= rings; ring++) {
+        float radius = 0.5f * ring / rings;
+        for (int spoke = 0; spoke < spokes; spoke++) {
+            float angle = TWO_PI * spoke / spokes;
+            addTarget(0.5f + radius * sin(angle), 0.5f - radius * cos(angle));
+        }
+    }
+}
+
+void TargetLayout::resize(float width, float height, float marker_radius) {
+    this->_width = width;
+    this->_height = height;
+    this->_margin = 1.5f * marker_radius;
+    // x = margin + u * (width - 2 * margin) + shift * radius, one straight loop per axis
+    const float margin = this->_use_margin ? this->_margin : 0;
+    const float scale_x = width - 2 * margin;
+    const float scale_y = height - 2 * margin;
+    const size_t n = this->_u.size();
+    const float *u = this->_u.data();
+    const float *v = this->_v.data();
+    const float *shift_x = this->_shift_x.data();
+    const float *shift_y = this->_shift_y.data();
+    float *x = this->_x.data();
+    float *y = this->_y.data();
+    for (size_t i = 0; i < n; i++) {
+        x[i] = margin + u[i] * scale_x + shift_x[i] * marker_radius;
+    }
+    for (size_t i = 0; i < n; i++) {
+        y[i] = margin + v[i] * scale_y + shift_y[i] * marker_radius;
+    }
+}
+
+size_t TargetLayout::size() {
+    return this->_u.size();
+}
+
+ofVec2f TargetLayout::getPosition(int target) {
+    if ((target < 0) || (target >= (int)this->_x.size())) {
+        return ofVec2f(this->_width / 2, this->_height / 2);
+    }
+    return ofVec2f(this->_x[target], this->_y[target]);
+}
+
+ofVec2f TargetLayout::getNormalized(int target) {
+    if ((target < 0) || (target >= (int)this->_u.size())) {
+        return ofVec2f(0.5f, 0.5f);
+    }
+    return ofVec2f(this->_u[target], this->_v[target]);
+}
+
+ofVec2f TargetLayout::map(float u, float v) {
+    // onto the same rectangle as the targets of this layout
+    const float margin = this->_use_margin ? this->_margin : 0;
+    return ofVec2f(margin + u * (this->_width - 2 * margin), margin + v * (this->_height - 2 * margin));
+}
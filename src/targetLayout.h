@@ -0,0 +1,47 @@
+//
+//  targetLayout.h
+//  phd_calibration_eog
+//
+
+#ifndef targetLayout_h
+#define targetLayout_h
+
+#include "ofMain.h"
+
+/*
+ * Positions of the calibration targets. Targets are stored normalized to
+ * [0, 1] in one contiguous table per axis and scaled to the window in a single
+ * pass on resize. A margin of one and a half marker radius keeps markers away
+ * from the window edges, so targets on the border need no hand-made correction.
+ * Only the default layout keeps the original table: positions on the whole
+ * window, each moved by its own correction in marker radii.
+ */
+class TargetLayout {
+public:
+    TargetLayout();
+    void clear();
+    // shift: extra offset in marker radii
+    void addTarget(float u, float v, float shift_x = 0, float shift_y = 0);
+    // the original 13 positions: corners, edge centers, center and inner square
+    void makeDefault();
+    // columns x rows, row by row from the top left
+    void makeGrid(int columns, int rows);
+    // center first, then ring by ring from the inside, spokes clockwise from the top
+    void makePolar(int rings, int spokes);
+
+    void resize(float width, float height, float marker_radius);
+    size_t size();
+    ofVec2f getPosition(int target);
+    ofVec2f getNormalized(int target);
+    // any normalized position, e.g. along a pursuit trajectory
+    ofVec2f map(float u, float v);
+
+private:
+    vector<float> _u, _v;
+    vector<float> _shift_x, _shift_y;
+    vector<float> _x, _y;
+    float _width, _height, _margin;
+    bool _use_margin;
+};
+
+#endif /* targetLayout_h */